@@ -0,0 +1,112 @@
+#include "aoapplication.h"
+#include "aopacket.h"
+#include "file_functions.h"
+#include "options.h"
+#include "replaybenchmark.h"
+#include "tracer.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+int main(int argc, char *argv[])
+{
+  // Nothing needs to be shown; the widgets still lay out and paint offscreen.
+  if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+  {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+
+  qRegisterMetaType<AOPacket>();
+
+  QApplication app(argc, argv);
+  QApplication::setApplicationName("ao_benchmark");
+  QApplication::setApplicationVersion(AOApplication::get_version_string());
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Plays a demo file through the client as fast as possible and reports how long it took.");
+  parser.addHelpOption();
+  parser.addVersionOption();
+  parser.addPositionalArgument("demo", "The demo file to play.");
+  QCommandLineOption messages_option("messages", "Stop after <count> IC messages.", "count");
+  QCommandLineOption timeout_option("timeout", "Give up on an IC message after <msecs> milliseconds.", "msecs", QString::number(ReplayBenchmark::DEFAULT_MESSAGE_TIMEOUT));
+  QCommandLineOption trace_option("trace", "Record a Chrome trace of the replay to <file>.", "file");
+  parser.addOption(messages_option);
+  parser.addOption(timeout_option);
+  parser.addOption(trace_option);
+  parser.process(app);
+
+  const QStringList arguments = parser.positionalArguments();
+  if (arguments.size() != 1)
+  {
+    parser.showHelp(1);
+  }
+
+  // The replay writes its configuration, caches and logs into a temporary
+  // directory instead of the user's. It starts from a copy of the user's
+  // configuration and reads the assets from the real base as a mount path.
+  QTemporaryDir work_dir;
+  if (!work_dir.isValid())
+  {
+    qCritical() << "could not create a temporary directory:" << work_dir.errorString();
+    return 1;
+  }
+  const QString demo_file = QFileInfo(arguments.first()).absoluteFilePath();
+  const QString real_base = get_base_path();
+  QFile::copy(real_base + "config.ini", work_dir.filePath("config.ini"));
+  set_base_path(work_dir.path());
+
+  Options &options = Options::getInstance();
+  options.beginUpdate();
+  QStringList mounts;
+  mounts.append(real_base);
+  for (const QString &mount : options.mountPaths())
+  {
+    mounts.append(QFileInfo(mount).absoluteFilePath());
+  }
+  options.setMountPaths(mounts);
+  // Messages are shown at once and the queue never waits, so the latencies
+  // do not depend on the user's settings.
+  options.setTextCrawlSpeed(0);
+  options.setTextStayTime(0);
+  options.setLogToTextFileEnabled(false);
+  options.setLogToDemoFileEnabled(false);
+  options.endUpdate();
+
+  // Logs are written relative to the working directory.
+  QDir::setCurrent(work_dir.path());
+
+  AOApplication ao_app;
+  ao_app.refresh_asset_index();
+  ao_app.register_fonts();
+  ao_app.wait_for_asset_index();
+
+  ReplayBenchmark benchmark(&ao_app);
+  if (!benchmark.open(demo_file))
+  {
+    return 1;
+  }
+  if (parser.isSet(messages_option))
+  {
+    benchmark.setMessageLimit(parser.value(messages_option).toInt());
+  }
+  benchmark.setMessageTimeout(parser.value(timeout_option).toInt());
+
+  Tracer::getInstance().setEnabled(parser.isSet(trace_option));
+  benchmark.run();
+  Tracer::getInstance().setEnabled(false);
+
+  QTextStream out(stdout);
+  benchmark.report(out);
+
+  if (parser.isSet(trace_option) && !Tracer::getInstance().exportChromeTrace(parser.value(trace_option)))
+  {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,278 @@
+#include "replaybenchmark.h"
+
+#include "animationframecache.h"
+#include "aopacket.h"
+#include "courtroom.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+
+#include <algorithm>
+
+#if defined(Q_OS_WIN)
+// clang-format off
+#include <windows.h>
+#include <psapi.h>
+// clang-format on
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+ReplayBenchmark::ReplayBenchmark(AOApplication *ao_app, QObject *parent)
+    : QObject(parent)
+    , ao_app(ao_app)
+{}
+
+bool ReplayBenchmark::open(const QString &fileName)
+{
+  return m_reader.open(fileName);
+}
+
+void ReplayBenchmark::setMessageLimit(int messages)
+{
+  m_message_limit = messages;
+}
+
+void ReplayBenchmark::setMessageTimeout(int msecs)
+{
+  m_message_timeout = msecs;
+}
+
+void ReplayBenchmark::run()
+{
+  connectToDemo();
+  if (!ao_app->w_courtroom)
+  {
+    qCritical() << "could not enter the courtroom";
+    return;
+  }
+  QCoreApplication::processEvents();
+
+  m_baseline = handlerStatistics();
+  m_baseline_lookups = ao_app->asset_lookups;
+  m_baseline_lookup_misses = ao_app->asset_lookup_misses;
+  m_baseline_decodes = kal::AnimationFrameCache::getInstance().decodeCount();
+  m_baseline_cache_hits = kal::AnimationFrameCache::getInstance().hitCount();
+  m_baseline_prefetches = kal::AnimationFrameCache::getInstance().prefetchCount();
+
+  QElapsedTimer timer;
+  timer.start();
+
+  int message_count = 0;
+  const int first_index = m_reader.size() > 0 && m_reader.kind(0) == DemoReader::CharacterListPacket ? 1 : 0;
+  for (int i = first_index; i < m_reader.size(); ++i)
+  {
+    const DemoReader::PacketKind kind = m_reader.kind(i);
+    if (kind == DemoReader::WaitPacket)
+    {
+      continue;
+    }
+
+    if (kind == DemoReader::MessagePacket)
+    {
+      if (m_message_limit >= 0 && message_count >= m_message_limit)
+      {
+        break;
+      }
+      ++message_count;
+      playMessage(m_reader.packet(i));
+    }
+    else
+    {
+      sendPacket(m_reader.packet(i));
+      QCoreApplication::processEvents();
+    }
+    ++m_packet_count;
+  }
+
+  m_elapsed_nsecs = timer.nsecsElapsed();
+}
+
+void ReplayBenchmark::report(QTextStream &out) const
+{
+  out << "Demo: " << m_reader.fileName() << (m_reader.format() == DemoReader::BinaryFormat ? " (binary)" : " (text)") << "\n";
+  out << "Played " << m_packet_count << " packets and " << m_finish_latencies.size() << " IC messages in " << QString::number(m_elapsed_nsecs / 1e6, 'f', 1) << " ms\n";
+  if (m_dropped_messages > 0 || m_timed_out_messages > 0)
+  {
+    out << "IC messages dropped by the courtroom: " << m_dropped_messages << ", timed out: " << m_timed_out_messages << "\n";
+  }
+
+  out << "\nPacket handling:\n";
+  out << QString("  %1 %2 %3 %4 %5 %6\n").arg("header", -10).arg("calls", 8).arg("rejected", 9).arg("total ms", 10).arg("mean us", 10).arg("max us", 10);
+
+  const QHash<QString, HandlerStatistics> current = handlerStatistics();
+  QVector<QPair<QString, HandlerStatistics>> rows;
+  for (auto it = current.constBegin(); it != current.constEnd(); ++it)
+  {
+    const HandlerStatistics baseline = m_baseline.value(it.key());
+    HandlerStatistics row = it.value();
+    row.calls -= baseline.calls;
+    row.rejected -= baseline.rejected;
+    row.total_nsecs -= baseline.total_nsecs;
+    if (row.calls > 0)
+    {
+      rows.append({it.key(), row});
+    }
+  }
+  std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) { return a.second.total_nsecs > b.second.total_nsecs; });
+  for (const auto &[header, row] : std::as_const(rows))
+  {
+    // The maximum also covers the packets sent while entering the courtroom.
+    out << QString("  %1 %2 %3 %4 %5 %6\n").arg(header, -10).arg(row.calls, 8).arg(row.rejected, 9).arg(row.total_nsecs / 1e6, 10, 'f', 2).arg(row.total_nsecs / 1e3 / row.calls, 10, 'f', 1).arg(row.maximum_nsecs / 1e3, 10, 'f', 1);
+  }
+
+  out << "\nIC message latency:\n";
+  reportLatencies(out, "until the text starts", m_start_latencies);
+  reportLatencies(out, "until the text is shown in full", m_finish_latencies);
+
+  kal::AnimationFrameCache &frame_cache = kal::AnimationFrameCache::getInstance();
+  out << "\nAssets:\n";
+  out << "  lookups: " << ao_app->asset_lookups - m_baseline_lookups << " (" << ao_app->asset_lookup_misses - m_baseline_lookup_misses << " not found)\n";
+  out << "  animations decoded: " << frame_cache.decodeCount() - m_baseline_decodes << " (" << frame_cache.hitCount() - m_baseline_cache_hits << " reused)\n";
+  out << "  animations prefetched: " << frame_cache.prefetchCount() - m_baseline_prefetches << "\n";
+
+  const qint64 peak_memory = peakMemoryUsage();
+  if (peak_memory >= 0)
+  {
+    out << "\nPeak memory: " << QString::number(peak_memory / (1024.0 * 1024.0), 'f', 1) << " MiB\n";
+  }
+  out.flush();
+}
+
+void ReplayBenchmark::connectToDemo()
+{
+  // Follows what the lobby and DemoServer do when a demo is opened.
+  ao_app->construct_lobby();
+  ao_app->construct_courtroom();
+
+  sendPacket("FL#noencryption#yellowtext#prezoom#flipping#customobjections#fastloading#deskmod#evidence#cccc_ic_support#arup#casing_alerts#modcall_reason#looping_sfx#additive#effects#y_offset#expanded_desk_mods#%");
+
+  // There is no server to request the music list from.
+  ao_app->courtroom_loaded = true;
+  sendPacket(m_reader.size() > 0 && m_reader.kind(0) == DemoReader::CharacterListPacket ? m_reader.packet(0) : "SC#%");
+  sendPacket("DONE#%");
+  sendPacket("PV#0#CID#-1#%");
+}
+
+void ReplayBenchmark::sendPacket(const QString &packet)
+{
+  // Same as WebSocketConnection
+  if (!packet.endsWith("#%"))
+  {
+    return;
+  }
+  ao_app->server_packet_received(AOPacket::fromString(QStringView(packet).chopped(2)));
+}
+
+void ReplayBenchmark::playMessage(const QString &packet)
+{
+  Courtroom *courtroom = ao_app->w_courtroom;
+
+  QEventLoop loop;
+  QTimer poll;
+  poll.setSingleShot(true);
+  poll.setInterval(POLL_INTERVAL);
+  connect(&poll, &QTimer::timeout, &loop, &QEventLoop::quit);
+
+  QElapsedTimer timer;
+  qint64 started = -1;
+  qint64 finished = -1;
+  QMetaObject::Connection started_connection = connect(courtroom, &Courtroom::chatmessage_started, &loop, [&] {
+    if (started == -1)
+    {
+      started = timer.nsecsElapsed();
+    }
+  });
+  QMetaObject::Connection finished_connection = connect(courtroom, &Courtroom::chatmessage_finished, &loop, [&] {
+    if (finished == -1)
+    {
+      finished = timer.nsecsElapsed();
+    }
+    loop.quit();
+  });
+
+  timer.start();
+  sendPacket(packet);
+  // Messages that were dropped, e.g. because of an invalid character, never finish.
+  while (finished == -1 && courtroom->is_chatmessage_pending() && !timer.hasExpired(m_message_timeout))
+  {
+    poll.start();
+    loop.exec();
+  }
+
+  disconnect(started_connection);
+  disconnect(finished_connection);
+
+  if (finished != -1)
+  {
+    m_start_latencies.append(started != -1 ? started : finished);
+    m_finish_latencies.append(finished);
+  }
+  else if (courtroom->is_chatmessage_pending())
+  {
+    ++m_timed_out_messages;
+  }
+  else
+  {
+    ++m_dropped_messages;
+  }
+}
+
+QHash<QString, ReplayBenchmark::HandlerStatistics> ReplayBenchmark::handlerStatistics() const
+{
+  QHash<QString, HandlerStatistics> statistics;
+  const QHash<QString, AOApplication::PacketHandler> &handlers = ao_app->get_packet_handlers();
+  for (auto it = handlers.constBegin(); it != handlers.constEnd(); ++it)
+  {
+    HandlerStatistics handler;
+    handler.calls = it->calls;
+    handler.rejected = it->rejected;
+    handler.total_nsecs = it->total_nsecs;
+    handler.maximum_nsecs = it->maximum_nsecs;
+    statistics.insert(it.key(), handler);
+  }
+  return statistics;
+}
+
+void ReplayBenchmark::reportLatencies(QTextStream &out, const QString &name, QVector<qint64> latencies)
+{
+  if (latencies.isEmpty())
+  {
+    out << "  " << name << ": no messages\n";
+    return;
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  // Nearest-rank percentiles
+  auto percentile = [&latencies](int p) { return latencies.at(qMax(0, int((latencies.size() * p + 99) / 100) - 1)) / 1e6; };
+  out << "  " << name << ": p50 " << QString::number(percentile(50), 'f', 2) << " ms, p90 " << QString::number(percentile(90), 'f', 2) << " ms, p99 " << QString::number(percentile(99), 'f', 2) << " ms, max " << QString::number(latencies.last() / 1e6, 'f', 2) << " ms\n";
+}
+
+qint64 ReplayBenchmark::peakMemoryUsage()
+{
+#if defined(Q_OS_WIN)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+  {
+    return -1;
+  }
+  return counters.PeakWorkingSetSize;
+#elif defined(Q_OS_UNIX)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+  {
+    return -1;
+  }
+#if defined(Q_OS_MACOS)
+  return usage.ru_maxrss;
+#else
+  // Linux reports kilobytes
+  return qint64(usage.ru_maxrss) * 1024;
+#endif
+#else
+  return -1;
+#endif
+}
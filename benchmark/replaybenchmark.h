@@ -0,0 +1,81 @@
+#pragma once
+
+#include "aoapplication.h"
+#include "demoreader.h"
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTextStream>
+#include <QVector>
+
+/**
+ * @brief Plays a demo file through the packet handlers and courtroom as fast
+ * as possible, measuring how long each step takes.
+ *
+ * @details Wait packets are skipped. Every other packet goes straight to
+ * AOApplication::server_packet_received, as if it had come from the demo
+ * server. After an IC message, playback only continues once the message is
+ * shown in full, so its latency covers the queue, the objection and
+ * preanimation, and the text crawl at the configured speed. The benchmark
+ * tool sets the text crawl speed and stay time to zero.
+ */
+class ReplayBenchmark : public QObject
+{
+  Q_OBJECT
+
+public:
+  static constexpr int DEFAULT_MESSAGE_TIMEOUT = 30000;
+  static constexpr int POLL_INTERVAL = 5;
+
+  explicit ReplayBenchmark(AOApplication *ao_app, QObject *parent = nullptr);
+
+  bool open(const QString &fileName);
+
+  /// Stops after this many IC messages, or plays the whole demo if negative.
+  void setMessageLimit(int messages);
+
+  /// Longest time to wait for a single IC message, in milliseconds.
+  void setMessageTimeout(int msecs);
+
+  void run();
+  void report(QTextStream &out) const;
+
+private:
+  class HandlerStatistics
+  {
+  public:
+    quint64 calls = 0;
+    quint64 rejected = 0;
+    qint64 total_nsecs = 0;
+    qint64 maximum_nsecs = 0;
+  };
+
+  AOApplication *ao_app;
+  DemoReader m_reader;
+  int m_message_limit = -1;
+  int m_message_timeout = DEFAULT_MESSAGE_TIMEOUT;
+
+  QHash<QString, HandlerStatistics> m_baseline;
+  quint64 m_baseline_lookups = 0;
+  quint64 m_baseline_lookup_misses = 0;
+  quint64 m_baseline_decodes = 0;
+  quint64 m_baseline_cache_hits = 0;
+  quint64 m_baseline_prefetches = 0;
+
+  qint64 m_elapsed_nsecs = 0;
+  int m_packet_count = 0;
+  int m_dropped_messages = 0;
+  int m_timed_out_messages = 0;
+  QVector<qint64> m_start_latencies;
+  QVector<qint64> m_finish_latencies;
+
+  void connectToDemo();
+  void sendPacket(const QString &packet);
+  void playMessage(const QString &packet);
+
+  QHash<QString, HandlerStatistics> handlerStatistics() const;
+
+  static void reportLatencies(QTextStream &out, const QString &name, QVector<qint64> latencies);
+  static qint64 peakMemoryUsage();
+};
@@ -0,0 +1,120 @@
+#include "animationclock.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+
+#include <algorithm>
+
+namespace kal
+{
+AnimationClock::AnimationClock()
+{
+  m_time.start();
+  m_timer.setTimerType(Qt::PreciseTimer);
+  connect(&m_timer, &QTimer::timeout, this, &AnimationClock::tick);
+}
+
+qint64 AnimationClock::time() const
+{
+  return m_time.elapsed();
+}
+
+int AnimationClock::interval() const
+{
+  qreal refresh_rate = DEFAULT_REFRESH_RATE;
+  if (QScreen *screen = QGuiApplication::primaryScreen(); screen && screen->refreshRate() > 0)
+  {
+    refresh_rate = screen->refreshRate();
+  }
+  return qMax(1, qRound(1000.0 / refresh_rate));
+}
+
+void AnimationClock::start(Client *client, int minimumInterval)
+{
+  const int client_interval = qMax(interval(), minimumInterval);
+  if (Registration *entry = registration(client))
+  {
+    entry->interval = client_interval;
+  }
+  else
+  {
+    m_clients.append({client, client_interval, time()});
+  }
+  updateTimer();
+}
+
+void AnimationClock::stop(Client *client)
+{
+  m_clients.removeIf([client](const Registration &entry) { return entry.client == client; });
+  updateTimer();
+}
+
+bool AnimationClock::isRunning(Client *client) const
+{
+  return std::any_of(m_clients.begin(), m_clients.end(), [client](const Registration &entry) { return entry.client == client; });
+}
+
+AnimationClock::Registration *AnimationClock::registration(Client *client)
+{
+  for (Registration &entry : m_clients)
+  {
+    if (entry.client == client)
+    {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+void AnimationClock::updateTimer()
+{
+  if (m_clients.isEmpty())
+  {
+    m_timer.stop();
+    return;
+  }
+
+  int timer_interval = m_clients.first().interval;
+  for (const Registration &entry : std::as_const(m_clients))
+  {
+    timer_interval = qMin(timer_interval, entry.interval);
+  }
+
+  if (!m_timer.isActive() || m_timer.interval() != timer_interval)
+  {
+    m_timer.start(timer_interval);
+  }
+}
+
+void AnimationClock::tick()
+{
+  const qint64 now = time();
+  // Timers fire a little early or late, so a client that is due within half
+  // a tick is advanced now rather than a whole tick late.
+  const qint64 horizon = now + m_timer.interval() / 2;
+
+  // Clients may start, stop or delete other clients while they advance.
+  QList<Client *> due_clients;
+  for (Registration &entry : m_clients)
+  {
+    if (entry.due > horizon)
+    {
+      continue;
+    }
+    entry.due += entry.interval;
+    if (entry.due <= now)
+    {
+      entry.due = now + entry.interval;
+    }
+    due_clients.append(entry.client);
+  }
+
+  for (Client *client : std::as_const(due_clients))
+  {
+    if (isRunning(client))
+    {
+      client->clockTick(now);
+    }
+  }
+}
+} // namespace kal
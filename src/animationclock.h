@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QTimer>
+
+namespace kal
+{
+/**
+ * @brief Drives every running animation from a single timer.
+ *
+ * @details The clock only ticks while a client is running. Each client
+ * can ask for a minimum interval between its ticks; the clock runs at the
+ * shortest interval any running client needs, but never faster than the
+ * refresh rate of the primary screen, and skips clients that are not due yet.
+ * Clients that are due on the same tick advance together, so the repaints
+ * they request are coalesced into one. Clients advance by the time that has
+ * passed rather than by the number of ticks: when a tick comes late they
+ * catch up on the steps they missed, up to MAXIMUM_CATCH_UP_STEPS, and drop
+ * the rest.
+ */
+class AnimationClock : public QObject
+{
+  Q_OBJECT
+
+public:
+  static constexpr int DEFAULT_REFRESH_RATE = 60;
+  static constexpr int MAXIMUM_CATCH_UP_STEPS = 8;
+
+  class Client
+  {
+  public:
+    virtual ~Client() = default;
+
+    /// Called on every tick the client is due while it is running.
+    virtual void clockTick(qint64 time) = 0;
+  };
+
+  AnimationClock(const AnimationClock &) = delete;
+  void operator=(const AnimationClock &) = delete;
+
+  static AnimationClock &getInstance()
+  {
+    static AnimationClock instance;
+    return instance;
+  }
+
+  /// Milliseconds since the clock was created.
+  qint64 time() const;
+
+  /// Milliseconds between two ticks at the refresh rate of the primary screen.
+  int interval() const;
+
+  /**
+   * @brief Starts ticking client, at most once every minimumInterval
+   * milliseconds, or at the refresh rate if it is shorter.
+   *
+   * @details Starting a client that is already running only changes its
+   * interval.
+   */
+  void start(Client *client, int minimumInterval = 0);
+  void stop(Client *client);
+  bool isRunning(Client *client) const;
+
+private:
+  class Registration
+  {
+  public:
+    Client *client = nullptr;
+    int interval = 0;
+    qint64 due = 0;
+  };
+
+  QElapsedTimer m_time;
+  QTimer m_timer;
+  QList<Registration> m_clients;
+
+  AnimationClock();
+
+  Registration *registration(Client *client);
+  void updateTimer();
+  void tick();
+};
+} // namespace kal
@@ -0,0 +1,188 @@
+#include "animationframecache.h"
+
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+namespace kal
+{
+AnimationFrameCache &AnimationFrameCache::getInstance()
+{
+  static AnimationFrameCache instance;
+  return instance;
+}
+
+AnimationFrameCache::AnimationFrameCache()
+    : m_thread_pool(new QThreadPool(QCoreApplication::instance()))
+    , m_cache(DEFAULT_MAXIMUM_COST)
+{
+  m_thread_pool->setMaxThreadCount(8);
+}
+
+std::shared_ptr<AnimationData> AnimationFrameCache::acquire(const QString &fileName, bool prefetch)
+{
+  if (prefetch)
+  {
+    ++m_prefetch_count;
+  }
+
+  const QString key = fileName + QLatin1Char('|') + QString::number(QFileInfo(fileName).lastModified().toMSecsSinceEpoch());
+
+  QMutexLocker locker(&m_lock);
+  if (std::shared_ptr<AnimationData> *cached = m_cache.object(key))
+  {
+    std::shared_ptr<AnimationData> data = *cached;
+    ++data->users;
+    if (!prefetch)
+    {
+      ++m_hit_count;
+    }
+    return data;
+  }
+
+  if (std::shared_ptr<AnimationData> data = m_pending.value(key).lock())
+  {
+    ++data->users;
+    if (!prefetch)
+    {
+      ++m_hit_count;
+    }
+    return data;
+  }
+
+  std::shared_ptr<AnimationData> data = std::make_shared<AnimationData>();
+  QImageReader *reader = new QImageReader;
+  reader->setFileName(fileName);
+  data->file_name = fileName;
+  data->size = reader->size();
+  data->frame_count = reader->imageCount();
+  data->loop_count = reader->loopCount();
+  data->users = 1;
+
+  if (data->frame_count <= 0)
+  {
+    delete reader;
+    data->finished = true;
+    return data;
+  }
+
+  m_pending.insert(key, data);
+  ++m_decode_count;
+  m_thread_pool->start([this, key, data, reader]() { populateVector(key, data, reader); });
+
+  return data;
+}
+
+void AnimationFrameCache::release(const std::shared_ptr<AnimationData> &data)
+{
+  if (data)
+  {
+    --data->users;
+  }
+}
+
+qint64 AnimationFrameCache::maximumCost()
+{
+  QMutexLocker locker(&m_lock);
+  return m_cache.maxCost();
+}
+
+void AnimationFrameCache::setMaximumCost(qint64 bytes)
+{
+  QMutexLocker locker(&m_lock);
+  m_cache.setMaxCost(bytes);
+}
+
+qint64 AnimationFrameCache::totalCost()
+{
+  QMutexLocker locker(&m_lock);
+  return m_cache.totalCost();
+}
+
+quint64 AnimationFrameCache::hitCount() const
+{
+  return m_hit_count;
+}
+
+quint64 AnimationFrameCache::prefetchCount() const
+{
+  return m_prefetch_count;
+}
+
+quint64 AnimationFrameCache::decodeCount() const
+{
+  return m_decode_count;
+}
+
+void AnimationFrameCache::clear()
+{
+  QMutexLocker locker(&m_lock);
+  m_cache.clear();
+}
+
+void AnimationFrameCache::populateVector(const QString &key, std::shared_ptr<AnimationData> data, QImageReader *reader)
+{
+  AO_TRACE_SCOPE_ARG("AnimationFrameCache::populateVector", key);
+  bool complete = true;
+  int loaded_frame_count = 0;
+  while (loaded_frame_count < data->frame_count)
+  {
+    if (data->users == 0 && abandon(key, data))
+    {
+      complete = false;
+      break;
+    }
+
+    AnimationFrame frame;
+    frame.texture = QPixmap::fromImage(reader->read());
+    frame.duration = reader->nextImageDelay();
+    const qint64 cost = qint64(frame.texture.width()) * frame.texture.height() * frame.texture.depth() / 8;
+    {
+      QMutexLocker locker(&data->lock);
+      data->frames.append(frame);
+      data->cost += cost;
+    }
+    ++loaded_frame_count;
+    data->signal.wakeAll();
+  }
+
+  delete reader;
+
+  {
+    QMutexLocker locker(&data->lock);
+    data->finished = true;
+  }
+  data->signal.wakeAll();
+
+  if (complete)
+  {
+    finish(key, data);
+  }
+}
+
+bool AnimationFrameCache::abandon(const QString &key, const std::shared_ptr<AnimationData> &data)
+{
+  // acquire() hands out pending data under the same lock, so nobody can pick
+  // it up again once we decided to stop decoding.
+  QMutexLocker locker(&m_lock);
+  if (data->users != 0)
+  {
+    return false;
+  }
+
+  m_pending.remove(key);
+  return true;
+}
+
+void AnimationFrameCache::finish(const QString &key, const std::shared_ptr<AnimationData> &data)
+{
+  QMutexLocker locker(&m_lock);
+  m_pending.remove(key);
+
+  // Animations larger than the whole budget are rejected (and deleted) by QCache.
+  m_cache.insert(key, new std::shared_ptr<AnimationData>(data), data->cost);
+}
+} // namespace kal
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <QCache>
+#include <QHash>
+#include <QImageReader>
+#include <QMutex>
+#include <QPixmap>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <memory>
+
+namespace kal
+{
+class AnimationFrame
+{
+public:
+  QPixmap texture;
+  int duration = 0;
+};
+
+/**
+ * @brief The decoded frames of a single image file.
+ *
+ * @details Frames are appended by a background task while loaders read them,
+ * so every access to frames, cost or finished must hold lock. Waiters are
+ * woken through signal whenever a frame is appended or decoding ends.
+ */
+class AnimationData
+{
+  Q_DISABLE_COPY_MOVE(AnimationData)
+
+public:
+  AnimationData() = default;
+
+  QString file_name;
+  QSize size;
+  int frame_count = 0;
+  int loop_count = -1;
+
+  QList<AnimationFrame> frames;
+  qint64 cost = 0;
+  bool finished = false;
+
+  QMutex lock;
+  QWaitCondition signal;
+
+  /// Amount of loaders currently displaying this animation.
+  std::atomic_int users = 0;
+};
+
+/**
+ * @brief Process-wide cache of decoded animations shared by every AnimationLoader.
+ *
+ * @details Entries are keyed by file path and modification time, so an
+ * updated asset is decoded again. Fully decoded animations are kept in an
+ * LRU cache whose cost is the amount of bytes used by their frames; loaders
+ * keep a reference to the data they display, so an evicted animation is only
+ * released once nobody uses it anymore. Animations that are still being
+ * decoded are shared as well, and decoding is aborted once the last loader
+ * releases them.
+ */
+class AnimationFrameCache
+{
+  Q_DISABLE_COPY_MOVE(AnimationFrameCache)
+
+public:
+  static constexpr qint64 DEFAULT_MAXIMUM_COST = 256 * 1024 * 1024;
+
+  static AnimationFrameCache &getInstance();
+
+  /**
+   * @brief Returns the animation for fileName, decoding it in the background
+   * if it is neither cached nor already being decoded.
+   *
+   * @details Every call must be paired with a call to release().
+   *
+   * @param prefetch True if the animation is not shown yet, which keeps the
+   * call out of hitCount().
+   */
+  std::shared_ptr<AnimationData> acquire(const QString &fileName, bool prefetch = false);
+  void release(const std::shared_ptr<AnimationData> &data);
+
+  qint64 maximumCost();
+  void setMaximumCost(qint64 bytes);
+  qint64 totalCost();
+
+  /// Amount of acquire() calls that reused a cached or pending animation,
+  /// not counting prefetches.
+  quint64 hitCount() const;
+  /// Amount of acquire() calls made to prefetch an animation.
+  quint64 prefetchCount() const;
+  /// Amount of animations that had to be decoded.
+  quint64 decodeCount() const;
+
+  void clear();
+
+private:
+  AnimationFrameCache();
+
+  QThreadPool *m_thread_pool;
+  QMutex m_lock;
+  QCache<QString, std::shared_ptr<AnimationData>> m_cache;
+  QHash<QString, std::weak_ptr<AnimationData>> m_pending;
+  std::atomic<quint64> m_hit_count = 0;
+  std::atomic<quint64> m_prefetch_count = 0;
+  std::atomic<quint64> m_decode_count = 0;
+
+  void populateVector(const QString &key, std::shared_ptr<AnimationData> data, QImageReader *reader);
+  bool abandon(const QString &key, const std::shared_ptr<AnimationData> &data);
+  void finish(const QString &key, const std::shared_ptr<AnimationData> &data);
+};
+} // namespace kal
@@ -2,6 +2,7 @@
 
 #include "aoapplication.h"
 #include "options.h"
+#include "viewportcompositor.h"
 
 #include <QRectF>
 #include <QThreadPool>
@@ -10,17 +11,25 @@ static QThreadPool *thread_pool;
 
 namespace kal
 {
+static AnimationLayer::LateFramePolicy lateFramePolicyFromOptions()
+{
+  const QString policy = Options::getInstance().lateFramePolicy();
+  if (policy == "hold")
+  {
+    return AnimationLayer::HoldPreviousFrame;
+  }
+  else if (policy == "stall")
+  {
+    return AnimationLayer::StallPlayback;
+  }
+  return AnimationLayer::SkipAhead;
+}
+
 AnimationLayer::AnimationLayer(QWidget *parent)
     : QLabel(parent)
 {
   setAlignment(Qt::AlignCenter);
 
-  m_ticker = new QTimer(this);
-  m_ticker->setSingleShot(true);
-  m_ticker->setTimerType(Qt::PreciseTimer);
-
-  connect(m_ticker, &QTimer::timeout, this, &AnimationLayer::frameTicker);
-
   if (!thread_pool)
   {
     thread_pool = new QThreadPool(qApp);
@@ -28,10 +37,16 @@ AnimationLayer::AnimationLayer(QWidget *parent)
   }
 
   createLoader();
+  updateCompositor();
 }
 
 AnimationLayer::~AnimationLayer()
 {
+  AnimationClock::getInstance().stop(this);
+  if (m_compositor)
+  {
+    m_compositor->removeLayer(this);
+  }
   deleteLoader();
 }
 
@@ -64,18 +79,17 @@ void AnimationLayer::startPlayback()
     return;
   }
   resetData();
+  m_late_frame_policy = lateFramePolicyFromOptions();
   m_processing = true;
   setVisible(true);
   Q_EMIT startedPlayback();
+  m_frame_time = AnimationClock::getInstance().time();
   frameTicker();
 }
 
 void AnimationLayer::stopPlayback()
 {
-  if (m_ticker->isActive())
-  {
-    m_ticker->stop();
-  }
+  cancelNextTick();
   m_processing = false;
   if (m_reset_cache_when_stopped)
   {
@@ -133,13 +147,11 @@ void AnimationLayer::jumpToFrame(int number)
   }
 
   bool is_processing = m_processing;
-  if (m_ticker->isActive())
-  {
-    m_ticker->stop();
-  }
+  cancelNextTick();
   m_target_frame_number = number;
   if (is_processing)
   {
+    m_frame_time = AnimationClock::getInstance().time();
     frameTicker();
   }
 }
@@ -166,7 +178,12 @@ void AnimationLayer::setResetCacheWhenStopped(bool enabled)
 
 void AnimationLayer::setFlipped(bool enabled)
 {
+  if (m_flipped == enabled)
+  {
+    return;
+  }
   m_flipped = enabled;
+  updateFrameTransform();
 }
 
 void AnimationLayer::setResizeMode(RESIZE_MODE mode)
@@ -190,16 +207,70 @@ void AnimationLayer::setMaskingRect(QRect rect)
   calculateFrameGeometry();
 }
 
+bool AnimationLayer::event(QEvent *event)
+{
+  if (event->type() == QEvent::ZOrderChange)
+  {
+    updateCompositor();
+  }
+  return QLabel::event(event);
+}
+
+void AnimationLayer::changeEvent(QEvent *event)
+{
+  QLabel::changeEvent(event);
+  if (event->type() == QEvent::ParentChange)
+  {
+    updateCompositor();
+  }
+}
+
+void AnimationLayer::paintEvent(QPaintEvent *event)
+{
+  // The compositor paints the frame instead.
+  if (m_compositor)
+  {
+    return;
+  }
+  QLabel::paintEvent(event);
+}
+
 void AnimationLayer::resizeEvent(QResizeEvent *event)
 {
   QLabel::resizeEvent(event);
   calculateFrameGeometry();
 }
 
+void AnimationLayer::updateCompositor()
+{
+  ViewportCompositor *compositor = ViewportCompositor::compositorFor(this);
+  if (compositor != m_compositor)
+  {
+    if (m_compositor)
+    {
+      m_compositor->removeLayer(this);
+    }
+    m_compositor = compositor;
+    if (m_compositor)
+    {
+      m_compositor->addLayer(this);
+    }
+    displayCurrentFrame();
+    update();
+  }
+
+  // Layers placed in this one follow it.
+  for (AnimationLayer *child : findChildren<AnimationLayer *>(Qt::FindDirectChildrenOnly))
+  {
+    child->updateCompositor();
+  }
+}
+
 void AnimationLayer::createLoader()
 {
   deleteLoader();
-  m_loader = new AnimationLoader(thread_pool);
+  m_loader = new AnimationLoader(thread_pool, this);
+  connect(m_loader, &AnimationLoader::frameReady, this, &AnimationLayer::onFrameReady);
 }
 
 void AnimationLayer::deleteLoader()
@@ -215,6 +286,9 @@ void AnimationLayer::resetData()
 {
   m_first_frame = true;
   m_frame_number = 0;
+  m_current_frame_number = -1;
+  m_late_frame_number = -1;
+  m_retransformed_frame_number = -1;
   if (m_file_name != m_loader->loadedFileName())
   {
     m_loader->load(m_file_name);
@@ -222,7 +296,7 @@ void AnimationLayer::resetData()
   m_frame_count = m_loader->frameCount();
   m_frame_size = m_loader->size();
   m_frame_rect = QRect(QPoint(0, 0), m_frame_size);
-  m_ticker->stop();
+  cancelNextTick();
   calculateFrameGeometry();
 }
 
@@ -269,9 +343,33 @@ void AnimationLayer::calculateFrameGeometry()
     m_transformation_mode = Qt::SmoothTransformation;
   }
 
+  updateFrameTransform();
+  if (m_current_frame_number != -1)
+  {
+    // The loader transforms the current frame first; it is shown once ready
+    // instead of waiting for it here.
+    std::optional<AnimationFrame> frame = m_loader->tryFrame(m_current_frame_number);
+    if (!frame.has_value())
+    {
+      m_retransformed_frame_number = m_current_frame_number;
+      return;
+    }
+    m_current_frame = *frame;
+  }
+  m_retransformed_frame_number = -1;
   displayCurrentFrame();
 }
 
+void AnimationLayer::updateFrameTransform()
+{
+  AnimationFrameTransform transform;
+  transform.mask_rect = m_mask_rect;
+  transform.size = m_scaled_frame_size;
+  transform.mode = m_transformation_mode;
+  transform.flipped = m_flipped;
+  m_loader->setFrameTransform(transform, qMax(0, m_current_frame_number));
+}
+
 void AnimationLayer::finishPlayback()
 {
   stopPlayback();
@@ -282,36 +380,57 @@ void AnimationLayer::prepareNextTick()
 {
   int duration = qMax(m_minimum_duration, m_current_frame.duration);
   duration = (m_maximum_duration > 0) ? qMin(m_maximum_duration, duration) : duration;
-  m_ticker->start(duration);
+
+  // Due relative to when the current frame was due, not to when it was shown,
+  // so that late ticks do not slow the animation down.
+  m_next_frame_time = m_frame_time + duration;
+  m_tick_scheduled = true;
+  AnimationClock::getInstance().start(this);
 }
 
-void AnimationLayer::displayCurrentFrame()
+void AnimationLayer::cancelNextTick()
 {
-  QPixmap image = m_current_frame.texture;
+  m_tick_scheduled = false;
+  AnimationClock::getInstance().stop(this);
+}
 
-  if (m_frame_size.isValid())
+void AnimationLayer::clockTick(qint64 time)
+{
+  for (int i = 0; m_tick_scheduled && time >= m_next_frame_time; ++i)
   {
-    if (m_mask_rect.isValid())
+    if (i == AnimationClock::MAXIMUM_CATCH_UP_STEPS)
     {
-      image = image.copy(m_mask_rect);
+      // Too far behind, drop the frames that remain and carry on from now.
+      m_next_frame_time = time;
+      return;
     }
+    m_tick_scheduled = false;
+    m_frame_time = m_next_frame_time;
+    frameTicker();
+  }
 
-    if (!image.isNull())
-    {
-      image = image.scaled(m_scaled_frame_size, Qt::IgnoreAspectRatio, m_transformation_mode);
-
-      if (m_flipped)
-      {
-        image = image.transformed(QTransform().scale(-1.0, 1.0));
-      }
-    }
+  if (!m_tick_scheduled)
+  {
+    AnimationClock::getInstance().stop(this);
   }
-  else
+}
+
+void AnimationLayer::displayCurrentFrame()
+{
+  // Frames are already cropped, scaled and flipped by the loader.
+  QPixmap image = m_current_frame.texture;
+
+  if (!m_frame_size.isValid())
   {
     image = QPixmap(1, 1);
     image.fill(Qt::transparent);
   }
 
+  if (m_compositor)
+  {
+    m_compositor->setLayerFrame(this, image);
+    return;
+  }
   setPixmap(image);
 }
 
@@ -357,13 +476,29 @@ void AnimationLayer::frameTicker()
     }
   }
 
-  m_first_frame = false;
   if (m_target_frame_number != -1)
   {
     m_frame_number = m_target_frame_number;
     m_target_frame_number = -1;
   }
-  m_current_frame = m_loader->frame(m_frame_number);
+
+  m_late_frame_number = -1;
+  if (m_late_frame_policy == StallPlayback)
+  {
+    m_current_frame = m_loader->frame(m_frame_number);
+  }
+  else
+  {
+    std::optional<AnimationFrame> frame = m_loader->tryFrame(m_frame_number);
+    if (!frame.has_value())
+    {
+      handleLateFrame();
+      return;
+    }
+    m_current_frame = *frame;
+  }
+  m_first_frame = false;
+  m_current_frame_number = m_frame_number;
   displayCurrentFrame();
   Q_EMIT frameNumberChanged(m_frame_number);
   ++m_frame_number;
@@ -374,6 +509,53 @@ void AnimationLayer::frameTicker()
   }
 }
 
+/**
+ * @brief AnimationLayer::handleLateFrame
+ * @details Called by the ticker when the frame it is supposed to display has not been decoded yet.
+ * Without a frame on screen, or when paused, there is nothing to skip ahead from, so the late frame is always held.
+ */
+void AnimationLayer::handleLateFrame()
+{
+  if (m_late_frame_policy == SkipAhead && !m_first_frame && !m_pause)
+  {
+    // Pretend the frame was shown for as long as the previous one so that frame
+    // effects still fire and the animation stays on time.
+    Q_EMIT frameNumberChanged(m_frame_number);
+    ++m_frame_number;
+    prepareNextTick();
+    return;
+  }
+
+  m_late_frame_number = m_frame_number;
+}
+
+void AnimationLayer::onFrameReady(int frameNumber)
+{
+  if (sender() != m_loader)
+  {
+    return;
+  }
+
+  if (frameNumber == m_retransformed_frame_number && frameNumber == m_current_frame_number)
+  {
+    m_retransformed_frame_number = -1;
+    std::optional<AnimationFrame> frame = m_loader->tryFrame(frameNumber);
+    if (frame.has_value())
+    {
+      m_current_frame = *frame;
+      displayCurrentFrame();
+    }
+  }
+
+  if (frameNumber != m_late_frame_number || !m_processing)
+  {
+    return;
+  }
+  m_late_frame_number = -1;
+  m_frame_time = AnimationClock::getInstance().time();
+  frameTicker();
+}
+
 CharacterAnimationLayer::CharacterAnimationLayer(AOApplication *ao_app, QWidget *parent)
     : AnimationLayer(parent)
     , ao_app(ao_app)
@@ -406,18 +588,28 @@ void CharacterAnimationLayer::loadCharacterEmote(QString character, QString file
   m_resolved_emote = fileName;
   m_emote_type = emoteType;
 
+  QString file_path = findEmoteFile(ao_app, character, fileName, emoteType, &m_resolved_emote);
+
+  setFileName(file_path);
+  setPlayOnce(emoteType == PreEmote);
+  setResizeMode(ao_app->get_scaling(ao_app->get_emote_property(character, fileName, "scaling")));
+  setStretchToFit(ao_app->get_emote_property(character, fileName, "stretch").startsWith("true"));
+  if (synchronize_frame && previous_frame_count == frameCount())
+  {
+    jumpToFrame(previous_frame_number);
+  }
+  m_duration = durationLimit;
+}
+
+QString CharacterAnimationLayer::findEmoteFile(AOApplication *ao_app, QString character, QString fileName, EmoteType emoteType, QString *resolvedEmote)
+{
   QStringList prefixes;
   bool placeholder_fallback = false;
-  bool play_once = false;
   switch (emoteType)
   {
   default:
     break;
 
-  case PreEmote:
-    play_once = true;
-    break;
-
   case IdleEmote:
     prefixes << QStringLiteral("(a)") << QStringLiteral("(a)/");
     placeholder_fallback = true;
@@ -437,11 +629,11 @@ void CharacterAnimationLayer::loadCharacterEmote(QString character, QString file
   QVector<QString> prefixed_emote_list;
   for (const QString &prefix : std::as_const(prefixes))
   {
-    path_list << ao_app->get_character_path(character, prefix + m_emote);
-    prefixed_emote_list << prefix + m_emote;
+    path_list << ao_app->get_character_path(character, prefix + fileName);
+    prefixed_emote_list << prefix + fileName;
   }
-  path_list << ao_app->get_character_path(character, m_emote);
-  prefixed_emote_list << m_emote;
+  path_list << ao_app->get_character_path(character, fileName);
+  prefixed_emote_list << fileName;
 
   if (placeholder_fallback)
   {
@@ -453,20 +645,11 @@ void CharacterAnimationLayer::loadCharacterEmote(QString character, QString file
 
   int index = -1;
   QString file_path = ao_app->get_image_path(path_list, index);
-  if (index != -1)
+  if (resolvedEmote && index != -1)
   {
-    m_resolved_emote = prefixed_emote_list[index];
+    *resolvedEmote = prefixed_emote_list[index];
   }
-
-  setFileName(file_path);
-  setPlayOnce(play_once);
-  setResizeMode(ao_app->get_scaling(ao_app->get_emote_property(character, fileName, "scaling")));
-  setStretchToFit(ao_app->get_emote_property(character, fileName, "stretch").startsWith("true"));
-  if (synchronize_frame && previous_frame_count == frameCount())
-  {
-    jumpToFrame(previous_frame_number);
-  }
-  m_duration = durationLimit;
+  return file_path;
 }
 
 void CharacterAnimationLayer::setFrameEffects(QStringList data)
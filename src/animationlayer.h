@@ -1,5 +1,6 @@
 #pragma once
 
+#include "animationclock.h"
 #include "animationloader.h"
 #include "datatypes.h"
 
@@ -41,11 +42,22 @@ class VPath;
 
 namespace kal
 {
+class ViewportCompositor;
+
 class AnimationLayer : public QLabel
+    , public AnimationClock::Client
 {
   Q_OBJECT
 
 public:
+  /* Determines what happens when a frame is due but has not been decoded yet, see Options::lateFramePolicy */
+  enum LateFramePolicy
+  {
+    HoldPreviousFrame, /* Keep the previous frame on screen and resume once the late frame is ready */
+    SkipAhead,         /* Keep the animation running and drop frames that are not ready in time */
+    StallPlayback,     /* Block until the frame is ready */
+  };
+
   explicit AnimationLayer(QWidget *parent = nullptr);
   virtual ~AnimationLayer();
 
@@ -83,9 +95,16 @@ Q_SIGNALS:
   void frameNumberChanged(int frameNumber);
 
 protected:
+  void clockTick(qint64 time) override;
+  bool event(QEvent *event) override;
+  void changeEvent(QEvent *event) override;
+  void paintEvent(QPaintEvent *event) override;
   void resizeEvent(QResizeEvent *event) override;
 
 private:
+  friend class ViewportCompositor;
+
+  ViewportCompositor *m_compositor = nullptr;
   QString m_file_name;
   bool m_play_once = false;
   bool m_stretch_to_fit = false;
@@ -94,6 +113,7 @@ private:
   int m_minimum_duration = 0;
   int m_maximum_duration = 0;
   RESIZE_MODE m_resize_mode = AUTO_RESIZE_MODE;
+  LateFramePolicy m_late_frame_policy = SkipAhead;
   Qt::TransformationMode m_transformation_mode = Qt::FastTransformation;
   AnimationLoader *m_loader = nullptr;
   QSize m_frame_size;
@@ -103,28 +123,39 @@ private:
   QSize m_scaled_frame_size;
   bool m_processing = false;
   bool m_pause = false;
-  QTimer *m_ticker = nullptr;
+  bool m_tick_scheduled = false;
+  qint64 m_frame_time = 0;
+  qint64 m_next_frame_time = 0;
   bool m_first_frame = false;
   int m_frame_number = 0;
   int m_target_frame_number = -1;
   int m_frame_count = 0;
+  int m_current_frame_number = -1;
+  int m_late_frame_number = -1;
+  int m_retransformed_frame_number = -1;
   AnimationFrame m_current_frame;
 
   void createLoader();
+  void updateCompositor();
   void deleteLoader();
 
   void resetData();
 
   void calculateFrameGeometry();
+  void updateFrameTransform();
 
   void finishPlayback();
 
   void prepareNextTick();
+  void cancelNextTick();
 
   void displayCurrentFrame();
 
+  void handleLateFrame();
+
 private Q_SLOTS:
   void frameTicker();
+  void onFrameReady(int frameNumber);
 };
 
 class CharacterAnimationLayer : public AnimationLayer
@@ -160,6 +191,14 @@ public:
 
   void loadCharacterEmote(QString character, QString fileName, EmoteType emoteType, int durationLimit = 0);
 
+  /**
+   * @brief Finds the image file loadCharacterEmote() would display.
+   *
+   * @param resolvedEmote If not null, receives the emote name the file was
+   * found under, including its prefix.
+   */
+  static QString findEmoteFile(AOApplication *ao_app, QString character, QString fileName, EmoteType emoteType, QString *resolvedEmote = nullptr);
+
   void setFrameEffects(QStringList data);
 
 Q_SIGNALS:
@@ -1,12 +1,40 @@
 #include "animationloader.h"
 
+#include <QDebug>
 #include <QMutexLocker>
+#include <QTransform>
 #include <QtConcurrent/QtConcurrent>
 
 namespace kal
 {
-AnimationLoader::AnimationLoader(QThreadPool *threadPool)
-    : m_thread_pool(threadPool)
+QPixmap AnimationFrameTransform::apply(const QPixmap &texture) const
+{
+  QPixmap image = texture;
+
+  if (mask_rect.isValid())
+  {
+    image = image.copy(mask_rect);
+  }
+
+  if (!image.isNull())
+  {
+    if (size.isValid())
+    {
+      image = image.scaled(size, Qt::IgnoreAspectRatio, mode);
+    }
+
+    if (flipped)
+    {
+      image = image.transformed(QTransform().scale(-1.0, 1.0));
+    }
+  }
+
+  return image;
+}
+
+AnimationLoader::AnimationLoader(QThreadPool *threadPool, QObject *parent)
+    : QObject(parent)
+    , m_thread_pool(threadPool)
 {}
 
 AnimationLoader::~AnimationLoader()
@@ -27,79 +55,186 @@ void AnimationLoader::load(const QString &fileName)
   }
   stopLoading();
   m_file_name = fileName;
-  QImageReader *reader = new QImageReader;
-  reader->setFileName(fileName);
-  m_size = reader->size();
-  m_frames.clear();
-  m_frame_count = reader->imageCount();
-  m_loop_count = reader->loopCount();
-  m_exit_task = false;
-  m_task = QtConcurrent::run(m_thread_pool, [this, reader]() { populateVector(reader); });
+  m_data = AnimationFrameCache::getInstance().acquire(fileName);
+
+  // Pass frames through untouched until the layer knows its geometry, so that
+  // tryFrame has a task reporting progress and never needs to wait.
+  m_transform = AnimationFrameTransform();
+  m_has_transform = true;
+  startTransforming(0);
 }
 
 void AnimationLoader::stopLoading()
 {
-  m_exit_task = true;
-  if (m_task.isRunning())
+  stopTransforming();
+  m_has_transform = false;
+  if (m_data)
   {
-    m_task.waitForFinished();
+    AnimationFrameCache::getInstance().release(m_data);
+    m_data.reset();
   }
+  m_file_name.clear();
 }
 
 QSize AnimationLoader::size()
 {
-  return m_size;
+  return m_data ? m_data->size : QSize();
 }
 
 int AnimationLoader::frameCount()
 {
-  return m_frame_count;
+  return m_data ? m_data->frame_count : 0;
 }
 
 AnimationFrame AnimationLoader::frame(int frameNumber)
 {
-  if (m_frame_count <= 0)
+  if (!m_data || frameNumber < 0 || frameNumber >= m_data->frame_count)
   {
     return AnimationFrame();
   }
 
-  m_task_lock.lock();
-  while (m_frames.size() < frameNumber + 1)
+  if (m_has_transform)
+  {
+    QMutexLocker locker(&m_transform_lock);
+    while (!m_transformed_frame_ready.at(frameNumber))
+    {
+#ifdef DEBUG_MOVIE
+      qDebug().noquote() << "Waiting for transformed frame" << frameNumber << QString("(file: %1, frame count: %2)").arg(m_file_name).arg(m_data->frame_count);
+#endif
+      m_transform_signal.wait(&m_transform_lock);
+    }
+
+    return std::as_const(m_transformed_frames)[frameNumber];
+  }
+
+  QMutexLocker locker(&m_data->lock);
+  while (m_data->frames.size() < frameNumber + 1 && !m_data->finished)
   {
 #ifdef DEBUG_MOVIE
-    qDebug().noquote() << "Waiting for frame" << frameNumber << QString("(file: %1, frame count: %2)").arg(m_file_name).arg(m_frame_count);
+    qDebug().noquote() << "Waiting for frame" << frameNumber << QString("(file: %1, frame count: %2)").arg(m_file_name).arg(m_data->frame_count);
 #endif
-    m_task_signal.wait(&m_task_lock);
+    m_data->signal.wait(&m_data->lock);
   }
 
-  AnimationFrame frame = std::as_const(m_frames)[frameNumber];
-  m_task_lock.unlock();
+  if (frameNumber >= m_data->frames.size())
+  {
+    return AnimationFrame();
+  }
 
-  return frame;
+  return std::as_const(m_data->frames)[frameNumber];
+}
+
+std::optional<AnimationFrame> AnimationLoader::tryFrame(int frameNumber)
+{
+  if (!m_data || frameNumber < 0 || frameNumber >= m_data->frame_count)
+  {
+    return AnimationFrame();
+  }
+
+  if (!m_has_transform)
+  {
+    return AnimationFrame();
+  }
+
+  QMutexLocker locker(&m_transform_lock);
+  if (!m_transformed_frame_ready.at(frameNumber))
+  {
+#ifdef DEBUG_MOVIE
+    qDebug().noquote() << "Frame" << frameNumber << "is not ready yet" << QString("(file: %1, frame count: %2)").arg(m_file_name).arg(m_data->frame_count);
+#endif
+    return std::nullopt;
+  }
+
+  return std::as_const(m_transformed_frames)[frameNumber];
 }
 
 int AnimationLoader::loopCount()
 {
-  return m_loop_count;
+  return m_data ? m_data->loop_count : -1;
 }
 
-void AnimationLoader::populateVector(QImageReader *reader)
+void AnimationLoader::setFrameTransform(const AnimationFrameTransform &transform, int firstFrame)
 {
-  int loaded_frame_count = 0;
-  int frame_count = reader->imageCount();
-  while (!m_exit_task && loaded_frame_count < frame_count)
+  if (m_has_transform && m_transform == transform)
   {
+    return;
+  }
+  stopTransforming();
+  m_transform = transform;
+  m_has_transform = true;
+  startTransforming(firstFrame);
+}
+
+void AnimationLoader::startTransforming(int firstFrame)
+{
+  const int frame_count = frameCount();
+  {
+    QMutexLocker locker(&m_transform_lock);
+    m_transformed_frames = QList<AnimationFrame>(frame_count);
+    m_transformed_frame_ready = QList<bool>(frame_count, false);
+  }
+
+  if (frame_count <= 0)
+  {
+    return;
+  }
+
+  m_exit_transform_task = false;
+  m_transform_task = QtConcurrent::run(m_thread_pool, [this, firstFrame]() { populateTransformedVector(firstFrame); });
+}
+
+void AnimationLoader::stopTransforming()
+{
+  m_exit_transform_task = true;
+  if (m_data)
+  {
+    // The task may be waiting for the decoder; wake it up so it notices.
+    QMutexLocker locker(&m_data->lock);
+    m_data->signal.wakeAll();
+  }
+
+  if (m_transform_task.isRunning())
+  {
+    m_transform_task.waitForFinished();
+  }
+}
+
+void AnimationLoader::populateTransformedVector(int firstFrame)
+{
+  const int frame_count = m_data->frame_count;
+  firstFrame = qBound(0, firstFrame, frame_count - 1);
+  for (int i = 0; i < frame_count && !m_exit_transform_task; ++i)
+  {
+    const int frame_number = (firstFrame + i) % frame_count;
+
+    AnimationFrame frame;
     {
-      QMutexLocker locker(&m_task_lock);
-      AnimationFrame frame;
-      frame.texture = QPixmap::fromImage(reader->read());
-      frame.duration = reader->nextImageDelay();
-      m_frames.append(frame);
-      ++loaded_frame_count;
+      QMutexLocker locker(&m_data->lock);
+      while (m_data->frames.size() < frame_number + 1 && !m_data->finished && !m_exit_transform_task)
+      {
+        m_data->signal.wait(&m_data->lock);
+      }
+
+      if (m_exit_transform_task)
+      {
+        break;
+      }
+
+      if (frame_number < m_data->frames.size())
+      {
+        frame = std::as_const(m_data->frames)[frame_number];
+      }
     }
-    m_task_signal.wakeAll();
-  }
 
-  delete reader;
+    frame.texture = m_transform.apply(frame.texture);
+
+    {
+      QMutexLocker locker(&m_transform_lock);
+      m_transformed_frames[frame_number] = frame;
+      m_transformed_frame_ready[frame_number] = true;
+    }
+    m_transform_signal.wakeAll();
+    Q_EMIT frameReady(frame_number);
+  }
 }
 } // namespace kal
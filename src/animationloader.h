@@ -1,30 +1,46 @@
 #pragma once
 
+#include "animationframecache.h"
+
 #include <QFuture>
-#include <QImageReader>
 #include <QMutex>
 #include <QObject>
-#include <QPixmap>
+#include <QRect>
+#include <QSize>
 #include <QString>
+#include <QThreadPool>
 #include <QWaitCondition>
 
 #include <atomic>
+#include <memory>
+#include <optional>
 
 namespace kal
 {
-class AnimationFrame
+/**
+ * @brief Describes how decoded frames are turned into the pixmaps a layer displays.
+ *
+ * @details A transform without a valid size leaves the frames unscaled.
+ */
+class AnimationFrameTransform
 {
 public:
-  QPixmap texture;
-  int duration = 0;
+  QRect mask_rect;
+  QSize size;
+  Qt::TransformationMode mode = Qt::FastTransformation;
+  bool flipped = false;
+
+  bool operator==(const AnimationFrameTransform &other) const = default;
+
+  QPixmap apply(const QPixmap &texture) const;
 };
 
-class AnimationLoader
+class AnimationLoader : public QObject
 {
-  Q_DISABLE_COPY_MOVE(AnimationLoader)
+  Q_OBJECT
 
 public:
-  explicit AnimationLoader(QThreadPool *threadPool);
+  explicit AnimationLoader(QThreadPool *threadPool, QObject *parent = nullptr);
   virtual ~AnimationLoader();
 
   QString loadedFileName() const;
@@ -34,22 +50,50 @@ public:
   QSize size();
 
   int frameCount();
+
+  /**
+   * @brief Returns the frame, waiting for it to be decoded and transformed if necessary.
+   */
   AnimationFrame frame(int frameNumber);
 
+  /**
+   * @brief Returns the frame if it is ready, or std::nullopt otherwise.
+   *
+   * @details frameReady is emitted once a frame that was not ready becomes
+   * available.
+   */
+  std::optional<AnimationFrame> tryFrame(int frameNumber);
+
   int loopCount();
 
+  /**
+   * @brief Sets the transformation applied to every frame returned by frame().
+   *
+   * @details Frames are transformed on the thread pool, starting with
+   * firstFrame, and only again when the transformation changes. Loading
+   * a file resets the transformation to one that passes frames through.
+   */
+  void setFrameTransform(const AnimationFrameTransform &transform, int firstFrame = 0);
+
+Q_SIGNALS:
+  void frameReady(int frameNumber);
+
 private:
   QThreadPool *m_thread_pool;
   QString m_file_name;
-  QSize m_size;
-  int m_frame_count = 0;
-  int m_loop_count = -1;
-  QList<AnimationFrame> m_frames;
-  QFuture<void> m_task;
-  std::atomic_bool m_exit_task = false;
-  QMutex m_task_lock;
-  QWaitCondition m_task_signal;
-
-  void populateVector(QImageReader *reader);
+  std::shared_ptr<AnimationData> m_data;
+
+  bool m_has_transform = false;
+  AnimationFrameTransform m_transform;
+  QList<AnimationFrame> m_transformed_frames;
+  QList<bool> m_transformed_frame_ready;
+  QFuture<void> m_transform_task;
+  std::atomic_bool m_exit_transform_task = false;
+  QMutex m_transform_lock;
+  QWaitCondition m_transform_signal;
+
+  void startTransforming(int firstFrame);
+  void stopTransforming();
+  void populateTransformedVector(int firstFrame);
 };
 } // namespace kal
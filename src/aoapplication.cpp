@@ -2,11 +2,14 @@
 
 #include "courtroom.h"
 #include "debug_functions.h"
+#include "file_functions.h"
 #include "lobby.h"
 #include "networkmanager.h"
 #include "options.h"
 #include "widgets/aooptionsdialog.h"
 
+#include <QtConcurrent/QtConcurrent>
+
 static QtMessageHandler original_message_handler;
 static AOApplication *message_handler_context;
 
@@ -21,8 +24,25 @@ AOApplication::AOApplication(QObject *parent)
 {
   net_manager = new NetworkManager(this);
   discord = new AttorneyOnline::Discord();
+  log_writer = new LogWriter(this);
+  chat_history = new ChatHistory("logs/history");
 
   asset_lookup_cache.reserve(2048);
+  register_packet_handlers();
+
+  asset_index_watcher = new QFutureWatcher<std::shared_ptr<const AssetIndex>>(this);
+  connect(asset_index_watcher, &QFutureWatcherBase::finished, this, &AOApplication::asset_index_finished);
+
+  font_watcher = new QFutureWatcher<FontRegistry::Result>(this);
+  connect(font_watcher, &QFutureWatcherBase::finished, this, [this] {
+    const FontRegistry::Result result = font_watcher->result();
+    qInfo().noquote() << QString("startup: registered %1 fonts in %2 ms, skipped %3 duplicates and %4 other files").arg(result.registered).arg(result.elapsed_msecs).arg(result.duplicates).arg(result.invalid);
+    // Windows shown in the meantime may have fallen back to other fonts.
+    if (is_lobby_constructed())
+    {
+      w_lobby->update();
+    }
+  });
 
   message_handler_context = this;
   original_message_handler = qInstallMessageHandler(message_handler);
@@ -33,9 +53,24 @@ AOApplication::~AOApplication()
   destruct_lobby();
   destruct_courtroom();
   delete discord;
+  log_writer->stop();
+  delete chat_history;
   qInstallMessageHandler(original_message_handler);
 }
 
+void AOApplication::register_fonts()
+{
+  QStringList mounts = Options::getInstance().mountPaths();
+  mounts.prepend(get_base_path());
+
+  font_watcher->setFuture(QtConcurrent::run(&FontRegistry::registerFonts, mounts, get_base_path() + "font_manifest.cache"));
+}
+
+void AOApplication::wait_for_fonts()
+{
+  font_watcher->waitForFinished();
+}
+
 bool AOApplication::is_lobby_constructed()
 {
   return w_lobby;
@@ -91,6 +126,9 @@ void AOApplication::construct_courtroom()
     return;
   }
 
+  // Themes refer to fonts by family, so they all have to be there.
+  wait_for_fonts();
+
   w_courtroom = new Courtroom(this);
 
   centerOrMoveWidgetOnPrimaryScreen(w_courtroom);
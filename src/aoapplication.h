@@ -1,10 +1,17 @@
 #pragma once
 
 #include "aopacket.h"
+#include "assetindex.h"
+#include "characterini.h"
+#include "chathistory.h"
 #include "datatypes.h"
 #include "demoserver.h"
 #include "discord_rich_presence.h"
+#include "effecttable.h"
+#include "fontregistry.h"
+#include "logwriter.h"
 #include "serverdata.h"
+#include "themeconfig.h"
 #include "widgets/aooptionsdialog.h"
 
 #include <bass.h>
@@ -15,6 +22,7 @@
 #include <QDir>
 #include <QElapsedTimer>
 #include <QFile>
+#include <QFutureWatcher>
 #include <QObject>
 #include <QRect>
 #include <QScreen>
@@ -71,8 +79,40 @@ public:
   void construct_courtroom();
   void destruct_courtroom();
 
+  /**
+   * @brief What a packet handler did with a packet.
+   */
+  enum class PacketResult
+  {
+    Accepted,         ///< Handled, and recorded in the demo file if the handler records.
+    AcceptedNoRecord, ///< Handled, but kept out of the demo file.
+    Rejected,         ///< Ignored or malformed; counted as rejected and not recorded.
+  };
+
+  /**
+   * @brief A handler for one type of server packet, along with how often
+   * and how long it ran.
+   */
+  class PacketHandler
+  {
+  public:
+    using Function = PacketResult (AOApplication::*)(QStringList &content);
+
+    Function function = nullptr;
+    int minimum_arity = 0;
+    bool record_in_demo = true;
+
+    quint64 calls = 0;
+    /// Packets with too few fields or that the handler ignored.
+    quint64 rejected = 0;
+    qint64 total_nsecs = 0;
+    qint64 maximum_nsecs = 0;
+  };
+
   void server_packet_received(AOPacket p_packet);
 
+  const QHash<QString, PacketHandler> &get_packet_handlers() const;
+
   void send_server_packet(AOPacket p_packet);
 
   void call_settings_menu();
@@ -124,6 +164,8 @@ public:
   QString get_image_path(QVector<VPath> pathlist, bool static_image = false);
   QString get_sfx_path(QVector<VPath> pathlist);
   QString get_config_value(QString p_identifier, QString p_config, QString p_theme = QString(), QString p_subtheme = QString(), QString p_default_theme = QString(), QString p_misc = QString());
+  // Returns the merged p_config of the given theme, which is only read again once the theme is reloaded
+  std::shared_ptr<const ThemeConfig> get_theme_config(QString p_config, QString p_theme = QString(), QString p_subtheme = QString(), QString p_default_theme = QString(), QString p_misc = QString());
   QString get_asset(QString p_element, QString p_theme = QString(), QString p_subtheme = QString(), QString p_default_theme = QString(), QString p_misc = QString(), QString p_character = QString(), QString p_placeholder = QString());
   QString get_image(QString p_element, QString p_theme = QString(), QString p_subtheme = QString(), QString p_default_theme = QString(), QString p_misc = QString(), QString p_character = QString(), QString p_placeholder = QString(), bool static_image = false);
   QString get_sfx(QString p_sfx, QString p_misc = QString(), QString p_character = QString());
@@ -133,6 +175,31 @@ public:
   QString get_case_sensitive_path(QString p_file);
   QString get_real_path(const VPath &vpath, const QStringList &suffixes = {""});
 
+  // Lookup that is safe on worker threads. Uses index if there is one and
+  // otherwise probes mounts (lowest priority first), without the lookup caches
+  // or the case correction of get_real_path.
+  static QString find_real_path(const AssetIndex *index, const QStringList &mounts, const QString &vpath, const QStringList &suffixes = {""});
+
+  // The current asset index, or nullptr while it is being built
+  std::shared_ptr<const AssetIndex> get_asset_index() const;
+
+  // Rebuilds the asset index in the background. Until it is ready,
+  // get_real_path falls back to probing every mount path.
+  void refresh_asset_index();
+
+  // Blocks until the asset index is ready
+  void wait_for_asset_index();
+
+  // Registers the fonts of every mount path in the background
+  void register_fonts();
+
+  // Blocks until the fonts are registered
+  void wait_for_fonts();
+
+  // Amount of get_real_path calls, and how many of them found nothing
+  quint64 asset_lookups = 0;
+  quint64 asset_lookup_misses = 0;
+
   QString find_image(QStringList p_list);
 
   ////// Functions for reading and writing files //////
@@ -149,10 +216,6 @@ public:
   // exist.
   bool write_to_file(QString p_text, QString p_file, bool make_dir = false);
 
-  // Append text to the end of the file. make_dir would auto-create the
-  // directory if it doesn't exist.
-  bool append_to_file(QString p_text, QString p_file, bool make_dir = false);
-
   // Append to the currently open demo file if there is one
   void append_to_demofile(QString packet_string);
 
@@ -208,6 +271,9 @@ public:
   // Returns the value of p_search_line within target_tag and terminator_tag
   QString read_char_ini(QString p_char, QString p_search_line, QString target_tag);
 
+  // Returns the parsed char.ini of p_char, which is only read again once it changes
+  std::shared_ptr<const CharacterIni> get_char_ini(QString p_char);
+
   // Returns a QStringList of all key=value definitions on a given tag.
   QStringList read_ini_tags(VPath p_file, QString target_tag = QString());
 
@@ -249,6 +315,13 @@ public:
   // the value associated with fx_name, otherwise use fx_name + '_' + p_property.
   QString get_effect_property(QString fx_name, QString p_char, QString p_folder, QString p_property);
 
+  // Returns every property of fx_name at once. p_folder defaults to the
+  // character's effects folder.
+  EffectDescriptor get_effect_descriptor(QString fx_name, QString p_char, QString p_folder);
+
+  // Returns the effects.ini files of the theme and p_folder, compiled once.
+  std::shared_ptr<const EffectTable> get_effect_table(QString p_folder);
+
   // Returns the custom realisation used by the character.
   QString get_custom_realization(QString p_char);
 
@@ -338,9 +411,71 @@ public:
   QElapsedTimer demo_timer;
   DemoServer *demo_server = nullptr;
 
+  // Writes the log and demo files off the GUI thread
+  LogWriter *log_writer;
+
+  // Searchable copy of the IC and OOC lines written to the log files
+  ChatHistory *chat_history;
+
 private:
   QVector<ServerInfo> server_list;
+
+  // Implementations in packet_distribution.cpp
+  QHash<QString, PacketHandler> packet_handlers;
+
+  void register_packet_handler(QString header, int minimum_arity, bool record_in_demo, PacketHandler::Function function);
+  void register_packet_handlers();
+
+  PacketResult handle_decryptor_packet(QStringList &content);
+  PacketResult handle_id_packet(QStringList &content);
+  PacketResult handle_ct_packet(QStringList &content);
+  PacketResult handle_fl_packet(QStringList &content);
+  PacketResult handle_pn_packet(QStringList &content);
+  PacketResult handle_si_packet(QStringList &content);
+  PacketResult handle_chars_check_packet(QStringList &content);
+  PacketResult handle_sc_packet(QStringList &content);
+  PacketResult handle_sm_packet(QStringList &content);
+  PacketResult handle_fm_packet(QStringList &content);
+  PacketResult handle_fa_packet(QStringList &content);
+  PacketResult handle_done_packet(QStringList &content);
+  PacketResult handle_bn_packet(QStringList &content);
+  PacketResult handle_sp_packet(QStringList &content);
+  PacketResult handle_sd_packet(QStringList &content);
+  PacketResult handle_pv_packet(QStringList &content);
+  PacketResult handle_ms_packet(QStringList &content);
+  PacketResult handle_mc_packet(QStringList &content);
+  PacketResult handle_rt_packet(QStringList &content);
+  PacketResult handle_hp_packet(QStringList &content);
+  PacketResult handle_le_packet(QStringList &content);
+  PacketResult handle_arup_packet(QStringList &content);
+  PacketResult handle_il_packet(QStringList &content);
+  PacketResult handle_mu_packet(QStringList &content);
+  PacketResult handle_um_packet(QStringList &content);
+  PacketResult handle_bb_packet(QStringList &content);
+  PacketResult handle_kk_packet(QStringList &content);
+  PacketResult handle_kb_packet(QStringList &content);
+  PacketResult handle_bd_packet(QStringList &content);
+  PacketResult handle_zz_packet(QStringList &content);
+  PacketResult handle_ti_packet(QStringList &content);
+  PacketResult handle_check_packet(QStringList &content);
+  PacketResult handle_st_packet(QStringList &content);
+  PacketResult handle_auth_packet(QStringList &content);
+  PacketResult handle_jd_packet(QStringList &content);
+  PacketResult handle_ass_packet(QStringList &content);
+  PacketResult handle_pr_packet(QStringList &content);
+  PacketResult handle_pu_packet(QStringList &content);
+
+  void start_asset_index_build();
+  void asset_index_finished();
+
   QHash<size_t, QString> asset_lookup_cache;
+  // Lookups known to fail, keyed by vpath and suffixes. Cleared whenever the
+  // mount paths are refreshed or a new asset index arrives.
+  QSet<size_t> asset_miss_cache;
+  std::shared_ptr<const AssetIndex> asset_index;
+  QFutureWatcher<std::shared_ptr<const AssetIndex>> *asset_index_watcher;
+  bool asset_index_refresh_pending = false;
+  QFutureWatcher<FontRegistry::Result> *font_watcher;
   QHash<size_t, QString> dir_listing_cache;
   QSet<size_t> dir_listing_exist_cache;
 
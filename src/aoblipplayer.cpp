@@ -1,5 +1,7 @@
 #include "aoblipplayer.h"
 
+#include "samplecache.h"
+
 AOBlipPlayer::AOBlipPlayer(AOApplication *ao_app)
     : ao_app(ao_app)
 {}
@@ -19,18 +21,20 @@ void AOBlipPlayer::setMuted(bool enabled)
 void AOBlipPlayer::setBlip(QString blip)
 {
   QString path = ao_app->get_sfx_suffix(ao_app->get_sounds_path(blip));
+
+  // Consecutive messages usually share their blips, so keep the streams
+  // unless they were lost to a device reset.
+  BASS_CHANNELINFO info;
+  if (path == m_blip_path && BASS_ChannelGetInfo(m_stream[0], &info))
+  {
+    return;
+  }
+  m_blip_path = path;
+
   for (int i = 0; i < STREAM_COUNT; ++i)
   {
     BASS_StreamFree(m_stream[i]);
-
-    if (path.endsWith(".opus"))
-    {
-      m_stream[i] = BASS_OPUS_StreamCreateFile(FALSE, path.utf16(), 0, 0, BASS_UNICODE | BASS_ASYNCFILE);
-    }
-    else
-    {
-      m_stream[i] = BASS_StreamCreateFile(FALSE, path.utf16(), 0, 0, BASS_UNICODE | BASS_ASYNCFILE);
-    }
+    m_stream[i] = SampleCache::getInstance().createStream(path, BASS_UNICODE | BASS_ASYNCFILE);
   }
 
   updateInternalVolume();
@@ -31,6 +31,7 @@ private:
   int m_volume = 0;
   bool m_muted = false;
   HSTREAM m_stream[STREAM_COUNT]{};
+  QString m_blip_path;
   int m_cycle = 0;
 
   void updateInternalVolume();
@@ -1,6 +1,9 @@
 #include "aocharbutton.h"
 
 #include "file_functions.h"
+#include "thumbnailcache.h"
+
+#include <QPainter>
 
 AOCharButton::AOCharButton(AOApplication *ao_app, QWidget *parent)
     : QPushButton(parent)
@@ -22,6 +25,12 @@ AOCharButton::AOCharButton(AOApplication *ao_app, QWidget *parent)
   ui_selector->resize(selector_size, selector_size);
   ui_selector->setImage("char_selector");
   ui_selector->hide();
+
+  setStyleSheet("QPushButton { border-image: url(); }"
+                "QToolTip { background-image: url(); color: #000000; "
+                "background-color: #ffffff; border: 0px; }");
+
+  connect(&ThumbnailCache::getInstance(), &ThumbnailCache::thumbnailReady, this, &AOCharButton::onThumbnailReady);
 }
 
 void AOCharButton::setTaken(bool enabled)
@@ -39,24 +48,37 @@ void AOCharButton::setTaken(bool enabled)
 
 void AOCharButton::setCharacter(QString character)
 {
+  if (character == m_character)
+  {
+    return;
+  }
+  m_character = character;
+
   QString image_path = ao_app->get_image_suffix(ao_app->get_character_path(character, "char_icon"), true);
 
   setText(QString());
+  m_image = QPixmap();
+  m_image_path.clear();
 
   if (file_exists(image_path))
   {
-    setStyleSheet("QPushButton { border-image: url(\"" + image_path +
-                  "\") 0 0 0 0 stretch stretch; }"
-                  "QToolTip { background-image: url(); color: #000000; "
-                  "background-color: #ffffff; border: 0px; }");
+    m_image_path = image_path;
+    m_image = ThumbnailCache::getInstance().thumbnail(m_image_path, size());
   }
   else
   {
-    setStyleSheet("QPushButton { border-image: url(); }"
-                  "QToolTip { background-image: url(); color: #000000; "
-                  "background-color: #ffffff; border: 0px; }");
     setText(character);
   }
+  update();
+}
+
+void AOCharButton::onThumbnailReady(const QString &fileName, const QSize &size)
+{
+  if (fileName == m_image_path && size == this->size())
+  {
+    m_image = ThumbnailCache::getInstance().thumbnail(m_image_path, size);
+    update();
+  }
 }
 
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
@@ -81,3 +103,19 @@ void AOCharButton::leaveEvent(QEvent *event)
 
   QPushButton::leaveEvent(event);
 }
+
+void AOCharButton::paintEvent(QPaintEvent *event)
+{
+  if (m_image_path.isEmpty())
+  {
+    QPushButton::paintEvent(event);
+    return;
+  }
+
+  // Same as the stretched border-image this button used to be drawn with.
+  if (!m_image.isNull())
+  {
+    QPainter painter(this);
+    painter.drawPixmap(rect(), m_image);
+  }
+}
@@ -16,6 +16,7 @@ class AOCharButton : public QPushButton
 public:
   AOCharButton(AOApplication *ao_app, QWidget *parent);
 
+  // The icon is loaded in the background and shown once it is ready.
   void setCharacter(QString character);
 
   void setTaken(bool enabled);
@@ -27,10 +28,17 @@ protected:
   void enterEvent(QEnterEvent *event) override;
 #endif
   void leaveEvent(QEvent *event) override;
+  void paintEvent(QPaintEvent *event) override;
 
 private:
   AOApplication *ao_app;
   bool m_taken = false;
+  QString m_character;
+  QString m_image_path;
+  QPixmap m_image;
   AOImage *ui_taken;
   AOImage *ui_selector;
+
+private Q_SLOTS:
+  void onThumbnailReady(const QString &fileName, const QSize &size);
 };
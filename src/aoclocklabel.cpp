@@ -4,9 +4,14 @@ AOClockLabel::AOClockLabel(QWidget *parent)
     : QLabel(parent)
 {}
 
+AOClockLabel::~AOClockLabel()
+{
+  kal::AnimationClock::getInstance().stop(this);
+}
+
 void AOClockLabel::start()
 {
-  m_timer.start(1000 / 60, this);
+  kal::AnimationClock::getInstance().start(this);
 }
 
 void AOClockLabel::start(qint64 msecs)
@@ -36,13 +41,13 @@ void AOClockLabel::set(qint64 msecs, bool update_text)
 
 void AOClockLabel::pause()
 {
-  m_timer.stop();
+  kal::AnimationClock::getInstance().stop(this);
 }
 
 void AOClockLabel::stop()
 {
   this->setText("00:00:00.000");
-  m_timer.stop();
+  kal::AnimationClock::getInstance().stop(this);
 }
 
 void AOClockLabel::skip(qint64 msecs)
@@ -53,25 +58,19 @@ void AOClockLabel::skip(qint64 msecs)
 
 bool AOClockLabel::active()
 {
-  return m_timer.isActive();
+  return kal::AnimationClock::getInstance().isRunning(this);
 }
 
-void AOClockLabel::timerEvent(QTimerEvent *event)
+void AOClockLabel::clockTick(qint64 time)
 {
-  if (event->timerId() == m_timer.timerId())
+  Q_UNUSED(time);
+  if (QDateTime::currentDateTime() >= m_target_time)
   {
-    if (QDateTime::currentDateTime() >= m_target_time)
-    {
-      this->stop();
-      return;
-    }
-    qint64 ms_left = QDateTime::currentDateTime().msecsTo(m_target_time);
-    QTime timeleft = QTime(0, 0).addMSecs(ms_left % (1000 * 3600 * 24));
-    QString timestring = timeleft.toString("hh:mm:ss.zzz");
-    this->setText(timestring);
-  }
-  else
-  {
-    QWidget::timerEvent(event);
+    this->stop();
+    return;
   }
+  qint64 ms_left = QDateTime::currentDateTime().msecsTo(m_target_time);
+  QTime timeleft = QTime(0, 0).addMSecs(ms_left % (1000 * 3600 * 24));
+  QString timestring = timeleft.toString("hh:mm:ss.zzz");
+  this->setText(timestring);
 }
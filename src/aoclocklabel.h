@@ -1,17 +1,19 @@
 #pragma once
 
-#include <QBasicTimer>
+#include "animationclock.h"
+
 #include <QDateTime>
 #include <QDebug>
 #include <QLabel>
-#include <QTimerEvent>
 
 class AOClockLabel : public QLabel
+    , public kal::AnimationClock::Client
 {
   Q_OBJECT
 
 public:
   AOClockLabel(QWidget *parent);
+  ~AOClockLabel();
 
   void start();
   void start(qint64 msecs);
@@ -22,9 +24,8 @@ public:
   bool active();
 
 protected:
-  void timerEvent(QTimerEvent *event) override;
+  void clockTick(qint64 time) override;
 
 private:
-  QBasicTimer m_timer;
   QDateTime m_target_time;
 };
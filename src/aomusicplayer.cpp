@@ -2,6 +2,7 @@
 
 #include "file_functions.h"
 #include "options.h"
+#include "tracer.h"
 
 #include <bass.h>
 
@@ -34,6 +35,8 @@ QString AOMusicPlayer::playStream(QString song, int streamId, bool loopEnabled,
     flags |= BASS_SAMPLE_LOOP;
   }
 
+  AO_TRACE_SCOPE_ARG("AOMusicPlayer::playStream", song);
+
   QString f_path = song;
   HSTREAM newstream;
   if (f_path.startsWith("http"))
@@ -1,13 +1,97 @@
 #include "aopacket.h"
 
-QString AOPacket::encode(QString data)
+namespace
 {
-  return data.replace("#", "<num>").replace("%", "<percent>").replace("$", "<dollar>").replace("&", "<and>");
+QStringView escapeSequence(QChar character)
+{
+  switch (character.unicode())
+  {
+  case u'#':
+    return u"<num>";
+  case u'%':
+    return u"<percent>";
+  case u'$':
+    return u"<dollar>";
+  case u'&':
+    return u"<and>";
+  default:
+    return QStringView();
+  }
+}
+} // namespace
+
+QString AOPacket::encode(QStringView data)
+{
+  QString result;
+  result.reserve(encodedSize(data));
+  appendEncoded(result, data);
+  return result;
+}
+
+QString AOPacket::decode(QStringView data)
+{
+  static const QStringView escapes[][2]{{u"<num>", u"#"}, {u"<percent>", u"%"}, {u"<dollar>", u"$"}, {u"<and>", u"&"}};
+
+  qsizetype escape = data.indexOf(u'<');
+  if (escape == -1)
+  {
+    return data.toString();
+  }
+
+  QString result;
+  result.reserve(data.size());
+  qsizetype start = 0;
+  while (escape != -1)
+  {
+    result.append(data.mid(start, escape - start));
+    start = escape + 1;
+
+    const QStringView rest = data.mid(escape);
+    bool decoded = false;
+    for (const auto &[sequence, character] : escapes)
+    {
+      if (rest.startsWith(sequence))
+      {
+        result.append(character);
+        start = escape + sequence.size();
+        decoded = true;
+        break;
+      }
+    }
+    if (!decoded)
+    {
+      result.append(u'<');
+    }
+
+    escape = data.indexOf(u'<', start);
+  }
+  result.append(data.mid(start));
+
+  return result;
 }
 
-QString AOPacket::decode(QString data)
+AOPacket AOPacket::fromString(QStringView message)
 {
-  return data.replace("<num>", "#").replace("<percent>", "%").replace("<dollar>", "$").replace("<and>", "&");
+  AOPacket packet;
+
+  qsizetype separator = message.indexOf(u'#');
+  if (separator == -1)
+  {
+    packet.m_header = message.toString();
+    return packet;
+  }
+  packet.m_header = message.left(separator).toString();
+
+  packet.m_content.reserve(message.count(u'#'));
+  qsizetype start = separator + 1;
+  while ((separator = message.indexOf(u'#', start)) != -1)
+  {
+    packet.m_content.append(decode(message.mid(start, separator - start)));
+    start = separator + 1;
+  }
+  packet.m_content.append(decode(message.mid(start)));
+
+  return packet;
 }
 
 AOPacket::AOPacket()
@@ -34,18 +118,58 @@ QStringList &AOPacket::content()
 
 QString AOPacket::toString(bool ensureEncoded)
 {
-  QString message = m_header;
-  if (!m_content.isEmpty())
+  qsizetype size = m_header.size() + 2;
+  for (const QString &item : std::as_const(m_content))
   {
-    for (QString item : std::as_const(m_content))
+    size += 1 + (ensureEncoded ? encodedSize(item) : item.size());
+  }
+
+  QString message;
+  message.reserve(size);
+  message.append(m_header);
+  for (const QString &item : std::as_const(m_content))
+  {
+    message.append(u'#');
+    if (ensureEncoded)
     {
-      if (ensureEncoded)
-      {
-        item = encode(item);
-      }
-      message += "#" + item;
+      appendEncoded(message, item);
+    }
+    else
+    {
+      message.append(item);
+    }
+  }
+  message.append(u"#%");
+
+  return message;
+}
+
+qsizetype AOPacket::encodedSize(QStringView data)
+{
+  qsizetype size = data.size();
+  for (QChar character : data)
+  {
+    const QStringView sequence = escapeSequence(character);
+    if (!sequence.isNull())
+    {
+      size += sequence.size() - 1;
     }
   }
+  return size;
+}
 
-  return message + "#%";
+void AOPacket::appendEncoded(QString &target, QStringView data)
+{
+  qsizetype start = 0;
+  for (qsizetype i = 0; i < data.size(); ++i)
+  {
+    const QStringView sequence = escapeSequence(data.at(i));
+    if (!sequence.isNull())
+    {
+      target.append(data.mid(start, i - start));
+      target.append(sequence);
+      start = i + 1;
+    }
+  }
+  target.append(data.mid(start));
 }
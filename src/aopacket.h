@@ -3,12 +3,19 @@
 #include <QMetaType>
 #include <QString>
 #include <QStringList>
+#include <QStringView>
 
 class AOPacket
 {
 public:
-  static QString encode(QString data);
-  static QString decode(QString data);
+  static QString encode(QStringView data);
+  static QString decode(QStringView data);
+
+  /**
+   * @brief Parses a packet of the form HEADER#field#field, without the
+   * trailing #%, decoding every field.
+   */
+  static AOPacket fromString(QStringView message);
 
   AOPacket();
   AOPacket(QString header);
@@ -22,5 +29,8 @@ public:
 private:
   QString m_header;
   QStringList m_content;
+
+  static qsizetype encodedSize(QStringView data);
+  static void appendEncoded(QString &target, QStringView data);
 };
 Q_DECLARE_METATYPE(AOPacket)
@@ -0,0 +1,209 @@
+#include "assetindex.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtConcurrent/QtConcurrent>
+
+static const quint32 CACHE_MAGIC = 0x414F4149; // AOAI
+static const qint32 CACHE_VERSION = 1;
+
+// Symbolic links are followed, so bail out of directory cycles at some point.
+static const int MAXIMUM_DEPTH = 64;
+
+std::shared_ptr<const AssetIndex> AssetIndex::build(const QStringList &mounts, const QString &cacheFile)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  std::shared_ptr<AssetIndex> index = std::make_shared<AssetIndex>();
+  for (const QString &mount : mounts)
+  {
+    index->m_mounts.append(QDir(mount).absolutePath() + QLatin1Char('/'));
+  }
+
+  const QHash<QString, DirectoryTree> previous = loadCache(cacheFile);
+  const QList<DirectoryTree> trees = QtConcurrent::blockingMapped<QList<DirectoryTree>>(index->m_mounts, [&previous](const QString &mount) { return refreshMount(mount, previous.value(mount)); });
+
+  QHash<QString, DirectoryTree> cache;
+  for (int i = 0; i < trees.size(); ++i)
+  {
+    const DirectoryTree &tree = trees.at(i);
+    cache.insert(index->m_mounts.at(i), tree);
+
+    // Later mounts take priority, so simply let them overwrite earlier entries.
+    for (auto it = tree.constBegin(); it != tree.constEnd(); ++it)
+    {
+      const QString &directory_path = it.key();
+      index->m_entries.insert(directory_path.toLower(), Entry{directory_path, i});
+
+      const QString prefix = directory_path.isEmpty() ? QString() : directory_path + QLatin1Char('/');
+      for (const QString &file : it->files)
+      {
+        const QString file_path = prefix + file;
+        index->m_entries.insert(file_path.toLower(), Entry{file_path, i});
+      }
+    }
+  }
+
+  saveCache(cacheFile, cache);
+
+  qInfo().nospace() << "Indexed " << index->m_entries.size() << " assets in " << timer.elapsed() << "ms";
+  return index;
+}
+
+QString AssetIndex::find(const QString &vpath, const QStringList &suffixes) const
+{
+  const Entry *found = nullptr;
+  for (const QString &suffix : suffixes)
+  {
+    const QString key = QDir::cleanPath(vpath + suffix).toLower();
+    if (key.startsWith(QLatin1String("../")) || key == QLatin1String(".."))
+    {
+      qWarning() << "invalid path" << vpath + suffix << "(path is outside vfs)";
+      return QString();
+    }
+
+    auto it = m_entries.constFind(key);
+    if (it != m_entries.constEnd() && (!found || it->mount > found->mount))
+    {
+      found = &*it;
+    }
+  }
+
+  if (!found)
+  {
+    return QString();
+  }
+  return m_mounts.at(found->mount) + found->path;
+}
+
+qsizetype AssetIndex::size() const
+{
+  return m_entries.size();
+}
+
+void AssetIndex::refreshDirectory(const QString &mount, const QString &relativePath, const DirectoryTree &previous, DirectoryTree &result, int depth)
+{
+  if (depth > MAXIMUM_DEPTH)
+  {
+    qWarning() << "not indexing" << mount + relativePath << "(directory is nested too deep)";
+    return;
+  }
+
+  const QString physical_path = mount + relativePath;
+  QFileInfo info(physical_path);
+  if (!info.isDir())
+  {
+    return;
+  }
+
+  Directory directory;
+  const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+  auto it = previous.constFind(relativePath);
+  if (it != previous.constEnd() && it->modified == modified)
+  {
+    directory = *it;
+  }
+  else
+  {
+    QDir dir(physical_path);
+    directory.modified = modified;
+    directory.files = dir.entryList(QDir::Files | QDir::Hidden | QDir::System);
+    directory.directories = dir.entryList(QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot);
+  }
+  result.insert(relativePath, directory);
+
+  const QString prefix = relativePath.isEmpty() ? QString() : relativePath + QLatin1Char('/');
+  for (const QString &subdirectory : std::as_const(directory.directories))
+  {
+    refreshDirectory(mount, prefix + subdirectory, previous, result, depth + 1);
+  }
+}
+
+AssetIndex::DirectoryTree AssetIndex::refreshMount(const QString &mount, const DirectoryTree &previous)
+{
+  DirectoryTree result;
+  refreshDirectory(mount, QString(), previous, result);
+  return result;
+}
+
+QHash<QString, AssetIndex::DirectoryTree> AssetIndex::loadCache(const QString &cacheFile)
+{
+  QHash<QString, DirectoryTree> trees;
+
+  QFile file(cacheFile);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    return trees;
+  }
+
+  QDataStream in(&file);
+  quint32 magic = 0;
+  qint32 version = 0;
+  in >> magic >> version;
+  if (magic != CACHE_MAGIC || version != CACHE_VERSION)
+  {
+    qWarning() << "discarding asset index cache" << cacheFile << "(unknown format)";
+    return trees;
+  }
+
+  qint32 tree_count = 0;
+  in >> tree_count;
+  for (int i = 0; i < tree_count && in.status() == QDataStream::Ok; ++i)
+  {
+    QString mount;
+    qint32 directory_count = 0;
+    in >> mount >> directory_count;
+
+    DirectoryTree tree;
+    tree.reserve(directory_count);
+    for (int j = 0; j < directory_count && in.status() == QDataStream::Ok; ++j)
+    {
+      QString path;
+      Directory directory;
+      in >> path >> directory.modified >> directory.files >> directory.directories;
+      tree.insert(path, directory);
+    }
+    trees.insert(mount, tree);
+  }
+
+  if (in.status() != QDataStream::Ok)
+  {
+    qWarning() << "discarding asset index cache" << cacheFile << "(file is corrupted)";
+    trees.clear();
+  }
+
+  return trees;
+}
+
+void AssetIndex::saveCache(const QString &cacheFile, const QHash<QString, DirectoryTree> &trees)
+{
+  QSaveFile file(cacheFile);
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    qWarning() << "could not write asset index cache" << cacheFile;
+    return;
+  }
+
+  QDataStream out(&file);
+  out << CACHE_MAGIC << CACHE_VERSION << qint32(trees.size());
+  for (auto it = trees.constBegin(); it != trees.constEnd(); ++it)
+  {
+    out << it.key() << qint32(it->size());
+    for (auto directory = it->constBegin(); directory != it->constEnd(); ++directory)
+    {
+      out << directory.key() << directory->modified << directory->files << directory->directories;
+    }
+  }
+
+  if (!file.commit())
+  {
+    qWarning() << "could not write asset index cache" << cacheFile;
+  }
+}
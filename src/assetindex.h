@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+
+/**
+ * @brief Case-insensitive index of every file and directory found in the
+ * mount paths.
+ *
+ * @details The index is built by scanning the mount paths in parallel and is
+ * persisted to a cache file. On the next start, the cached directory listings
+ * are reused for every directory whose modification time did not change, so
+ * only directories that actually gained or lost entries are listed again.
+ *
+ * An index is immutable once built; a new one has to be built to pick up
+ * changes to the mount paths.
+ */
+class AssetIndex
+{
+public:
+  /**
+   * @brief Builds an index of mounts, using cacheFile to skip unchanged
+   * directories and updating it afterwards.
+   *
+   * @param mounts The mount paths, from lowest to highest priority.
+   */
+  static std::shared_ptr<const AssetIndex> build(const QStringList &mounts, const QString &cacheFile);
+
+  /**
+   * @brief Returns the physical path of the first existing vpath + suffix,
+   * honoring mount priority before suffix order. Returns an empty string if
+   * none exist.
+   */
+  QString find(const QString &vpath, const QStringList &suffixes) const;
+
+  qsizetype size() const;
+
+private:
+  class Entry
+  {
+  public:
+    QString path;
+    int mount = -1;
+  };
+
+  class Directory
+  {
+  public:
+    qint64 modified = 0;
+    QStringList files;
+    QStringList directories;
+  };
+
+  using DirectoryTree = QHash<QString, Directory>;
+
+  QStringList m_mounts;
+  QHash<QString, Entry> m_entries;
+
+  static void refreshDirectory(const QString &mount, const QString &relativePath, const DirectoryTree &previous, DirectoryTree &result, int depth = 0);
+  static DirectoryTree refreshMount(const QString &mount, const DirectoryTree &previous);
+
+  static QHash<QString, DirectoryTree> loadCache(const QString &cacheFile);
+  static void saveCache(const QString &cacheFile, const QHash<QString, DirectoryTree> &trees);
+};
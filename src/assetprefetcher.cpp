@@ -0,0 +1,167 @@
+#include "assetprefetcher.h"
+
+#include "animationlayer.h"
+#include "aoapplication.h"
+#include "datatypes.h"
+#include "options.h"
+#include "samplecache.h"
+
+AssetPrefetcher::AssetPrefetcher(AOApplication *ao_app)
+    : ao_app(ao_app)
+{}
+
+AssetPrefetcher::~AssetPrefetcher()
+{
+  clear();
+  release(m_current);
+}
+
+void AssetPrefetcher::enqueue(const QStringList &p_contents)
+{
+  // Fields past the showname only exist on servers with 2.6+ extensions.
+  const bool cccc_ic_support = ao_app->m_serverdata.get_feature(server::BASE_FEATURE_SET::CCCC_IC_SUPPORT);
+  auto field = [&p_contents, cccc_ic_support](int index) {
+    if (index >= p_contents.size() || (index >= SHOWNAME && !cccc_ic_support))
+    {
+      return QString();
+    }
+    return p_contents.at(index);
+  };
+
+  Assets assets;
+  QStringList sounds;
+  const QString f_char = field(CHAR_NAME);
+  const QString f_misc = ao_app->get_chat(f_char);
+
+  // Character emotes
+  const QString f_pre_emote = field(PRE_EMOTE);
+  if (!f_pre_emote.isEmpty() && f_pre_emote != "-")
+  {
+    acquireImage(assets, kal::CharacterAnimationLayer::findEmoteFile(ao_app, f_char, f_pre_emote, kal::CharacterAnimationLayer::PreEmote));
+  }
+  const QString f_emote = field(EMOTE);
+  if (!f_emote.isEmpty())
+  {
+    acquireImage(assets, kal::CharacterAnimationLayer::findEmoteFile(ao_app, f_char, f_emote, kal::CharacterAnimationLayer::IdleEmote));
+    acquireImage(assets, kal::CharacterAnimationLayer::findEmoteFile(ao_app, f_char, f_emote, kal::CharacterAnimationLayer::TalkEmote));
+  }
+  const QString f_other_name = field(OTHER_NAME);
+  const QString f_other_emote = field(OTHER_EMOTE);
+  if (!f_other_name.isEmpty() && !f_other_emote.isEmpty())
+  {
+    acquireImage(assets, kal::CharacterAnimationLayer::findEmoteFile(ao_app, f_other_name, f_other_emote, kal::CharacterAnimationLayer::IdleEmote));
+  }
+
+  // Shouts
+  QString f_shout;
+  QString f_shout_image;
+  const QString f_objection_mod = field(OBJECTION_MOD);
+  if (f_objection_mod.contains("4&"))
+  {
+    const QString f_custom_objection = f_objection_mod.split("4&")[1];
+    f_shout = "custom_objections/" + f_custom_objection.left(f_custom_objection.lastIndexOf("."));
+    f_shout_image = f_shout;
+  }
+  else
+  {
+    switch (f_objection_mod.toInt())
+    {
+    case 1:
+      f_shout = "holdit";
+      break;
+    case 2:
+      f_shout = "objection";
+      break;
+    case 3:
+      f_shout = "takethat";
+      break;
+    case 4:
+      f_shout = "custom";
+      break;
+    default:
+      break;
+    }
+    f_shout_image = f_shout == "custom" ? f_shout : f_shout + "_bubble";
+  }
+  if (!f_shout.isEmpty())
+  {
+    acquireImage(assets, ao_app->get_image(f_shout_image, Options::getInstance().theme(), Options::getInstance().subTheme(), ao_app->default_theme, f_misc, f_char, "placeholder"));
+    sounds.append(ao_app->get_sfx(f_shout, f_misc, f_char));
+  }
+
+  // Effects
+  const QStringList f_effect = field(EFFECTS).split("|");
+  if (!f_effect[0].isEmpty())
+  {
+    const QString f_folder = f_effect.size() > 2 ? f_effect[1] : QString();
+    if (Options::getInstance().effectsEnabled())
+    {
+      acquireImage(assets, ao_app->get_effect(f_effect[0], f_char, f_folder));
+    }
+    const QString f_effect_sound = f_effect.size() > 2 ? f_effect[2] : f_effect.value(1);
+    if (!f_effect_sound.isEmpty())
+    {
+      sounds.append(ao_app->get_sfx(f_effect_sound));
+    }
+  }
+
+  // Blips and SFX
+  QString f_blips = ao_app->get_blips(ao_app->get_blipname(f_char));
+  if (ao_app->m_serverdata.get_feature(server::BASE_FEATURE_SET::CUSTOM_BLIPS) && !field(BLIPNAME).isEmpty())
+  {
+    f_blips = ao_app->get_blips(field(BLIPNAME));
+  }
+  sounds.append(ao_app->get_sfx_suffix(ao_app->get_sounds_path(f_blips)));
+  const QString f_sfx_name = field(SFX_NAME);
+  if (!f_sfx_name.isEmpty() && f_sfx_name != "0" && f_sfx_name != "1")
+  {
+    sounds.append(ao_app->get_sfx(f_sfx_name));
+  }
+  SampleCache::getInstance().preload(sounds);
+
+  m_queue.enqueue(assets);
+}
+
+void AssetPrefetcher::dequeue()
+{
+  release(m_current);
+  if (!m_queue.isEmpty())
+  {
+    m_current = m_queue.dequeue();
+  }
+}
+
+void AssetPrefetcher::clear()
+{
+  while (!m_queue.isEmpty())
+  {
+    Assets assets = m_queue.dequeue();
+    release(assets);
+  }
+}
+
+void AssetPrefetcher::acquireImage(Assets &assets, const QString &fileName)
+{
+  if (fileName.isEmpty())
+  {
+    return;
+  }
+
+  for (const std::shared_ptr<kal::AnimationData> &data : std::as_const(assets.animations))
+  {
+    if (data->file_name == fileName)
+    {
+      return;
+    }
+  }
+  assets.animations.append(kal::AnimationFrameCache::getInstance().acquire(fileName, true));
+}
+
+void AssetPrefetcher::release(Assets &assets)
+{
+  for (const std::shared_ptr<kal::AnimationData> &data : std::as_const(assets.animations))
+  {
+    kal::AnimationFrameCache::getInstance().release(data);
+  }
+  assets.animations.clear();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "animationframecache.h"
+
+#include <QList>
+#include <QQueue>
+#include <QStringList>
+
+#include <memory>
+
+class AOApplication;
+
+/**
+ * @brief Warms the frame and sound caches for queued chat messages.
+ *
+ * @details Mirrors the chat message queue: every queued message holds the
+ * animations it is going to display, so they are decoded in the background
+ * while earlier messages are still on screen. Holds are released once the
+ * message after it is shown, or when the queue is skipped, which aborts any
+ * decoding nobody else is waiting for.
+ */
+class AssetPrefetcher
+{
+public:
+  explicit AssetPrefetcher(AOApplication *ao_app);
+  ~AssetPrefetcher();
+
+  /// Resolves the assets of a message that was just queued and starts loading them.
+  void enqueue(const QStringList &p_contents);
+
+  /// Moves on to the next queued message, releasing the assets of the one before.
+  void dequeue();
+
+  /// Releases the assets of every queued message.
+  void clear();
+
+private:
+  class Assets
+  {
+  public:
+    QList<std::shared_ptr<kal::AnimationData>> animations;
+  };
+
+  AOApplication *ao_app;
+  QQueue<Assets> m_queue;
+  Assets m_current;
+
+  void acquireImage(Assets &assets, const QString &fileName);
+  void release(Assets &assets);
+};
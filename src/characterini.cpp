@@ -0,0 +1,160 @@
+#include "characterini.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSettings>
+
+CharacterIni::CharacterIni(const QString &fileName)
+{
+  QSettings settings(fileName, QSettings::IniFormat);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+  settings.setIniCodec("UTF-8");
+#endif
+  const QStringList keys = settings.allKeys();
+  for (const QString &full_key : keys)
+  {
+    const qsizetype separator = full_key.indexOf(QLatin1Char('/'));
+    const QString group = separator == -1 ? QString() : full_key.left(separator);
+    const QString key = separator == -1 ? full_key : full_key.mid(separator + 1);
+    const QString value = settings.value(full_key).value<QString>();
+
+    Group &target = m_groups[group.toLower()];
+    target.values.insert(key.toLower(), value);
+    target.entries.append(key + "=" + value);
+  }
+
+  const Group emotions = m_groups.value(QStringLiteral("emotions"));
+  for (auto it = emotions.values.constBegin(); it != emotions.values.constEnd(); ++it)
+  {
+    bool is_number = false;
+    const int number = it.key().toInt(&is_number);
+    if (!is_number)
+    {
+      continue;
+    }
+
+    const QStringList contents = it.value().split("#");
+    Emote emote;
+    emote.valid = contents.size() >= 4;
+    if (emote.valid)
+    {
+      emote.comment = contents.at(0);
+      emote.pre_emote = contents.at(1);
+      emote.animation = contents.at(2);
+      emote.modifier = contents.at(3).toInt();
+    }
+    if (contents.size() >= 5 && !contents.at(4).isEmpty())
+    {
+      emote.desk_modifier = contents.at(4).toInt();
+    }
+    m_emotes.insert(number - 1, emote);
+  }
+}
+
+QString CharacterIni::value(const QString &group, const QString &key) const
+{
+  auto it = m_groups.constFind(group.toLower());
+  if (it == m_groups.constEnd())
+  {
+    return QString();
+  }
+  return it->values.value(key.toLower());
+}
+
+QStringList CharacterIni::entries(const QString &group) const
+{
+  return m_groups.value(group.toLower()).entries;
+}
+
+QString CharacterIni::option(const QString &key) const
+{
+  return value(QStringLiteral("Options"), key);
+}
+
+int CharacterIni::emoteCount() const
+{
+  return value(QStringLiteral("Emotions"), QStringLiteral("number")).toInt();
+}
+
+const CharacterIni::Emote &CharacterIni::emote(int index) const
+{
+  static const Emote invalid_emote;
+  auto it = m_emotes.constFind(index);
+  if (it == m_emotes.constEnd())
+  {
+    return invalid_emote;
+  }
+  return *it;
+}
+
+QString CharacterIni::soundName(int emote) const
+{
+  return value(QStringLiteral("SoundN"), QString::number(emote + 1));
+}
+
+QString CharacterIni::soundDelay(int emote) const
+{
+  return value(QStringLiteral("SoundT"), QString::number(emote + 1));
+}
+
+QString CharacterIni::soundLooping(int emote) const
+{
+  return value(QStringLiteral("SoundL"), QString::number(emote + 1));
+}
+
+QString CharacterIni::frameEffect(const QString &emote, const QString &effect, int frame) const
+{
+  return value(emote + effect, QString::number(frame));
+}
+
+CharacterIniCache &CharacterIniCache::getInstance()
+{
+  static CharacterIniCache instance;
+  return instance;
+}
+
+CharacterIniCache::CharacterIniCache()
+    : m_empty(std::make_shared<const CharacterIni>())
+{}
+
+std::shared_ptr<const CharacterIni> CharacterIniCache::get(const QString &fileName)
+{
+  if (fileName.isEmpty())
+  {
+    return m_empty;
+  }
+
+  const qint64 modified = QFileInfo(fileName).lastModified().toMSecsSinceEpoch();
+
+  {
+    QMutexLocker locker(&m_lock);
+    auto it = m_entries.constFind(fileName);
+    if (it != m_entries.constEnd() && it->modified == modified)
+    {
+      return it->ini;
+    }
+  }
+
+  // Parsed without holding the lock, so that lookups of other files are not
+  // held up. If another thread parsed the same file meanwhile, its result is
+  // kept and this one is dropped.
+  Entry entry;
+  entry.modified = modified;
+  entry.ini = std::make_shared<const CharacterIni>(fileName);
+
+  QMutexLocker locker(&m_lock);
+  auto it = m_entries.find(fileName);
+  if (it != m_entries.end() && it->modified == modified)
+  {
+    return it->ini;
+  }
+  m_entries.insert(fileName, entry);
+  return entry.ini;
+}
+
+void CharacterIniCache::clear()
+{
+  QMutexLocker locker(&m_lock);
+  m_entries.clear();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+
+/**
+ * @brief A parsed char.ini.
+ *
+ * @details The file is read once on construction; lookups afterwards never
+ * touch the disk. Group and key lookups are case-insensitive.
+ */
+class CharacterIni
+{
+public:
+  class Emote
+  {
+  public:
+    QString comment;
+    QString pre_emote;
+    QString animation;
+    int modifier = 0;
+    int desk_modifier = -1;
+
+    /// False if the emote has less than the four mandatory fields.
+    bool valid = false;
+  };
+
+  CharacterIni() = default;
+  explicit CharacterIni(const QString &fileName);
+
+  QString value(const QString &group, const QString &key) const;
+
+  /// Returns every key=value definition of group.
+  QStringList entries(const QString &group) const;
+
+  QString option(const QString &key) const;
+
+  int emoteCount() const;
+
+  /// Returns the emote with the given zero-based index, or an invalid emote.
+  const Emote &emote(int index) const;
+
+  QString soundName(int emote) const;
+  QString soundDelay(int emote) const;
+  QString soundLooping(int emote) const;
+
+  /// Returns the value of the per-frame effect (_FrameSFX, _FrameScreenshake, ...) of an emote.
+  QString frameEffect(const QString &emote, const QString &effect, int frame) const;
+
+private:
+  class Group
+  {
+  public:
+    QHash<QString, QString> values;
+    QStringList entries;
+  };
+
+  QHash<QString, Group> m_groups;
+  QHash<int, Emote> m_emotes;
+};
+
+/**
+ * @brief Process-wide cache of parsed char.ini files.
+ *
+ * @details Entries are keyed by physical path and are parsed again once the
+ * modification time of the file changes.
+ */
+class CharacterIniCache
+{
+  Q_DISABLE_COPY_MOVE(CharacterIniCache)
+
+public:
+  static CharacterIniCache &getInstance();
+
+  /**
+   * @brief Returns the parsed file at fileName. An empty fileName yields an
+   * empty char.ini.
+   */
+  std::shared_ptr<const CharacterIni> get(const QString &fileName);
+
+  void clear();
+
+private:
+  class Entry
+  {
+  public:
+    qint64 modified = 0;
+    std::shared_ptr<const CharacterIni> ini;
+  };
+
+  CharacterIniCache();
+
+  QMutex m_lock;
+  QHash<QString, Entry> m_entries;
+  std::shared_ptr<const CharacterIni> m_empty;
+};
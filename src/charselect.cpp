@@ -4,6 +4,10 @@
 #include "debug_functions.h"
 #include "file_functions.h"
 #include "hardware_functions.h"
+#include "thumbnailcache.h"
+
+#include <QStyle>
+#include <QtConcurrent/QtConcurrent>
 
 void Courtroom::construct_char_select()
 {
@@ -64,6 +68,8 @@ void Courtroom::construct_char_select()
   connect(ui_char_search, &QLineEdit::textEdited, this, &Courtroom::on_char_search_changed);
   connect(ui_char_passworded, &QCheckBox::stateChanged, this, &Courtroom::on_char_passworded_clicked);
   connect(ui_char_taken, &QCheckBox::stateChanged, this, &Courtroom::on_char_taken_clicked);
+
+  connect(&ThumbnailCache::getInstance(), &ThumbnailCache::thumbnailReady, this, &Courtroom::on_char_icon_ready);
 }
 
 void Courtroom::set_char_select()
@@ -122,10 +128,10 @@ void Courtroom::set_char_select_page()
     i_button->move(0, 0);
   }
 
-  int total_pages = ui_char_button_list_filtered.size() / max_chars_on_page;
+  int total_pages = char_list_filtered.size() / max_chars_on_page;
   int chars_on_page = 0;
 
-  if (ui_char_button_list_filtered.size() % max_chars_on_page != 0)
+  if (char_list_filtered.size() % max_chars_on_page != 0)
   {
     ++total_pages;
     // i. e. not on the last page
@@ -135,7 +141,7 @@ void Courtroom::set_char_select_page()
     }
     else
     {
-      chars_on_page = ui_char_button_list_filtered.size() % max_chars_on_page;
+      chars_on_page = char_list_filtered.size() % max_chars_on_page;
     }
   }
   else
@@ -214,8 +220,14 @@ void Courtroom::char_clicked(int n_char)
 void Courtroom::on_char_button_context_menu_requested(const QPoint &pos)
 {
   AOCharButton *button = qobject_cast<AOCharButton *>(sender());
-  int n_char = ui_char_button_list.indexOf(button);
-  if (n_char == -1)
+  int n_button = ui_char_button_list.indexOf(button);
+  if (n_button == -1)
+  {
+    return;
+  }
+
+  int n_char = ui_char_button_ids.at(n_button);
+  if (n_char < 0 || n_char >= char_list.size())
   {
     return;
   }
@@ -243,9 +255,28 @@ void Courtroom::on_char_button_context_menu_requested(const QPoint &pos)
   menu->popup(button->mapToGlobal(pos));
 }
 
+AOCharButton *Courtroom::get_char_button(int index)
+{
+  while (ui_char_button_list.size() <= index)
+  {
+    const int n_button = ui_char_button_list.size();
+
+    AOCharButton *char_button = new AOCharButton(ao_app, ui_char_buttons);
+    char_button->setContextMenuPolicy(Qt::CustomContextMenu);
+    char_button->hide();
+
+    connect(char_button, &AOCharButton::clicked, this, [this, n_button]() { this->char_clicked(ui_char_button_ids.at(n_button)); });
+    connect(char_button, &AOCharButton::customContextMenuRequested, this, &Courtroom::on_char_button_context_menu_requested);
+
+    ui_char_button_list.append(char_button);
+    ui_char_button_ids.append(-1);
+  }
+  return ui_char_button_list.at(index);
+}
+
 void Courtroom::put_button_in_place(int starting, int chars_on_this_page)
 {
-  if (ui_char_button_list_filtered.size() == 0)
+  if (char_list_filtered.size() == 0)
   {
     return;
   }
@@ -262,8 +293,16 @@ void Courtroom::put_button_in_place(int starting, int chars_on_this_page)
     int x_pos = (size + f_spacing.x()) * x_mod_count;
     int y_pos = (size + f_spacing.y()) * y_mod_count;
 
-    ui_char_button_list_filtered.at(n)->move(x_pos, y_pos);
-    ui_char_button_list_filtered.at(n)->show();
+    const int n_char = char_list_filtered.at(n);
+    const CharacterSlot &character = char_list.at(n_char);
+
+    AOCharButton *char_button = get_char_button(n - starting);
+    ui_char_button_ids[n - starting] = n_char;
+    char_button->setCharacter(character.name);
+    char_button->setTaken(character.taken);
+    char_button->setToolTip(character.name);
+    char_button->move(x_pos, y_pos);
+    char_button->show();
 
     ++x_mod_count;
 
@@ -279,63 +318,100 @@ void Courtroom::character_loading_finished()
 {
   // Zeroeth, we'll clear any leftover characters from previous server visits.
   ao_app->generated_chars = 0;
-  if (ui_char_button_list.size() > 0)
+  for (AOCharButton *char_button : std::as_const(ui_char_button_list))
   {
-    foreach (AOCharButton *item, ui_char_button_list)
-    {
-      delete item;
-    }
-    ui_char_button_list.clear();
-    ui_char_list->clear();
+    char_button->hide();
+  }
+  ui_char_button_ids.fill(-1);
+  ui_char_list->clear();
+  ui_char_list_items.clear();
+  ui_char_list_pending_icons.clear();
+  char_categories.clear();
+
+  // Every char.ini is needed for the categories, so find and parse them, and
+  // find the icons, in parallel in the background and build the tree once
+  // they are all known. A previous load that is still running is superseded.
+  QStringList char_names;
+  char_names.reserve(char_list.size());
+  for (const CharacterSlot &character : std::as_const(char_list))
+  {
+    char_names.append(character.name);
+  }
+
+  std::shared_ptr<const AssetIndex> index = ao_app->get_asset_index();
+  QStringList mounts = Options::getInstance().mountPaths();
+  mounts.prepend(get_base_path());
+  char_list_watcher.setFuture(QtConcurrent::mapped(std::move(char_names), [index, mounts](const QString &name) {
+    const QString char_path = "characters/" + name + "/";
+    CharacterListEntry entry;
+    entry.ini = CharacterIniCache::getInstance().get(AOApplication::find_real_path(index.get(), mounts, char_path + "char.ini"));
+    entry.icon_path = AOApplication::find_real_path(index.get(), mounts, char_path + "char_icon", {".png"});
+    return entry;
+  }));
+}
+
+void Courtroom::build_character_list()
+{
+  const QList<CharacterListEntry> entries = char_list_watcher.future().results();
+  if (entries.size() != char_list.size())
+  {
+    return;
   }
 
-  // First, we'll make all the character buttons in the very beginning.
-  // We also hide them all, so they can't be accidentally clicked.
-  // Later on, we'll be revealing buttons as we need them.
+  const int icon_size = ui_char_list->style()->pixelMetric(QStyle::PM_SmallIconSize);
+  QHash<QString, QTreeWidgetItem *> categories;
+
+  // Buttons are only created once a page is shown, so we just have to build
+  // the character tree here.
   for (int i = 0; i < char_list.size(); i++)
   {
     const CharacterSlot &character = char_list.at(i);
+    const CharacterListEntry &entry = entries.at(i);
+
+    QString char_category = entry.ini->option("category");
+    char_categories.append(char_category);
 
-    AOCharButton *char_button = new AOCharButton(ao_app, ui_char_buttons);
-    char_button->setContextMenuPolicy(Qt::CustomContextMenu);
-    char_button->hide();
-    char_button->setCharacter(character.name);
-    char_button->setTaken(character.taken);
-    char_button->setToolTip(character.name);
-    ui_char_button_list.append(char_button);
-    QString char_category = ao_app->get_category(character.name);
-    QList<QTreeWidgetItem *> matching_list = ui_char_list->findItems(char_category, Qt::MatchFixedString, 0);
     // create the character tree item
     QTreeWidgetItem *treeItem = new QTreeWidgetItem();
     treeItem->setText(0, character.name);
-    treeItem->setIcon(0, QIcon(ao_app->get_image_suffix(ao_app->get_character_path(character.name, "char_icon"), true)));
     treeItem->setText(1, QString::number(i));
+    ui_char_list_items.append(treeItem);
+
+    if (!entry.icon_path.isEmpty())
+    {
+      const QSize size(icon_size, icon_size);
+      QPixmap icon = ThumbnailCache::getInstance().thumbnail(entry.icon_path, size);
+      if (!icon.isNull())
+      {
+        treeItem->setIcon(0, icon);
+      }
+      else if (ThumbnailCache::getInstance().isLoading(entry.icon_path, size))
+      {
+        // Icons that failed to load are cached as null pixmaps and never
+        // become ready, so only the ones still loading wait for it.
+        ui_char_list_pending_icons.insert(entry.icon_path, treeItem);
+      }
+    }
+
     // category logic
-    QTreeWidgetItem *category;
     if (char_category == "") // no category
     {
       ui_char_list->addTopLevelItem(treeItem);
     }
-    else if (!matching_list.isEmpty())
-    { // our category already exists
-      category = matching_list[0];
-      category->addChild(treeItem);
-    }
     else
-    { // we need to make a new category
-      category = new QTreeWidgetItem();
-      category->setText(0, char_category);
-      category->setText(1, "-1");
-      category->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicatorWhenChildless);
-      ui_char_list->insertTopLevelItem(0, category);
+    {
+      QTreeWidgetItem *&category = categories[char_category.toLower()];
+      if (!category)
+      { // we need to make a new category
+        category = new QTreeWidgetItem();
+        category->setText(0, char_category);
+        category->setText(1, "-1");
+        category->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicatorWhenChildless);
+        ui_char_list->addTopLevelItem(category);
+      }
       category->addChild(treeItem);
     }
 
-    ui_char_list->sortItems(0, Qt::AscendingOrder);
-
-    connect(char_button, &AOCharButton::clicked, this, [this, i]() { this->char_clicked(i); });
-    connect(char_button, &AOCharButton::customContextMenuRequested, this, &Courtroom::on_char_button_context_menu_requested);
-
     // This part here serves as a way of showing to the player that the game is
     // still running, it is just loading the pictures of the characters.
     if (ao_app->is_lobby_constructed())
@@ -343,16 +419,43 @@ void Courtroom::character_loading_finished()
       ao_app->generated_chars++;
     }
   }
+  ui_char_list->sortItems(0, Qt::AscendingOrder);
   ui_char_list->expandAll();
+
+  // The page may already be shown without the characters.
+  if (ui_char_select_background->isVisible())
+  {
+    filter_character_list();
+  }
+}
+
+void Courtroom::on_char_icon_ready(const QString &fileName, const QSize &size)
+{
+  const QList<QTreeWidgetItem *> items = ui_char_list_pending_icons.values(fileName);
+  if (items.isEmpty())
+  {
+    return;
+  }
+
+  // Failed loads are dropped from the pending icons as well, without an icon.
+  QPixmap icon = ThumbnailCache::getInstance().thumbnail(fileName, size);
+  if (!icon.isNull())
+  {
+    for (QTreeWidgetItem *item : items)
+    {
+      item->setIcon(0, icon);
+    }
+  }
+  ui_char_list_pending_icons.remove(fileName);
 }
 
 void Courtroom::filter_character_list()
 {
-  ui_char_button_list_filtered.clear();
-  for (int i = 0; i < char_list.size(); i++)
+  char_list_filtered.clear();
+  const int char_count = qMin(char_list.size(), ui_char_list_items.size());
+  for (int i = 0; i < char_count; i++)
   {
-    AOCharButton *current_char = ui_char_button_list.at(i);
-    QTreeWidgetItem *current_char_list_item = ui_char_list->findItems(QString::number(i), Qt::MatchExactly | Qt::MatchRecursive, 1).at(0);
+    QTreeWidgetItem *current_char_list_item = ui_char_list_items.at(i);
 
     // It seems passwording characters is unimplemented yet?
     // Until then, this will stay here, I suppose.
@@ -365,17 +468,14 @@ void Courtroom::filter_character_list()
       continue;
     }
 
-    if (!char_list.at(i).name.contains(ui_char_search->text(), Qt::CaseInsensitive) && !ao_app->get_category(char_list.at(i).name).contains(ui_char_search->text(), Qt::CaseInsensitive))
+    if (!char_list.at(i).name.contains(ui_char_search->text(), Qt::CaseInsensitive) && !char_categories.at(i).contains(ui_char_search->text(), Qt::CaseInsensitive))
     {
       current_char_list_item->setHidden(true);
       continue;
     }
 
-    // We only really need to update the fact that a character is taken
-    // for the buttons that actually appear.
     // You'd also update the passwordedness and etc. here later.
     current_char_list_item->setHidden(false);
-    current_char->setTaken(char_list.at(i).taken);
     current_char_list_item->setText(0, char_list.at(i).name);
     // reset disabled
     current_char_list_item->setDisabled(false);
@@ -384,7 +484,7 @@ void Courtroom::filter_character_list()
       current_char_list_item->setDisabled(true);
     }
 
-    ui_char_button_list_filtered.append(current_char);
+    char_list_filtered.append(i);
   }
 
   current_char_page = 0;
@@ -0,0 +1,488 @@
+#include "chathistory.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QtConcurrent/QtConcurrent>
+
+#include <algorithm>
+#include <limits>
+
+ChatHistory::ChatHistory(const QString &path)
+    : m_path(path)
+    , m_indexes(INDEX_CACHE_SIZE)
+{
+  m_worker.setMaxThreadCount(1);
+}
+
+ChatHistory::~ChatHistory()
+{
+  m_worker.waitForDone();
+  m_file.close();
+}
+
+QString ChatHistory::path() const
+{
+  return m_path;
+}
+
+void ChatHistory::append(const Entry &entry)
+{
+  m_worker.start([this, entry] { write(entry); });
+}
+
+QFuture<QVector<ChatHistory::Entry>> ChatHistory::search(const Query &query)
+{
+  return QtConcurrent::run(&m_worker, [this, query] { return find(query); });
+}
+
+void ChatHistory::write(const Entry &entry)
+{
+  if (!open())
+  {
+    return;
+  }
+
+  const QByteArray payload = serialize(entry);
+  QByteArray data;
+  QDataStream out(&data, QIODevice::WriteOnly);
+  out << quint32(payload.size());
+  data.append(payload);
+
+  const qint64 offset = m_file.size();
+  if (!m_file.seek(offset) || m_file.write(data) != data.size() || !m_file.flush())
+  {
+    qWarning() << "could not write to chat history" << m_file.fileName() << m_file.errorString();
+    return;
+  }
+  m_active_index.add(entry, offset);
+
+  if (m_active_index.offsets.size() >= SEGMENT_SIZE)
+  {
+    seal();
+  }
+}
+
+QVector<ChatHistory::Entry> ChatHistory::find(const Query &query)
+{
+  QVector<Entry> results;
+  if (!open() || query.limit <= 0 || (!query.in_character && !query.out_of_character))
+  {
+    return results;
+  }
+
+  QStringList terms;
+  for (const QString &word : words(query.text))
+  {
+    terms.append("w:" + word);
+  }
+  if (!query.character.trimmed().isEmpty())
+  {
+    terms.append("c:" + query.character.trimmed().toCaseFolded());
+  }
+  if (!query.showname.trimmed().isEmpty())
+  {
+    terms.append("n:" + query.showname.trimmed().toCaseFolded());
+  }
+  if (!query.server.trimmed().isEmpty())
+  {
+    terms.append("s:" + query.server.trimmed().toCaseFolded());
+  }
+
+  const qint64 from = query.from.isValid() ? query.from.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+  const qint64 to = query.to.isValid() ? query.to.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max();
+
+  for (int i = m_segments.size() - 1; i >= 0 && results.size() < query.limit; --i)
+  {
+    const int segment = m_segments.at(i);
+    const SegmentIndex *segment_index = index(segment);
+    if (!segment_index || segment_index->timestamps.isEmpty())
+    {
+      continue;
+    }
+    if (segment_index->timestamps.first() > to)
+    {
+      continue;
+    }
+    if (segment_index->timestamps.last() < from)
+    {
+      // Segments are written in order, the older ones can't match either.
+      break;
+    }
+
+    QVector<quint32> matches;
+    if (terms.isEmpty())
+    {
+      matches.reserve(segment_index->offsets.size());
+      for (int j = 0; j < segment_index->offsets.size(); ++j)
+      {
+        matches.append(j);
+      }
+    }
+    else
+    {
+      // Intersect the shortest posting lists first.
+      QVector<const QVector<quint32> *> postings;
+      for (const QString &term : std::as_const(terms))
+      {
+        auto it = segment_index->postings.constFind(term);
+        if (it == segment_index->postings.constEnd())
+        {
+          postings.clear();
+          break;
+        }
+        postings.append(&*it);
+      }
+      if (postings.isEmpty())
+      {
+        continue;
+      }
+      std::sort(postings.begin(), postings.end(), [](const auto *a, const auto *b) { return a->size() < b->size(); });
+
+      matches = *postings.first();
+      for (int j = 1; j < postings.size() && !matches.isEmpty(); ++j)
+      {
+        QVector<quint32> intersection;
+        std::set_intersection(matches.constBegin(), matches.constEnd(), postings.at(j)->constBegin(), postings.at(j)->constEnd(), std::back_inserter(intersection));
+        matches.swap(intersection);
+      }
+    }
+
+    QFile file(segmentFileName(segment));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+      qWarning() << "could not read chat history" << file.fileName() << file.errorString();
+      continue;
+    }
+
+    for (int j = matches.size() - 1; j >= 0 && results.size() < query.limit; --j)
+    {
+      const quint32 line = matches.at(j);
+      const qint64 timestamp = segment_index->timestamps.at(line);
+      const Kind kind = Kind(segment_index->kinds.at(line));
+      if (timestamp < from || timestamp > to || (kind == InCharacter && !query.in_character) || (kind == OutOfCharacter && !query.out_of_character))
+      {
+        continue;
+      }
+
+      Entry entry;
+      if (!file.seek(segment_index->offsets.at(line)) || !readEntry(file, entry))
+      {
+        qWarning() << "could not read line" << line << "of chat history" << file.fileName();
+        continue;
+      }
+      results.append(entry);
+    }
+  }
+
+  return results;
+}
+
+QStringList ChatHistory::words(const QString &text)
+{
+  // Escapes such as \n and \s aren't part of the words around them.
+  static QRegularExpression escapes("\\\\.");
+  static QRegularExpression separators("[^\\p{L}\\p{N}]+");
+
+  QStringList result;
+  for (const QString &word : QString(text).replace(escapes, " ").split(separators, Qt::SkipEmptyParts))
+  {
+    const QString folded = word.left(MAXIMUM_WORD_LENGTH).toCaseFolded();
+    if (!result.contains(folded))
+    {
+      result.append(folded);
+    }
+  }
+  return result;
+}
+
+void ChatHistory::SegmentIndex::add(const Entry &entry, qint64 offset)
+{
+  const quint32 line = offsets.size();
+  offsets.append(offset);
+  timestamps.append(entry.timestamp.toMSecsSinceEpoch());
+  kinds.append(char(entry.kind));
+
+  QStringList terms;
+  for (const QString &word : words(entry.message))
+  {
+    terms.append("w:" + word);
+  }
+  for (const QString &word : words(entry.action))
+  {
+    if (!terms.contains("w:" + word))
+    {
+      terms.append("w:" + word);
+    }
+  }
+  if (!entry.character.isEmpty())
+  {
+    terms.append("c:" + entry.character.toCaseFolded());
+  }
+  if (!entry.showname.isEmpty())
+  {
+    terms.append("n:" + entry.showname.toCaseFolded());
+  }
+  if (!entry.server.isEmpty())
+  {
+    terms.append("s:" + entry.server.toCaseFolded());
+  }
+
+  for (const QString &term : std::as_const(terms))
+  {
+    QVector<quint32> &lines = postings[term];
+    // The character and showname are often the same.
+    if (lines.isEmpty() || lines.last() != line)
+    {
+      lines.append(line);
+    }
+  }
+}
+
+bool ChatHistory::open()
+{
+  if (m_opened)
+  {
+    return m_active_segment != -1;
+  }
+  m_opened = true;
+
+  QDir dir(m_path);
+  if (!dir.exists() && !dir.mkpath("."))
+  {
+    qWarning() << "could not create chat history directory" << m_path;
+    return false;
+  }
+
+  for (const QString &file_name : dir.entryList({"*.seg"}, QDir::Files))
+  {
+    bool ok = false;
+    const int segment = file_name.chopped(4).toInt(&ok);
+    if (ok)
+    {
+      m_segments.append(segment);
+    }
+  }
+  std::sort(m_segments.begin(), m_segments.end());
+
+  int segment = 0;
+  if (!m_segments.isEmpty())
+  {
+    // The last segment is still being written unless it was sealed.
+    segment = m_segments.last();
+    if (QFile::exists(indexFileName(segment)))
+    {
+      ++segment;
+    }
+  }
+  return openSegment(segment);
+}
+
+bool ChatHistory::openSegment(int segment)
+{
+  m_file.close();
+  m_active_segment = -1;
+  m_active_index = SegmentIndex();
+
+  m_file.setFileName(segmentFileName(segment));
+  if (!m_file.open(QIODevice::ReadWrite))
+  {
+    qWarning() << "could not open chat history" << m_file.fileName() << m_file.errorString();
+    return false;
+  }
+
+  if (m_file.size() == 0)
+  {
+    QDataStream out(&m_file);
+    out << SEGMENT_MAGIC << VERSION;
+    if (out.status() != QDataStream::Ok || !m_file.flush())
+    {
+      qWarning() << "could not write to chat history" << m_file.fileName() << m_file.errorString();
+      m_file.close();
+      return false;
+    }
+  }
+  else
+  {
+    const qint64 end = scanSegment(m_file, m_active_index);
+    if (end == -1)
+    {
+      qWarning() << "chat history" << m_file.fileName() << "has an unknown format, starting a new segment";
+      m_file.close();
+      if (!m_segments.contains(segment))
+      {
+        m_segments.append(segment);
+      }
+      return openSegment(m_segments.last() + 1);
+    }
+    if (end < m_file.size())
+    {
+      // The last line was cut off, e.g. by a crash.
+      m_file.resize(end);
+    }
+  }
+
+  if (!m_segments.contains(segment))
+  {
+    m_segments.append(segment);
+  }
+  m_active_segment = segment;
+  return true;
+}
+
+void ChatHistory::seal()
+{
+  if (saveIndex(m_active_segment, m_active_index))
+  {
+    m_indexes.insert(m_active_segment, new SegmentIndex(m_active_index));
+  }
+  openSegment(m_active_segment + 1);
+}
+
+QString ChatHistory::segmentFileName(int segment) const
+{
+  return m_path + "/" + QString::number(segment).rightJustified(8, '0') + ".seg";
+}
+
+QString ChatHistory::indexFileName(int segment) const
+{
+  return m_path + "/" + QString::number(segment).rightJustified(8, '0') + ".idx";
+}
+
+const ChatHistory::SegmentIndex *ChatHistory::index(int segment)
+{
+  if (segment == m_active_segment)
+  {
+    return &m_active_index;
+  }
+
+  if (SegmentIndex *cached = m_indexes.object(segment))
+  {
+    return cached;
+  }
+
+  SegmentIndex *segment_index = new SegmentIndex;
+  if (!loadIndex(segment, *segment_index))
+  {
+    QFile file(segmentFileName(segment));
+    if (!file.open(QIODevice::ReadOnly) || scanSegment(file, *segment_index) == -1)
+    {
+      qWarning() << "could not read chat history" << file.fileName();
+      delete segment_index;
+      return nullptr;
+    }
+    saveIndex(segment, *segment_index);
+  }
+
+  m_indexes.insert(segment, segment_index);
+  return segment_index;
+}
+
+bool ChatHistory::loadIndex(int segment, SegmentIndex &index) const
+{
+  QFile file(indexFileName(segment));
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+
+  QDataStream in(&file);
+  quint32 magic = 0;
+  qint32 version = 0;
+  in >> magic >> version;
+  if (magic != INDEX_MAGIC || version != VERSION)
+  {
+    qWarning() << "discarding chat history index" << file.fileName() << "(unknown format)";
+    return false;
+  }
+
+  in >> index.offsets >> index.timestamps >> index.kinds >> index.postings;
+  if (in.status() != QDataStream::Ok || index.timestamps.size() != index.offsets.size() || index.kinds.size() != index.offsets.size())
+  {
+    qWarning() << "discarding chat history index" << file.fileName() << "(file is corrupted)";
+    index = SegmentIndex();
+    return false;
+  }
+  return true;
+}
+
+bool ChatHistory::saveIndex(int segment, const SegmentIndex &index) const
+{
+  QSaveFile file(indexFileName(segment));
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    qWarning() << "could not write chat history index" << file.fileName();
+    return false;
+  }
+
+  QDataStream out(&file);
+  out << INDEX_MAGIC << VERSION << index.offsets << index.timestamps << index.kinds << index.postings;
+
+  if (!file.commit())
+  {
+    qWarning() << "could not write chat history index" << file.fileName();
+    return false;
+  }
+  return true;
+}
+
+qint64 ChatHistory::scanSegment(QFile &file, SegmentIndex &index) const
+{
+  if (!file.seek(0))
+  {
+    return -1;
+  }
+
+  QDataStream in(&file);
+  quint32 magic = 0;
+  qint32 version = 0;
+  in >> magic >> version;
+  if (magic != SEGMENT_MAGIC || version != VERSION)
+  {
+    return -1;
+  }
+
+  qint64 end = HEADER_SIZE;
+  Entry entry;
+  while (readEntry(file, entry))
+  {
+    index.add(entry, end);
+    end = file.pos();
+  }
+  return end;
+}
+
+bool ChatHistory::readEntry(QFile &file, Entry &entry)
+{
+  QDataStream in(&file);
+  quint32 size = 0;
+  in >> size;
+  if (in.status() != QDataStream::Ok || size > quint32(file.size() - file.pos()))
+  {
+    return false;
+  }
+
+  const QByteArray payload = file.read(size);
+  if (payload.size() != qsizetype(size))
+  {
+    return false;
+  }
+
+  QDataStream record(payload);
+  quint8 kind = 0;
+  qint64 timestamp = 0;
+  record >> kind >> timestamp >> entry.server >> entry.character >> entry.showname >> entry.message >> entry.action;
+  entry.kind = kind == OutOfCharacter ? OutOfCharacter : InCharacter;
+  entry.timestamp = QDateTime::fromMSecsSinceEpoch(timestamp).toUTC();
+  return record.status() == QDataStream::Ok;
+}
+
+QByteArray ChatHistory::serialize(const Entry &entry)
+{
+  QByteArray payload;
+  QDataStream out(&payload, QIODevice::WriteOnly);
+  out << quint8(entry.kind) << entry.timestamp.toMSecsSinceEpoch() << entry.server << entry.character << entry.showname << entry.message << entry.action;
+  return payload;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <QCache>
+#include <QDateTime>
+#include <QFile>
+#include <QFuture>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+/**
+ * @brief Persists IC and OOC chat lines and searches them.
+ *
+ * @details Lines are appended to numbered segment files, each holding up to
+ * SEGMENT_SIZE lines. Once a segment is full, an index is written next to it
+ * mapping every word, character, showname and server to the lines containing
+ * it, along with the offset and time of each line. A search only loads the
+ * indexes of the segments it needs, a few at a time, and only reads the lines
+ * that match. The index of the segment being written is kept in memory and
+ * rebuilt from the segment when the history is opened again.
+ *
+ * Appends and searches run one after another on a thread of their own, so
+ * callers never wait for the disk and a search sees every line appended
+ * before it.
+ */
+class ChatHistory
+{
+public:
+  static constexpr quint32 SEGMENT_MAGIC = 0x414f4348; // AOCH
+  static constexpr quint32 INDEX_MAGIC = 0x414f4849;   // AOHI
+  static constexpr qint32 VERSION = 1;
+  static constexpr int HEADER_SIZE = 8;
+  static constexpr int SEGMENT_SIZE = 16384;
+  static constexpr int INDEX_CACHE_SIZE = 8;
+  static constexpr int DEFAULT_RESULT_LIMIT = 500;
+  static constexpr int MAXIMUM_WORD_LENGTH = 64;
+
+  enum Kind
+  {
+    InCharacter,
+    OutOfCharacter,
+  };
+
+  class Entry
+  {
+  public:
+    Kind kind = InCharacter;
+    QDateTime timestamp;
+    QString server;
+    QString character;
+    QString showname;
+    QString message;
+    QString action;
+  };
+
+  /// Every field that is set must match. Words match whole words, names
+  /// match whole names, both ignoring case.
+  class Query
+  {
+  public:
+    QString text;
+    QString character;
+    QString showname;
+    QString server;
+    QDateTime from;
+    QDateTime to;
+    bool in_character = true;
+    bool out_of_character = true;
+    int limit = DEFAULT_RESULT_LIMIT;
+  };
+
+  explicit ChatHistory(const QString &path);
+  ~ChatHistory();
+
+  QString path() const;
+
+  void append(const Entry &entry);
+
+  /// Returns the lines matching query, newest first, once they are found.
+  QFuture<QVector<Entry>> search(const Query &query);
+
+  /// Splits text into the words it is indexed by.
+  static QStringList words(const QString &text);
+
+private:
+  class SegmentIndex
+  {
+  public:
+    QVector<qint64> offsets;
+    QVector<qint64> timestamps;
+    QByteArray kinds;
+    QHash<QString, QVector<quint32>> postings;
+
+    void add(const Entry &entry, qint64 offset);
+  };
+
+  QThreadPool m_worker;
+
+  QString m_path;
+  bool m_opened = false;
+  QVector<int> m_segments;
+
+  QFile m_file;
+  int m_active_segment = -1;
+  SegmentIndex m_active_index;
+
+  QCache<int, SegmentIndex> m_indexes;
+
+  void write(const Entry &entry);
+  QVector<Entry> find(const Query &query);
+
+  bool open();
+  bool openSegment(int segment);
+  void seal();
+
+  QString segmentFileName(int segment) const;
+  QString indexFileName(int segment) const;
+  const SegmentIndex *index(int segment);
+  bool loadIndex(int segment, SegmentIndex &index) const;
+  bool saveIndex(int segment, const SegmentIndex &index) const;
+  qint64 scanSegment(QFile &file, SegmentIndex &index) const;
+
+  static bool readEntry(QFile &file, Entry &entry);
+  static QByteArray serialize(const Entry &entry);
+};
@@ -3,6 +3,9 @@
 #include "datatypes.h"
 #include "moderation_functions.h"
 #include "options.h"
+#include "samplecache.h"
+#include "tracer.h"
+#include "viewportcompositor.h"
 
 #include <QtConcurrent/QtConcurrent>
 
@@ -28,6 +31,8 @@ Courtroom::Courtroom(AOApplication *p_ao_app)
   text_queue_timer = new QTimer(this);
   text_queue_timer->setSingleShot(true);
 
+  asset_prefetcher = new AssetPrefetcher(ao_app);
+
   sfx_delay_timer = new QTimer(this);
   sfx_delay_timer->setSingleShot(true);
 
@@ -35,6 +40,8 @@ Courtroom::Courtroom(AOApplication *p_ao_app)
   music_player->setMuted(true);
   connect(&music_player->m_watcher, &QFutureWatcher<QString>::finished, this, &Courtroom::update_ui_music_name, Qt::QueuedConnection);
 
+  connect(&char_list_watcher, &QFutureWatcher<CharacterListEntry>::finished, this, &Courtroom::build_character_list);
+
   sfx_player = new AOSfxPlayer(ao_app);
   sfx_player->setMuted(true);
 
@@ -50,7 +57,14 @@ Courtroom::Courtroom(AOApplication *p_ao_app)
   ui_background = new AOImage(ao_app, this);
   ui_background->setObjectName("ui_background");
 
-  ui_viewport = new QWidget(this);
+  if (Options::getInstance().viewportCompositorEnabled())
+  {
+    ui_viewport = new kal::ViewportCompositor(this);
+  }
+  else
+  {
+    ui_viewport = new QWidget(this);
+  }
   ui_viewport->setObjectName("ui_viewport");
   ui_vp_background = new kal::BackgroundAnimationLayer(ao_app, ui_viewport);
   ui_vp_background->setObjectName("ui_vp_background");
@@ -100,6 +114,7 @@ Courtroom::Courtroom(AOApplication *p_ao_app)
   ui_vp_message->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
   ui_vp_message->setReadOnly(true);
   ui_vp_message->setObjectName("ui_vp_message");
+  ic_message_renderer = new ICMessageRenderer(ui_vp_message);
 
   ui_vp_testimony = new kal::SplashAnimationLayer(ao_app, this);
   ui_vp_testimony->setAttribute(Qt::WA_TransparentForMouseEvents);
@@ -117,8 +132,10 @@ Courtroom::Courtroom(AOApplication *p_ao_app)
 
   m_screenslide_timer = new kal::ScreenSlideTimer(this);
 
-  ui_ic_chatlog = new QTextEdit(this);
-  ui_ic_chatlog->setReadOnly(true);
+  ic_log_model = new ICLogModel(this);
+  ic_log_model->setRenderer([this](const ChatLogPiece &piece, bool ghost) { return render_ic_log_entry(piece, ghost); });
+  ui_ic_chatlog = new ICLogView(this);
+  ui_ic_chatlog->setModel(ic_log_model);
   ui_ic_chatlog->setObjectName("ui_ic_chatlog");
 
   log_maximum_blocks = Options::getInstance().maxLogSize();
@@ -131,6 +148,11 @@ Courtroom::Courtroom(AOApplication *p_ao_app)
 
   custom_shownames = Options::getInstance().customShownameEnabled();
 
+  ic_log_model->setLimit(log_maximum_blocks);
+  ic_log_model->setNewestFirst(!log_goes_downwards);
+  ui_ic_chatlog->setNewestFirst(!log_goes_downwards);
+  ui_ic_chatlog->logDelegate()->setMargin(log_margin);
+
   ui_debug_log = new AOTextArea(Options::getInstance().maxLogSize(), this);
   ui_debug_log->setReadOnly(true);
   ui_debug_log->setOpenExternalLinks(true);
@@ -497,6 +519,10 @@ Courtroom::Courtroom(AOApplication *p_ao_app)
   connect(ui_reload_theme, &AOButton::clicked, this, &Courtroom::on_reload_theme_clicked);
   connect(ui_call_mod, &AOButton::clicked, this, &Courtroom::on_call_mod_clicked);
   connect(ui_settings, &AOButton::clicked, this, &Courtroom::on_settings_clicked);
+#ifdef AO_ENABLE_TRACING
+  ui_settings->setContextMenuPolicy(Qt::CustomContextMenu);
+  connect(ui_settings, &AOButton::customContextMenuRequested, this, &Courtroom::on_settings_context_menu_requested);
+#endif
   connect(ui_switch_area_music, &AOButton::clicked, this, &Courtroom::on_switch_area_music_clicked);
 
   connect(ui_pre, &AOButton::clicked, this, &Courtroom::focus_ic_input);
@@ -538,6 +564,8 @@ Courtroom::~Courtroom()
   delete sfx_player;
   delete objection_player;
   delete blip_player;
+  delete ic_message_renderer;
+  delete asset_prefetcher;
 }
 
 void Courtroom::on_application_state_changed(Qt::ApplicationState state)
@@ -819,6 +847,10 @@ void Courtroom::set_widgets()
   log_timestamp_format = Options::getInstance().logTimestampFormat();
 
   custom_shownames = Options::getInstance().customShownameEnabled();
+  ic_log_model->setLimit(log_maximum_blocks);
+  ic_log_model->setNewestFirst(!log_goes_downwards);
+  ui_ic_chatlog->setNewestFirst(!log_goes_downwards);
+  ui_ic_chatlog->logDelegate()->setMargin(log_margin);
   if (regenerate)
   {
     regenerate_ic_chatlog();
@@ -1549,6 +1581,10 @@ void Courtroom::update_character(int p_cid, QString char_name, bool reset_emote)
   if (newchar) // Avoid infinite loop of death and suffering
   {
     set_iniswap_dropdown();
+    if (m_cid != -1)
+    {
+      preload_character_sounds(current_char);
+    }
   }
 
   ui_custom_objection->hide();
@@ -1929,8 +1965,17 @@ void Courtroom::append_server_chatmessage(QString p_name, QString p_message, QSt
 
   if (Options::getInstance().logToTextFileEnabled() && !ao_app->log_filename.isEmpty())
   {
-    QString full = "[OOC][" + QDateTime::currentDateTimeUtc().toString() + "] " + p_name + ": " + p_message;
-    ao_app->append_to_file(full, ao_app->log_filename, true);
+    const QDateTime timestamp = QDateTime::currentDateTimeUtc();
+    QString full = "[OOC][" + timestamp.toString() + "] " + p_name + ": " + p_message;
+    ao_app->log_writer->append(ao_app->log_filename, full);
+
+    ChatHistory::Entry history_entry;
+    history_entry.kind = ChatHistory::OutOfCharacter;
+    history_entry.timestamp = timestamp;
+    history_entry.server = ao_app->server_name;
+    history_entry.showname = p_name;
+    history_entry.message = p_message;
+    ao_app->chat_history->append(history_entry);
   }
 }
 
@@ -2277,7 +2322,7 @@ void Courtroom::on_chat_return_pressed()
         packet += f_emote;
         if (Options::getInstance().networkedFrameSfxEnabled())
         {
-          QString sfx_frames = ao_app->read_ini_tags(ao_app->get_character_path(current_char, "char.ini"), f_emote.append(f_effect)).join("|");
+          QString sfx_frames = ao_app->get_char_ini(current_char)->entries(f_emote.append(f_effect)).join("|");
           if (sfx_frames != "")
           {
             packet += "|" + sfx_frames;
@@ -2435,6 +2480,9 @@ void Courtroom::chatmessage_enqueue(QStringList p_contents)
   // Log the IO file
   log_chatmessage(p_contents[MESSAGE], f_char_id, p_contents[SHOWNAME], p_contents[CHAR_NAME], p_contents[OBJECTION_MOD], p_contents[EVIDENCE_ID].toInt(), p_contents[TEXT_COLOR].toInt(), log_mode, sender);
 
+  // Load the assets while the message waits in the queue
+  asset_prefetcher->enqueue(p_contents);
+
   // Send this boi into the queue
   chatmessage_queue.enqueue(p_contents);
 
@@ -2448,6 +2496,31 @@ void Courtroom::chatmessage_enqueue(QStringList p_contents)
   // Otherwise, since a message is being parsed, chat_tick() should be called which will call dequeue once it's done.
 }
 
+bool Courtroom::is_chatmessage_pending()
+{
+  return !chatmessage_queue.isEmpty() || text_state < 2;
+}
+
+void Courtroom::preload_character_sounds(QString p_char)
+{
+  QStringList f_sounds;
+  f_sounds.append(ao_app->get_sfx_suffix(ao_app->get_sounds_path(ao_app->get_blips(ao_app->get_blipname(p_char)))));
+
+  QSet<QString> f_sfx_names;
+  for (int i = 0; i < ao_app->get_emote_number(p_char); ++i)
+  {
+    f_sfx_names.insert(ao_app->get_sfx_name(p_char, i));
+  }
+  f_sfx_names.remove("0");
+  f_sfx_names.remove("1");
+  for (const QString &f_sfx_name : std::as_const(f_sfx_names))
+  {
+    f_sounds.append(ao_app->get_sfx(f_sfx_name, QString(), p_char));
+  }
+
+  SampleCache::getInstance().preload(f_sounds);
+}
+
 void Courtroom::chatmessage_dequeue()
 {
   // Nothing to parse in the queue
@@ -2463,6 +2536,7 @@ void Courtroom::chatmessage_dequeue()
   }
 
   unpack_chatmessage(chatmessage_queue.dequeue());
+  asset_prefetcher->dequeue();
 }
 
 void Courtroom::skip_chatmessage_queue()
@@ -2474,10 +2548,12 @@ void Courtroom::skip_chatmessage_queue()
     bool sender = Options::getInstance().desynchronisedLogsEnabled() || p_contents[CHAR_ID].toInt() == m_cid;
     log_chatmessage(p_contents[MESSAGE], p_contents[CHAR_ID].toInt(), p_contents[SHOWNAME], p_contents[CHAR_NAME], p_contents[OBJECTION_MOD], p_contents[EVIDENCE_ID].toInt(), p_contents[TEXT_COLOR].toInt(), DISPLAY_ONLY, sender);
   }
+  asset_prefetcher->clear();
 }
 
 void Courtroom::unpack_chatmessage(QStringList p_contents)
 {
+  AO_TRACE_SCOPE("Courtroom::unpack_chatmessage");
   for (int n_string = 0; n_string < MS_MAXIMUM; ++n_string)
   {
     m_previous_chatmessage[n_string] = m_chatmessage[n_string];
@@ -2541,7 +2617,7 @@ void Courtroom::log_chatmessage(QString f_message, int f_char_id, QString f_show
   // Detect if we're trying to log a blankpost
   bool blankpost = (f_log_mode != IO_ONLY &&                                                    // if we're not in I/O only mode,
                     f_message.isEmpty() &&                                                      // our current message is a blankpost,
-                    !ic_chatlog_history.isEmpty() &&                                            // the chat log isn't empty,
+                    ic_log_model->entryCount() > 0 &&                                           // the chat log isn't empty,
                     last_ic_message == f_displayname + ":" &&                                   // the chat log's last message is a blank post, and
                     last_ic_message.mid(0, last_ic_message.lastIndexOf(":")) == f_displayname); // the blankpost's showname is the same as ours
   bool selfname = f_char_id == m_cid;
@@ -3203,18 +3279,19 @@ void Courtroom::do_effect(QString fx_path, QString fx_sound, QString p_char, QSt
   {
     return;
   }
-  ui_vp_effect->setStretchToFit(ao_app->get_effect_property(fx_path, p_char, p_folder, "stretch").startsWith("true"));
-  ui_vp_effect->setResizeMode(ao_app->get_scaling(ao_app->get_effect_property(fx_path, p_char, p_folder, "scaling")));
-  ui_vp_effect->setFlipped(ao_app->get_effect_property(fx_path, p_char, p_folder, "respect_flip").startsWith("true") && m_chatmessage[FLIP].toInt() == 1);
+  const EffectDescriptor descriptor = ao_app->get_effect_descriptor(fx_path, p_char, p_folder);
+  ui_vp_effect->setStretchToFit(descriptor.stretch);
+  ui_vp_effect->setResizeMode(ao_app->get_scaling(descriptor.scaling));
+  ui_vp_effect->setFlipped(descriptor.respect_flip && m_chatmessage[FLIP].toInt() == 1);
 
-  bool looping = ao_app->get_effect_property(fx_path, p_char, p_folder, "loop").startsWith("true");
+  bool looping = descriptor.loop;
 
-  int max_duration = ao_app->get_effect_property(fx_path, p_char, p_folder, "max_duration").toInt();
+  int max_duration = descriptor.max_duration;
 
-  bool cull = ao_app->get_effect_property(fx_path, p_char, p_folder, "cull").startsWith("true");
+  bool cull = descriptor.cull;
 
   // Possible values: "chat", "character", "behind"
-  QString layer = ao_app->get_effect_property(fx_path, p_char, p_folder, "layer").toLower();
+  const QString &layer = descriptor.layer;
   if (layer == "behind")
   {
     ui_vp_effect->setParent(ui_viewport);
@@ -3246,7 +3323,7 @@ void Courtroom::do_effect(QString fx_path, QString fx_sound, QString p_char, QSt
     effect_y = ui_viewport->y();
   }
   // This effect respects the character offset settings
-  if (ao_app->get_effect_property(fx_path, p_char, p_folder, "respect_offset") == "true")
+  if (descriptor.respect_offset)
   {
     QStringList self_offsets = m_chatmessage[SELF_OFFSET].split("&");
     int self_offset = self_offsets[0].toInt();
@@ -3796,85 +3873,77 @@ void Courtroom::log_ic_text(QString p_name, QString p_showname, QString p_messag
   log_entry.action = p_action;
   log_entry.color = p_color;
   log_entry.timestamp = QDateTime::currentDateTimeUtc();
-  ic_chatlog_history.append(log_entry);
 
   if (Options::getInstance().logToTextFileEnabled() && !ao_app->log_filename.isEmpty())
   {
-    ao_app->append_to_file(log_entry.toString(), ao_app->log_filename, true);
-  }
+    ao_app->log_writer->append(ao_app->log_filename, log_entry.toString());
 
-  while (ic_chatlog_history.size() > log_maximum_blocks && log_maximum_blocks > 0)
-  {
-    ic_chatlog_history.removeFirst();
+    ChatHistory::Entry history_entry;
+    history_entry.kind = ChatHistory::InCharacter;
+    history_entry.timestamp = log_entry.timestamp;
+    history_entry.server = ao_app->server_name;
+    history_entry.character = p_name;
+    history_entry.showname = p_showname;
+    history_entry.message = p_message;
+    history_entry.action = p_action;
+    ao_app->chat_history->append(history_entry);
   }
 }
 
 void Courtroom::append_ic_text(QString p_text, QString p_name, QString p_char, QString p_action, int color, bool selfname, QDateTime timestamp, bool ghost)
 {
-  QColor chatlog_color = ao_app->get_color("ic_chatlog_color", "courtroom_fonts.ini");
-  QTextCharFormat bold;
-  QTextCharFormat normal;
-  QTextCharFormat italics;
-  QTextCharFormat own_name;
-  QTextCharFormat other_name;
-  QTextCharFormat timestamp_format;
-  QTextCharFormat selftimestamp_format;
-  QTextBlockFormat format;
-  bold.setFontWeight(QFont::Bold);
-  normal.setFontWeight(QFont::Normal);
-  italics.setFontItalic(true);
-  own_name.setFontWeight(QFont::Bold);
-  own_name.setForeground(ao_app->get_color("ic_chatlog_selfname_color", "courtroom_fonts.ini"));
-  other_name.setFontWeight(QFont::Bold);
-  other_name.setForeground(ao_app->get_color("ic_chatlog_showname_color", "courtroom_fonts.ini"));
-  timestamp_format.setForeground(ao_app->get_color("ic_chatlog_timestamp_color", "courtroom_fonts.ini"));
-  selftimestamp_format.setForeground(ao_app->get_color("ic_chatlog_selftimestamp_color", "courtroom_fonts.ini"));
-  format.setTopMargin(log_margin);
-  const QTextCursor old_cursor = ui_ic_chatlog->textCursor();
-  const int old_scrollbar_value = ui_ic_chatlog->verticalScrollBar()->value();
-  const bool need_newline = !ui_ic_chatlog->document()->isEmpty();
-  const int scrollbar_target_value = log_goes_downwards ? ui_ic_chatlog->verticalScrollBar()->maximum() : ui_ic_chatlog->verticalScrollBar()->minimum();
-
-  QString displayname = custom_shownames ? p_name : ao_app->get_showname(p_char);
+  ChatLogPiece log_entry;
+  log_entry.character = p_char;
+  log_entry.character_name = p_name;
+  log_entry.local_player = selfname;
+  log_entry.message = p_text;
+  log_entry.action = p_action;
+  log_entry.color = color;
+  log_entry.timestamp = timestamp;
 
   if (ghost)
   {
-    ghost_blocks++;
-    chatlog_color.setAlpha(128);
-    bold.setForeground(chatlog_color);
-    normal.setForeground(chatlog_color);
-    italics.setForeground(chatlog_color);
+    ic_log_model->appendGhost(log_entry);
   }
   else
   {
-    last_ic_message = displayname + ":" + p_text;
+    last_ic_message = (custom_shownames ? p_name : ao_app->get_showname(p_char)) + ":" + p_text;
+    ic_log_model->append(log_entry);
   }
+}
 
-  ui_ic_chatlog->moveCursor(log_goes_downwards ? QTextCursor::End : QTextCursor::Start);
-
-  if (!ghost && ghost_blocks > 0)
+QString Courtroom::render_ic_log_entry(const ChatLogPiece &p_piece, bool ghost)
+{
+  QColor chatlog_color = ao_app->get_color("ic_chatlog_color", "courtroom_fonts.ini");
+  if (ghost)
   {
-    for (int i = 0; i < ghost_blocks; ++i)
+    chatlog_color.setAlpha(128);
+  }
+
+  // Escapes plain text, keeping its whitespace. Ghosts are faded out.
+  auto text = [&](const QString &p_text, const QString &p_style = QString()) -> QString {
+    QString style = "white-space: pre-wrap;" + p_style;
+    if (ghost)
     {
-      ui_ic_chatlog->moveCursor(log_goes_downwards ? QTextCursor::PreviousBlock : QTextCursor::NextBlock);
+      style += "color: " + chatlog_color.name(QColor::HexArgb) + ";";
     }
-    ui_ic_chatlog->moveCursor(log_goes_downwards ? QTextCursor::EndOfBlock : QTextCursor::StartOfBlock);
-  }
+    return "<span style=\"" + style + "\">" + p_text.toHtmlEscaped() + "</span>";
+  };
+  auto colored_text = [&text](const QString &p_text, const QColor &p_color, const QString &p_style = QString()) -> QString { return text(p_text, "color: " + p_color.name(QColor::HexArgb) + ";" + p_style); };
 
-  // Only prepend with newline if log goes downwards
-  if (log_goes_downwards && need_newline)
-  {
-    ui_ic_chatlog->textCursor().insertBlock(format);
-  }
+  const QString italics = "font-style: italic;";
+  const QString displayname = custom_shownames ? p_piece.character_name : ao_app->get_showname(p_piece.character);
+  const QString &p_text = p_piece.message;
+  const QString &p_action = p_piece.action;
+  QString html;
 
   // Timestamp if we're doing that meme
   if (log_timestamp)
   {
-    // Format the timestamp
-    QTextCharFormat format = selfname ? selftimestamp_format : timestamp_format;
+    const QDateTime timestamp = p_piece.timestamp.toLocalTime();
     if (timestamp.isValid())
     {
-      ui_ic_chatlog->textCursor().insertText("[" + timestamp.toString(log_timestamp_format) + "] ", format);
+      html += text("[" + timestamp.toString(log_timestamp_format) + "] ", "color: " + ao_app->get_color(p_piece.local_player ? "ic_chatlog_selftimestamp_color" : "ic_chatlog_timestamp_color", "courtroom_fonts.ini").name(QColor::HexArgb) + ";");
     }
     else
     {
@@ -3883,62 +3952,41 @@ void Courtroom::append_ic_text(QString p_text, QString p_name, QString p_char, Q
   }
 
   // Format the name of the actor
-  QTextCharFormat name_format = selfname ? own_name : other_name;
-  ui_ic_chatlog->textCursor().insertText(displayname, name_format);
+  html += "<b>" + colored_text(displayname, ao_app->get_color(p_piece.local_player ? "ic_chatlog_selfname_color" : "ic_chatlog_showname_color", "courtroom_fonts.ini")) + "</b>";
   // Special case for stopping the music
   if (p_action == tr("has stopped the music"))
   {
-    ui_ic_chatlog->textCursor().insertText(" " + p_action + ".", normal);
+    html += text(" " + p_action + ".");
   }
   // Make shout text bold
   else if (p_action == tr("shouts") && log_ic_actions)
   {
-    ui_ic_chatlog->textCursor().insertText(" " + p_action + " ", normal);
+    html += text(" " + p_action + " ");
     if (log_colors && !ghost)
     {
-      ui_ic_chatlog->textCursor().insertHtml("<b>" + filter_ic_text(p_text, true, -1, 0).replace("$c0", chatlog_color.name(QColor::HexArgb)) + "</b>");
+      html += "<b>" + filter_ic_text(p_text, true, -1, 0).replace("$c0", chatlog_color.name(QColor::HexArgb)) + "</b>";
     }
     else
     {
-      ui_ic_chatlog->textCursor().insertText(" " + p_text, italics);
+      html += text(" " + p_text, italics);
     }
   }
   // If action not blank:
   else if (p_action != "" && log_ic_actions)
   {
     // Format the action in normal
-    ui_ic_chatlog->textCursor().insertText(" " + p_action, normal);
-    if (log_newline)
-    {
-      // For some reason, we're forced to use <br> instead of the more sensible
-      // \n. Why? Because \n is treated as a new Block instead of a soft newline
-      // within a paragraph!
-      ui_ic_chatlog->textCursor().insertHtml("<br>");
-    }
-    else
-    {
-      ui_ic_chatlog->textCursor().insertText(": ", normal);
-    }
+    html += text(" " + p_action);
+    html += log_newline ? "<br>" : text(": ");
     // Format the result in italics
-    ui_ic_chatlog->textCursor().insertText(p_text + ".", italics);
+    html += text(p_text + ".", italics);
   }
   else
   {
-    if (log_newline)
-    {
-      // For some reason, we're forced to use <br> instead of the more sensible
-      // \n. Why? Because \n is treated as a new Block instead of a soft newline
-      // within a paragraph!
-      ui_ic_chatlog->textCursor().insertHtml("<br>");
-    }
-    else
-    {
-      ui_ic_chatlog->textCursor().insertText(": ", normal);
-    }
+    html += log_newline ? "<br>" : text(": ");
     // Format the result according to html
     if (log_colors)
     {
-      QString p_text_filtered = filter_ic_text(p_text, true, -1, color);
+      QString p_text_filtered = filter_ic_text(p_text, true, -1, p_piece.color);
       p_text_filtered = p_text_filtered.replace("$c0", chatlog_color.name(QColor::HexArgb));
       for (int c = 1; c < max_colors; ++c)
       {
@@ -3949,66 +3997,20 @@ void Courtroom::append_ic_text(QString p_text, QString p_name, QString p_char, Q
         }
         p_text_filtered = p_text_filtered.replace("$c" + QString::number(c), color_result.name(QColor::HexArgb));
       }
-      ui_ic_chatlog->textCursor().insertHtml(p_text_filtered);
-    }
-    else
-    {
-      ui_ic_chatlog->textCursor().insertText(filter_ic_text(p_text, false), normal);
-    }
-  }
-
-  // Only append with newline if log goes upwards
-  if (!log_goes_downwards && need_newline)
-  {
-    ui_ic_chatlog->textCursor().insertBlock(format);
-  }
-
-  // If we got too many blocks in the current log, delete some.
-  while (ui_ic_chatlog->document()->blockCount() > log_maximum_blocks && log_maximum_blocks > 0)
-  {
-    QTextCursor temp_curs = ui_ic_chatlog->textCursor();
-    temp_curs.movePosition(log_goes_downwards ? QTextCursor::Start : QTextCursor::End);
-    temp_curs.select(QTextCursor::BlockUnderCursor);
-    temp_curs.removeSelectedText();
-    if (log_goes_downwards)
-    {
-      temp_curs.deleteChar();
+      html += p_text_filtered;
     }
     else
     {
-      temp_curs.deletePreviousChar();
+      html += text(filter_ic_text(p_text, false));
     }
   }
 
-  // Finally, scroll the scrollbar to the correct position.
-  if (old_cursor.hasSelection() || old_scrollbar_value != scrollbar_target_value)
-  {
-    // The user has selected text or scrolled away from the bottom: maintain
-    // position.
-    ui_ic_chatlog->setTextCursor(old_cursor);
-    ui_ic_chatlog->verticalScrollBar()->setValue(old_scrollbar_value);
-  }
-  else
-  {
-    ui_ic_chatlog->verticalScrollBar()->setValue(log_goes_downwards ? ui_ic_chatlog->verticalScrollBar()->maximum() : 0);
-  }
+  return html;
 }
 
 void Courtroom::pop_ic_ghost()
 {
-  QTextCursor ghost = ui_ic_chatlog->textCursor();
-  ghost.movePosition(log_goes_downwards ? QTextCursor::End : QTextCursor::Start);
-  for (int i = 1; i < ghost_blocks; ++i)
-  {
-    ghost.movePosition(log_goes_downwards ? QTextCursor::PreviousBlock : QTextCursor::NextBlock);
-  }
-  ghost.select(QTextCursor::BlockUnderCursor);
-  ghost.removeSelectedText();
-  if (ghost_blocks <= 1 && !log_goes_downwards)
-  {
-    ghost.deleteChar();
-  }
-  ghost_blocks--;
+  ic_log_model->popGhost();
 }
 
 void Courtroom::play_preanim(bool immediate)
@@ -4154,6 +4156,8 @@ void Courtroom::start_chat_ticking()
   {
     // since the message is empty, it's technically done ticking
     text_state = 2;
+    Q_EMIT chatmessage_started();
+    Q_EMIT chatmessage_finished();
     if (m_chatmessage[ADDITIVE] == "1")
     {
       // Cool behavior
@@ -4194,9 +4198,7 @@ void Courtroom::start_chat_ticking()
 
   if (m_chatmessage[ADDITIVE] != "1")
   {
-    ui_vp_message->clear();
-    real_tick_pos = 0;
-    additive_previous = "";
+    ic_message_renderer->clear();
   }
 
   tick_pos = 0;
@@ -4216,6 +4218,9 @@ void Courtroom::start_chat_ticking()
     gen_char_rgb_list(current_misc);
   }
 
+  ICMessage message(m_chatmessage[MESSAGE], m_chatmessage[TEXT_COLOR].toInt(), color_markdown_start_list, color_markdown_end_list, color_markdown_remove_list, color_markdown_talking_list);
+  ic_message_renderer->start(message, Options::getInstance().customChatboxEnabled() ? char_color_rgb_list : default_color_rgb_list);
+
   QString f_blips = ao_app->get_blipname(m_chatmessage[CHAR_NAME]);
   f_blips = ao_app->get_blips(f_blips);
   if (ao_app->m_serverdata.get_feature(server::BASE_FEATURE_SET::CUSTOM_BLIPS) && !m_chatmessage[BLIPNAME].isEmpty())
@@ -4226,23 +4231,26 @@ void Courtroom::start_chat_ticking()
 
   // means text is currently ticking
   text_state = 1;
+  Q_EMIT chatmessage_started();
 
   c_played = false;
 }
 
 void Courtroom::chat_tick()
 {
+  AO_TRACE_SCOPE("Courtroom::chat_tick");
   // note: this is called fairly often
   // do not perform heavy operations here
 
-  QString f_message = m_chatmessage[MESSAGE];
+  const ICMessage &message = ic_message_renderer->message();
 
   // Due to our new text speed system, we always need to stop the timer now.
   chat_tick_timer->stop();
 
-  if (tick_pos >= f_message.size())
+  if (tick_pos >= message.size())
   {
     text_state = 2;
+    Q_EMIT chatmessage_finished();
     // Check if we're a narrator msg
     if (m_chatmessage[EMOTE] != "")
     {
@@ -4280,25 +4288,7 @@ void Courtroom::chat_tick()
     }
     ui_vp_chat_arrow->setResizeMode(ao_app->get_misc_scaling(f_custom_theme));
     ui_vp_chat_arrow->loadAndPlayAnimation("chat_arrow", f_custom_theme); // Chat stopped being processed, indicate that.
-    QString f_message_filtered = filter_ic_text(f_message, true, -1, m_chatmessage[TEXT_COLOR].toInt());
-    if (Options::getInstance().customChatboxEnabled())
-    { // chatbox colors
-      for (int c = 0; c < max_colors; ++c)
-      {
-        additive_previous = additive_previous.replace("$c" + QString::number(c), char_color_rgb_list.at(c).name(QColor::HexRgb));
-        f_message_filtered = f_message_filtered.replace("$c" + QString::number(c), char_color_rgb_list.at(c).name(QColor::HexRgb));
-      }
-    }
-    else
-    { // default colors
-      for (int c = 0; c < max_colors; ++c)
-      {
-        additive_previous = additive_previous.replace("$c" + QString::number(c), default_color_rgb_list.at(c).name(QColor::HexRgb));
-        f_message_filtered = f_message_filtered.replace("$c" + QString::number(c), default_color_rgb_list.at(c).name(QColor::HexRgb));
-      }
-    }
-    additive_previous = additive_previous + f_message_filtered;
-    real_tick_pos = ui_vp_message->toPlainText().size();
+    ic_message_renderer->finish();
 
     // If we're not already waiting on the next message, start the timer. We could be overriden if there's an objection planned.
     int delay = Options::getInstance().textStayTime();
@@ -4322,126 +4312,27 @@ void Courtroom::chat_tick()
     return;
   }
 
+  const ICMessage::Grapheme &grapheme = message.graphemes().at(tick_pos);
+  const QString &f_character = grapheme.text;
   // Stops blips from playing when we have a formatting option.
-  bool formatting_char = false;
-
-  QString f_rest = f_message;
+  bool formatting_char = grapheme.formatting;
+  ++tick_pos;
 
-  // Alignment characters
-  if (tick_pos < 2)
+  if (grapheme.effect == ICMessage::Screenshake)
   {
-    if (f_rest.startsWith("~~") || f_rest.startsWith("~>") || f_rest.startsWith("<>"))
-    {
-      tick_pos += 2;
-    }
-  }
-  f_rest.remove(0, tick_pos);
-  QTextBoundaryFinder tbf(QTextBoundaryFinder::Grapheme, f_rest);
-  QString f_character;
-  int f_char_length;
-  int msg_delay = 0;
-
-  tbf.toNextBoundary();
-
-  if (tbf.position() == -1)
-  {
-    f_character = f_rest;
-  }
-  else
-  {
-    f_character = f_rest.left(tbf.position());
-  }
-
-  f_char_length = f_character.length();
-  tick_pos += f_char_length;
-
-  // Escape character.
-  if (!next_character_is_not_special)
-  {
-    if (f_character == "\\")
-    {
-      next_character_is_not_special = true;
-      formatting_char = true;
-    }
-
-    // Text speed modifier.
-    else if (f_character == "{")
-    {
-      // ++, because it INCREASES delay!
-      current_display_speed++;
-      formatting_char = true;
-    }
-    else if (f_character == "}")
-    {
-      current_display_speed--;
-      formatting_char = true;
-    }
-
-    else
-    {
-      // Parse markdown colors
-      for (int c = 0; c < max_colors; ++c)
-      {
-        QString markdown_start = color_markdown_start_list.at(c);
-        QString markdown_end = color_markdown_end_list.at(c);
-        bool markdown_remove = color_markdown_remove_list.at(c);
-        if (markdown_start.isEmpty())
-        {
-          continue;
-        }
-
-        if (f_character == markdown_start || f_character == markdown_end)
-        {
-          if (markdown_remove)
-          {
-            formatting_char = true;
-          }
-          break;
-        }
-      }
-    }
-  }
-  else
-  {
-    if (f_character == "n")
-    {
-      formatting_char = true; // it's a newline
-    }
-    if (f_character == "s") // Screenshake.
-    {
-      this->do_screenshake();
-      formatting_char = true;
-    }
-    if (f_character == "f") // Flash.
-    {
-      this->do_flash();
-      formatting_char = true;
-    }
-    if (f_character == "p")
-    {
-      formatting_char = true;
-    }
-    next_character_is_not_special = false;
-  }
-
-  // Keep the speed at bay.
-  if (current_display_speed < 0)
-  {
-    current_display_speed = 0;
+    this->do_screenshake();
   }
-  else if (current_display_speed > 6)
+  else if (grapheme.effect == ICMessage::Flash)
   {
-    current_display_speed = 6;
+    this->do_flash();
   }
+  current_display_speed = grapheme.speed;
 
-  if (msg_delay == 0)
-  {
-    msg_delay = text_crawl * message_display_mult[current_display_speed];
-  }
+  int msg_delay = text_crawl * message_display_mult[current_display_speed];
 
-  if ((msg_delay <= 0 && tick_pos < f_message.size() - 1) || formatting_char)
+  if ((msg_delay <= 0 && tick_pos < message.size() - 1) || formatting_char)
   {
-    if (f_character == "p")
+    if (grapheme.effect == ICMessage::Pause)
     {
       chat_tick_timer->start(100); // wait the pause lol
     }
@@ -4450,42 +4341,20 @@ void Courtroom::chat_tick()
       chat_tick_timer->start(0); // Don't bother rendering anything out as we're
                                  // doing the SPEED. (there's latency otherwise)
     }
-    if (!formatting_char || f_character == "n" || f_character == "f" || f_character == "s" || f_character == "p")
-    {
-      real_tick_pos += f_char_length; // Adjust the tick position for the
-                                      // scrollbar convenience
-    }
   }
   else
   {
-    // Do the colors, gradual showing, etc. in here
-    QString f_message_filtered = filter_ic_text(f_message, true, tick_pos, m_chatmessage[TEXT_COLOR].toInt());
-    if (Options::getInstance().customChatboxEnabled())
-    { // use chatbox colors
-      for (int c = 0; c < max_colors; ++c)
-      {
-        additive_previous = additive_previous.replace("$c" + QString::number(c), char_color_rgb_list.at(c).name(QColor::HexRgb));
-        f_message_filtered = f_message_filtered.replace("$c" + QString::number(c), char_color_rgb_list.at(c).name(QColor::HexRgb));
-      }
-    }
-    else
-    { // just use default colors
-      for (int c = 0; c < max_colors; ++c)
-      {
-        additive_previous = additive_previous.replace("$c" + QString::number(c), default_color_rgb_list.at(c).name(QColor::HexRgb));
-        f_message_filtered = f_message_filtered.replace("$c" + QString::number(c), default_color_rgb_list.at(c).name(QColor::HexRgb));
-      }
+    // Only the graphemes revealed since the last render are touched.
+    ic_message_renderer->reveal(tick_pos);
+    if (tick_pos < message.size() && message.graphemes().at(tick_pos).talking_update)
+    {
+      color_is_talking = message.graphemes().at(tick_pos).talking;
     }
-    ui_vp_message->setHtml(additive_previous + f_message_filtered);
-
-    // This should always be done AFTER setHtml. Scroll the chat window with the
-    // text.
 
     // Make the cursor follow the message
     QTextCursor cursor = ui_vp_message->textCursor();
-    cursor.setPosition(real_tick_pos);
+    cursor.setPosition(ic_message_renderer->revealedPosition());
     ui_vp_message->setTextCursor(cursor);
-    real_tick_pos += f_char_length;
 
     ui_vp_message->ensureCursorVisible();
 
@@ -4987,6 +4856,24 @@ void Courtroom::on_ooc_return_pressed()
     }
   }
 
+  if (ooc_message == "/history" || ooc_message.startsWith("/history "))
+  {
+    if (!chat_history_dialog)
+    {
+      chat_history_dialog = new ChatHistoryDialog(ao_app);
+      connect(this, &Courtroom::destroyed, chat_history_dialog, &ChatHistoryDialog::deleteLater);
+    }
+    chat_history_dialog->show();
+    chat_history_dialog->raise();
+    chat_history_dialog->activateWindow();
+    if (ooc_message.size() > 9)
+    {
+      chat_history_dialog->search(ooc_message.mid(9));
+    }
+    ui_ooc_chat_message->clear();
+    return;
+  }
+
   if (ooc_message.startsWith("/load_case"))
   {
     QStringList command = ooc_message.split(" ", Qt::SkipEmptyParts);
@@ -6380,6 +6267,7 @@ void Courtroom::on_blip_slider_moved(int p_value)
 void Courtroom::on_log_limit_changed(int value)
 {
   log_maximum_blocks = value;
+  ic_log_model->setLimit(value);
 }
 
 void Courtroom::on_pair_offset_changed(int value)
@@ -6452,6 +6340,8 @@ void Courtroom::on_change_character_clicked()
 
 void Courtroom::on_reload_theme_clicked()
 {
+  ThemeConfigCache::getInstance().clear();
+  EffectTableCache::getInstance().clear();
   set_courtroom_size();
   set_widgets();
   update_character(m_cid, ui_iniswap_dropdown->itemText(ui_iniswap_dropdown->currentIndex()));
@@ -6511,6 +6401,36 @@ void Courtroom::on_settings_clicked()
   ao_app->call_settings_menu();
 }
 
+void Courtroom::on_settings_context_menu_requested(const QPoint &pos)
+{
+  QMenu *menu = new QMenu(ui_settings);
+  menu->setAttribute(Qt::WA_DeleteOnClose);
+
+  QMenu *debug_menu = menu->addMenu(tr("Debug"));
+  QAction *record_action = debug_menu->addAction(tr("Record Trace"), this, [](bool checked) { Tracer::getInstance().setEnabled(checked); });
+  record_action->setCheckable(true);
+  record_action->setChecked(Tracer::getInstance().isEnabled());
+
+  const int event_count = Tracer::getInstance().eventCount();
+  QAction *export_action = debug_menu->addAction(tr("Export Trace (%1 events)...").arg(event_count), this, [this] {
+    QString file_name = QFileDialog::getSaveFileName(this, tr("Export Trace"), get_base_path() + "trace.json", tr("Chrome trace (*.json)"));
+    if (file_name.isEmpty())
+    {
+      return;
+    }
+    if (!Tracer::getInstance().exportChromeTrace(file_name))
+    {
+      call_error(tr("Failed to export the trace to %1.").arg(file_name));
+    }
+  });
+  export_action->setEnabled(event_count > 0);
+
+  QAction *clear_action = debug_menu->addAction(tr("Clear Trace"), this, [] { Tracer::getInstance().clear(); });
+  clear_action->setEnabled(event_count > 0);
+
+  menu->popup(ui_settings->mapToGlobal(pos));
+}
+
 void Courtroom::on_additive_clicked()
 {
   if (ui_additive->isChecked())
@@ -6530,11 +6450,12 @@ void Courtroom::focus_ic_input()
 
 void Courtroom::regenerate_ic_chatlog()
 {
-  ui_ic_chatlog->clear();
+  ic_log_model->invalidate();
   last_ic_message = "";
-  foreach (ChatLogPiece item, ic_chatlog_history)
+  if (ic_log_model->entryCount() > 0)
   {
-    append_ic_text(item.message, item.character_name, item.character, item.action, item.color, item.local_player, item.timestamp.toLocalTime());
+    const ChatLogPiece &item = ic_log_model->newestPiece();
+    last_ic_message = (custom_shownames ? item.character_name : ao_app->get_showname(item.character)) + ":" + item.message;
   }
 }
 
@@ -16,16 +16,21 @@
 #include "aosfxplayer.h"
 #include "aotextarea.h"
 #include "aotextboxwidgets.h"
+#include "assetprefetcher.h"
 #include "chatlogpiece.h"
 #include "datatypes.h"
 #include "debug_functions.h"
 #include "eventfilters.h"
 #include "file_functions.h"
 #include "hardware_functions.h"
+#include "iclogmodel.h"
+#include "iclogview.h"
+#include "icmessage.h"
 #include "lobby.h"
 #include "screenslidetimer.h"
 #include "scrolltext.h"
 #include "widgets/aooptionsdialog.h"
+#include "widgets/chat_history_dialog.h"
 #include "widgets/playerlistwidget.h"
 
 #include <QCheckBox>
@@ -36,6 +41,7 @@
 #include <QListWidget>
 #include <QMainWindow>
 #include <QMap>
+#include <QPointer>
 #include <QPlainTextEdit>
 #include <QQueue>
 #include <QSlider>
@@ -62,6 +68,7 @@
 #include <QTextCharFormat>
 
 #include <QFuture>
+#include <QFutureWatcher>
 
 #include <algorithm>
 #include <stack>
@@ -194,6 +201,12 @@ public:
   // Add the message packet to the stack
   void chatmessage_enqueue(QStringList p_contents);
 
+  // Returns true while a message is queued or still being shown
+  bool is_chatmessage_pending();
+
+  // Load the blips and SFX of a character ahead of time
+  void preload_character_sounds(QString p_char);
+
   // Parse the chat message packet and unpack it into the m_chatmessage[ITEM] format
   void unpack_chatmessage(QStringList p_contents);
 
@@ -248,10 +261,9 @@ public:
 
   void log_ic_text(QString p_name, QString p_showname, QString p_message, QString p_action = QString(), int p_color = 0, bool p_selfname = false);
 
-  // adds text to the IC chatlog. p_name first as bold then p_text then a newlin
-  // this function keeps the chatlog scrolled to the top unless there's text
-  // selected
-  // or the user isn't already scrolled to the top
+  // adds text to the IC chatlog. p_name first as bold then p_text then a newline
+  // the chatlog stays scrolled to the newest message unless the user scrolled
+  // away from it
   void append_ic_text(QString p_text, QString p_name = QString(), QString p_char = QString(), QString action = QString(), int color = 0, bool selfname = false, QDateTime timestamp = QDateTime::currentDateTime(), bool ghost = false);
 
   // clear sent messages that appear on the IC log but haven't been delivered
@@ -324,9 +336,6 @@ private:
 
   kal::ScreenSlideTimer *m_screenslide_timer;
 
-  bool next_character_is_not_special = false; // If true, write the
-                                              // next character as it is.
-
   bool message_is_centered = false;
 
   int current_display_speed = 3;
@@ -355,10 +364,10 @@ private:
   QVector<QString> arup_cms;
   QVector<QString> arup_locks;
 
-  QVector<ChatLogPiece> ic_chatlog_history;
   QString last_ic_message;
 
   QQueue<QStringList> chatmessage_queue;
+  AssetPrefetcher *asset_prefetcher;
 
   // triggers ping_server() every 45 seconds
   QTimer *keepalive_timer;
@@ -371,11 +380,8 @@ private:
   bool is_pinging = false;
 
   // int chat_tick_interval = 60;
-  // which tick position(character in chat message) we are at
+  // which tick position(grapheme in chat message) we are at
   int tick_pos = 0;
-  // the actual document tick pos we gotta worry about for making the text
-  // scroll better
-  int real_tick_pos = 0;
   // used to determine how often blips sound
   int blip_ticker = 0;
   int blip_rate = 2;
@@ -450,17 +456,12 @@ private:
   // amount by which we multiply the delay when we parse punctuation chars
   const int punctuation_modifier = 3;
 
-  // amount of ghost blocks
-  int ghost_blocks = 0;
-
   // Minumum and maximum number of parameters in the MS packet
   static const int MS_MINIMUM = 15;
   static const int MS_MAXIMUM = 32;
   QString m_chatmessage[MS_MAXIMUM];
   QString m_previous_chatmessage[MS_MAXIMUM];
 
-  QString additive_previous;
-
   // char id, muted or not
   QMap<int, bool> mute_map;
 
@@ -624,16 +625,21 @@ private:
   AOChatboxLabel *ui_vp_showname;
   kal::InterfaceAnimationLayer *ui_vp_chat_arrow;
   QTextEdit *ui_vp_message;
+  ICMessageRenderer *ic_message_renderer;
   kal::SplashAnimationLayer *ui_vp_testimony;
   kal::SplashAnimationLayer *ui_vp_wtce;
   kal::EffectAnimationLayer *ui_vp_effect;
   kal::SplashAnimationLayer *ui_vp_objection;
 
-  QTextEdit *ui_ic_chatlog;
+  ICLogModel *ic_log_model;
+  ICLogView *ui_ic_chatlog;
 
   AOTextArea *ui_debug_log;
   AOTextArea *ui_server_chatlog;
 
+  // Opened with /history
+  QPointer<ChatHistoryDialog> chat_history_dialog;
+
   QListWidget *ui_mute_list;
   QTreeWidget *ui_area_list;
   QTreeWidget *ui_music_list;
@@ -769,8 +775,29 @@ private:
   // abstract widget to hold char buttons
   QWidget *ui_char_buttons;
 
+  // buttons are only created for the visible page and reused across pages
   QVector<AOCharButton *> ui_char_button_list;
-  QVector<AOCharButton *> ui_char_button_list_filtered;
+  // the character id shown by each button
+  QVector<int> ui_char_button_ids;
+
+  // tree items and categories of the characters, indexed by character id
+  QVector<QTreeWidgetItem *> ui_char_list_items;
+  QStringList char_categories;
+  // tree items waiting for their icon to be loaded
+  QMultiHash<QString, QTreeWidgetItem *> ui_char_list_pending_icons;
+
+  // what the character tree needs to know about one character
+  class CharacterListEntry
+  {
+  public:
+    std::shared_ptr<const CharacterIni> ini;
+    QString icon_path;
+  };
+  // finds and parses every char.ini and icon before the character tree is built
+  QFutureWatcher<CharacterListEntry> char_list_watcher;
+
+  // ids of the characters that pass the filter
+  QVector<int> char_list_filtered;
 
   AOButton *ui_back_to_lobby;
 
@@ -790,8 +817,11 @@ private:
   void set_char_select_page();
   void char_clicked(int n_char);
   void on_char_button_context_menu_requested(const QPoint &pos);
+  AOCharButton *get_char_button(int index);
   void put_button_in_place(int starting, int chars_on_this_page);
   void filter_character_list();
+  void build_character_list();
+  void on_char_icon_ready(const QString &fileName, const QSize &size);
 
   void initialize_emotes();
   void refresh_emotes();
@@ -806,6 +836,16 @@ private:
   void reset_ui();
 
   void regenerate_ic_chatlog();
+
+  // Renders an entry of the IC chatlog with the current log options
+  QString render_ic_log_entry(const ChatLogPiece &p_piece, bool ghost);
+
+Q_SIGNALS:
+  // Emitted once the text of an IC message starts appearing
+  void chatmessage_started();
+  // Emitted once an IC message is shown in full
+  void chatmessage_finished();
+
 public Q_SLOTS:
   void objection_done();
   void preanim_done();
@@ -938,6 +978,7 @@ private Q_SLOTS:
   void on_change_character_clicked();
   void on_call_mod_clicked();
   void on_settings_clicked();
+  void on_settings_context_menu_requested(const QPoint &pos);
 
   void focus_ic_input();
   void on_additive_clicked();
@@ -0,0 +1,510 @@
+#include "demoreader.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+static const quint32 INDEX_MAGIC = 0x414F4449; // AODI
+static const qint32 INDEX_VERSION = 1;
+
+static DemoReader::PacketKind packet_kind(QByteArrayView packet)
+{
+  static const struct
+  {
+    const char *header;
+    DemoReader::PacketKind kind;
+  } kinds[] = {
+      {"wait#", DemoReader::WaitPacket},
+      {"SC#", DemoReader::CharacterListPacket},
+      {"MS#", DemoReader::MessagePacket},
+      {"BN#", DemoReader::BackgroundPacket},
+      {"SP#", DemoReader::PositionPacket},
+      {"MC#", DemoReader::MusicPacket},
+      {"HP#", DemoReader::HealthPacket},
+      {"LE#", DemoReader::EvidencePacket},
+  };
+
+  for (const auto &i_kind : kinds)
+  {
+    if (packet.startsWith(i_kind.header))
+    {
+      return i_kind.kind;
+    }
+  }
+  return DemoReader::OtherPacket;
+}
+
+static qint64 wait_duration(QByteArrayView packet)
+{
+  const QByteArray arguments = QByteArray::fromRawData(packet.data() + 5, packet.size() - 5);
+  return qMax<qint64>(0, arguments.left(arguments.indexOf('#')).toLongLong());
+}
+
+static bool read_varint(const char *data, qint64 size, qint64 &position, quint64 &value)
+{
+  value = 0;
+  for (int shift = 0; shift < 64 && position < size; shift += 7)
+  {
+    const quint8 byte = data[position++];
+    value |= quint64(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool read_string(const QByteArray &data, qint64 &position, QByteArray &string)
+{
+  quint64 length = 0;
+  if (!read_varint(data.constData(), data.size(), position, length) || length > quint64(data.size() - position))
+  {
+    return false;
+  }
+  // The string only lives as long as the block it was read from.
+  string = QByteArray::fromRawData(data.constData() + position, length);
+  position += length;
+  return true;
+}
+
+DemoReader::~DemoReader()
+{
+  close();
+}
+
+bool DemoReader::open(const QString &fileName)
+{
+  close();
+
+  m_file.setFileName(fileName);
+  if (!m_file.open(QIODevice::ReadOnly))
+  {
+    qWarning() << "could not open demo file" << fileName << m_file.errorString();
+    return false;
+  }
+
+  m_size = m_file.size();
+  m_data = reinterpret_cast<const char *>(m_file.map(0, m_size));
+  if (!m_data)
+  {
+    // Some file systems can't be mapped; fall back to reading the whole file.
+    m_buffer = m_file.readAll();
+    m_data = m_buffer.constData();
+    m_size = m_buffer.size();
+  }
+
+  if (m_size >= BINARY_HEADER_SIZE && std::memcmp(m_data, BINARY_MAGIC, 4) == 0)
+  {
+    // Binary demos are compact enough that scanning them is cheaper than
+    // keeping an index around.
+    m_format = BinaryFormat;
+    if (quint8(m_data[4]) != BINARY_VERSION || !buildBinaryIndex())
+    {
+      qWarning() << "could not read demo file" << fileName << "(unsupported version or corrupted file)";
+      close();
+      return false;
+    }
+  }
+  else
+  {
+    const QString index_file = fileName + ".index";
+    if (!loadIndex(index_file))
+    {
+      buildIndex();
+      saveIndex(index_file);
+    }
+  }
+  indexMessages();
+
+  return true;
+}
+
+void DemoReader::close()
+{
+  if (m_file.isOpen())
+  {
+    m_file.close();
+  }
+  m_format = TextFormat;
+  m_data = nullptr;
+  m_size = 0;
+  m_buffer.clear();
+  m_entries.clear();
+  m_messages.clear();
+  m_duration = 0;
+  m_blocks.clear();
+  m_headers.clear();
+  m_cached_block = -1;
+  m_cached_data.clear();
+}
+
+QString DemoReader::fileName() const
+{
+  return m_file.fileName();
+}
+
+DemoReader::Format DemoReader::format() const
+{
+  return m_format;
+}
+
+int DemoReader::size() const
+{
+  return m_entries.size();
+}
+
+QString DemoReader::packet(int index) const
+{
+  const Entry &entry = m_entries.at(index);
+  if (m_format == TextFormat)
+  {
+    QString packet = QString::fromUtf8(m_data + entry.offset, entry.length);
+    // Packets spanning several lines were written with the platform's line endings.
+    packet.remove(QLatin1Char('\r'));
+    return packet;
+  }
+
+  if (entry.block == -1)
+  {
+    // Stands in for the delay stored in the next record.
+    const qint64 next_time = index + 1 < m_entries.size() ? m_entries.at(index + 1).time : m_duration;
+    return "wait#" + QString::number(next_time - entry.time) + "#%";
+  }
+
+  const QByteArray data = blockData(entry.block);
+  qint64 position = entry.offset;
+  Record record;
+  if (!readRecord(data, position, record))
+  {
+    return QString();
+  }
+
+  if (record.verbatim)
+  {
+    return QString::fromUtf8(record.header);
+  }
+
+  QByteArray packet = record.header;
+  for (const QByteArray &field : std::as_const(record.fields))
+  {
+    packet.append('#').append(field);
+  }
+  packet.append("#%");
+  return QString::fromUtf8(packet);
+}
+
+DemoReader::PacketKind DemoReader::kind(int index) const
+{
+  return m_entries.at(index).kind;
+}
+
+qint64 DemoReader::time(int index) const
+{
+  return m_entries.at(index).time;
+}
+
+qint64 DemoReader::duration() const
+{
+  return m_duration;
+}
+
+int DemoReader::messageCount() const
+{
+  return m_messages.size();
+}
+
+int DemoReader::messageIndex(int message) const
+{
+  return m_messages.value(message, -1);
+}
+
+int DemoReader::messagesBefore(int index) const
+{
+  return std::lower_bound(m_messages.constBegin(), m_messages.constEnd(), index) - m_messages.constBegin();
+}
+
+int DemoReader::indexAt(qint64 msecs) const
+{
+  auto it = std::lower_bound(m_entries.constBegin(), m_entries.constEnd(), msecs, [](const Entry &entry, qint64 time) { return entry.time < time; });
+  return it - m_entries.constBegin();
+}
+
+void DemoReader::buildIndex()
+{
+  m_entries.clear();
+  m_duration = 0;
+
+  qint64 position = 0;
+  while (position < m_size)
+  {
+    // A packet ends with the first line ending in %; the lines before it are
+    // part of a message that contained line breaks.
+    const qint64 start = position;
+    qint64 end = start;
+    while (position < m_size)
+    {
+      const char *newline = static_cast<const char *>(std::memchr(m_data + position, '\n', m_size - position));
+      const qint64 line_end = newline ? newline - m_data : m_size;
+      end = line_end;
+      if (end > start && m_data[end - 1] == '\r')
+      {
+        --end;
+      }
+      position = newline ? line_end + 1 : m_size;
+      if (end > start && m_data[end - 1] == '%')
+      {
+        break;
+      }
+    }
+
+    if (end == start)
+    {
+      continue;
+    }
+
+    Entry entry;
+    entry.offset = start;
+    entry.length = end - start;
+    entry.time = m_duration;
+    entry.kind = packet_kind(QByteArrayView(m_data + start, entry.length));
+    m_entries.append(entry);
+
+    if (entry.kind == WaitPacket)
+    {
+      m_duration += wait_duration(QByteArrayView(m_data + start, entry.length));
+    }
+  }
+}
+
+bool DemoReader::buildBinaryIndex()
+{
+  m_entries.clear();
+  m_blocks.clear();
+  m_headers.clear();
+  m_duration = 0;
+
+  qint64 position = BINARY_HEADER_SIZE;
+  while (position < m_size)
+  {
+    quint64 size = 0;
+    quint64 stored_size = 0;
+    if (!read_varint(m_data, m_size, position, size) || !read_varint(m_data, m_size, position, stored_size) || position >= m_size)
+    {
+      return false;
+    }
+
+    Block block;
+    const quint8 compression = m_data[position++];
+    if (compression > 1 || stored_size > quint64(m_size - position) || size > quint64(std::numeric_limits<int>::max()))
+    {
+      return false;
+    }
+    block.offset = position;
+    block.stored_size = stored_size;
+    block.size = size;
+    block.compressed = compression == 1;
+    m_blocks.append(block);
+    position += stored_size;
+
+    const int block_index = m_blocks.size() - 1;
+    const QByteArray data = blockData(block_index);
+    if (data.size() != block.size)
+    {
+      return false;
+    }
+
+    qint64 record_position = 0;
+    while (record_position < data.size())
+    {
+      Entry entry;
+      entry.block = block_index;
+      entry.offset = record_position;
+
+      Record record;
+      if (!readRecord(data, record_position, record))
+      {
+        return false;
+      }
+
+      if (record.delay > 0)
+      {
+        Entry wait;
+        wait.time = m_duration;
+        wait.kind = WaitPacket;
+        m_entries.append(wait);
+        m_duration += record.delay;
+      }
+
+      if (record.new_header)
+      {
+        m_headers.append(QByteArray(record.header.constData(), record.header.size()));
+      }
+
+      entry.length = record_position - entry.offset;
+      entry.time = m_duration;
+      entry.kind = packet_kind(record.verbatim ? record.header : record.header + '#');
+      m_entries.append(entry);
+
+      if (entry.kind == WaitPacket)
+      {
+        m_duration += record.verbatim ? wait_duration(record.header) : qMax<qint64>(0, record.fields.value(0).toLongLong());
+      }
+    }
+  }
+  return true;
+}
+
+QByteArray DemoReader::blockData(int block) const
+{
+  const Block &info = m_blocks.at(block);
+  if (!info.compressed)
+  {
+    return QByteArray::fromRawData(m_data + info.offset, info.stored_size);
+  }
+
+  if (m_cached_block != block)
+  {
+    m_cached_data = qUncompress(reinterpret_cast<const uchar *>(m_data + info.offset), info.stored_size);
+    m_cached_block = block;
+  }
+  return m_cached_data;
+}
+
+bool DemoReader::readRecord(const QByteArray &data, qint64 &position, Record &record) const
+{
+  quint64 header_reference = 0;
+  if (!read_varint(data.constData(), data.size(), position, record.delay) || !read_varint(data.constData(), data.size(), position, header_reference))
+  {
+    return false;
+  }
+
+  record.verbatim = header_reference == 0;
+  record.new_header = header_reference == 1;
+  if (header_reference < 2)
+  {
+    if (!read_string(data, position, record.header))
+    {
+      return false;
+    }
+    if (record.verbatim)
+    {
+      return true;
+    }
+  }
+  else if (header_reference - 2 < quint64(m_headers.size()))
+  {
+    record.header = m_headers.at(header_reference - 2);
+  }
+  else
+  {
+    return false;
+  }
+
+  quint64 field_count = 0;
+  // Every field takes at least a byte, which bounds a corrupted count.
+  if (!read_varint(data.constData(), data.size(), position, field_count) || field_count > quint64(data.size() - position))
+  {
+    return false;
+  }
+  record.fields.reserve(field_count);
+  for (quint64 i = 0; i < field_count; ++i)
+  {
+    QByteArray field;
+    if (!read_string(data, position, field))
+    {
+      return false;
+    }
+    record.fields.append(field);
+  }
+  return true;
+}
+
+bool DemoReader::loadIndex(const QString &indexFile)
+{
+  QFile file(indexFile);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+
+  QDataStream in(&file);
+  quint32 magic = 0;
+  qint32 version = 0;
+  qint64 size = 0;
+  qint64 modified = 0;
+  qint32 entry_count = 0;
+  in >> magic >> version >> size >> modified >> entry_count;
+  if (magic != INDEX_MAGIC || version != INDEX_VERSION || size != m_size || modified != QFileInfo(m_file.fileName()).lastModified().toMSecsSinceEpoch())
+  {
+    return false;
+  }
+
+  // Every packet takes at least two bytes, which bounds a corrupted count.
+  QVector<Entry> entries;
+  entries.reserve(qBound<qint64>(0, entry_count, m_size / 2));
+  for (int i = 0; i < entry_count && in.status() == QDataStream::Ok; ++i)
+  {
+    Entry entry;
+    quint8 kind = 0;
+    in >> entry.offset >> entry.length >> entry.time >> kind;
+    entry.kind = static_cast<PacketKind>(kind);
+    if (entry.offset < 0 || entry.length < 0 || entry.offset + entry.length > m_size)
+    {
+      in.setStatus(QDataStream::ReadCorruptData);
+    }
+    entries.append(entry);
+  }
+  in >> m_duration;
+
+  if (in.status() != QDataStream::Ok)
+  {
+    qWarning() << "discarding demo index" << indexFile << "(file is corrupted)";
+    m_duration = 0;
+    return false;
+  }
+
+  m_entries = entries;
+  return true;
+}
+
+void DemoReader::saveIndex(const QString &indexFile) const
+{
+  QSaveFile file(indexFile);
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    qWarning() << "could not write demo index" << indexFile;
+    return;
+  }
+
+  QDataStream out(&file);
+  out << INDEX_MAGIC << INDEX_VERSION << m_size << QFileInfo(m_file.fileName()).lastModified().toMSecsSinceEpoch() << qint32(m_entries.size());
+  for (const Entry &entry : m_entries)
+  {
+    out << entry.offset << entry.length << entry.time << quint8(entry.kind);
+  }
+  out << m_duration;
+
+  if (!file.commit())
+  {
+    qWarning() << "could not write demo index" << indexFile;
+  }
+}
+
+void DemoReader::indexMessages()
+{
+  m_messages.clear();
+  for (int i = 0; i < m_entries.size(); ++i)
+  {
+    if (m_entries.at(i).kind == MessagePacket)
+    {
+      m_messages.append(i);
+    }
+  }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Random access to the packets of a demo file.
+ *
+ * @details The file is memory-mapped rather than read up front. The offset,
+ * kind and playback time of every packet are kept in an index. For text
+ * demos, the index is saved next to the demo file and reused as long as the
+ * demo file doesn't change, so reopening a large demo doesn't require
+ * scanning it again.
+ *
+ * Binary demos, as written by DemoWriter, start with BINARY_MAGIC followed by
+ * the format version and a reserved byte. The rest of the file is a sequence
+ * of blocks, each made of its decoded size and stored size as varints, a
+ * compression byte (0 for none, 1 for zlib) and the stored data. A decoded
+ * block is a sequence of records:
+ *
+ * - the time since the previous record in milliseconds, as a varint, which
+ *   replaces the wait packet of text demos;
+ * - a header reference: 0 for a packet stored verbatim, 1 for a header that
+ *   is used for the first time and stored inline, or 2 and up for the header
+ *   that was stored inline at that position, counting from 2;
+ * - unless the packet was stored verbatim, the field count and the fields.
+ *
+ * Strings are stored as their UTF-8 length as a varint, followed by their
+ * data. Fields are kept escaped, so converting between both formats
+ * preserves every packet exactly.
+ */
+class DemoReader
+{
+public:
+  enum Format
+  {
+    TextFormat,
+    BinaryFormat,
+  };
+
+  enum PacketKind : quint8
+  {
+    OtherPacket,
+    WaitPacket,
+    CharacterListPacket,
+    MessagePacket,
+    BackgroundPacket,
+    PositionPacket,
+    MusicPacket,
+    HealthPacket,
+    EvidencePacket,
+  };
+
+  DemoReader() = default;
+  ~DemoReader();
+
+  bool open(const QString &fileName);
+  void close();
+
+  QString fileName() const;
+  Format format() const;
+
+  /// Amount of packets in the demo.
+  int size() const;
+
+  QString packet(int index) const;
+  PacketKind kind(int index) const;
+
+  /// Playback time at which the packet is sent, in milliseconds.
+  qint64 time(int index) const;
+  qint64 duration() const;
+
+  /// Amount of IC messages in the demo.
+  int messageCount() const;
+
+  /// Returns the packet index of the IC message with the given number, counting from 0.
+  int messageIndex(int message) const;
+
+  /// Returns the amount of IC messages before the packet at index.
+  int messagesBefore(int index) const;
+
+  /// Returns the index of the first packet sent at or after msecs.
+  int indexAt(qint64 msecs) const;
+
+  static constexpr char BINARY_MAGIC[] = "AOBD";
+  static constexpr quint8 BINARY_VERSION = 1;
+  static constexpr int BINARY_HEADER_SIZE = 6;
+
+private:
+  class Entry
+  {
+  public:
+    /// Offset in the file, or in the decoded block for binary demos.
+    qint64 offset = 0;
+    qint32 length = 0;
+    qint64 time = 0;
+    PacketKind kind = OtherPacket;
+    /// Block of a binary demo, or -1 if the packet isn't stored in one.
+    qint32 block = -1;
+  };
+
+  class Block
+  {
+  public:
+    qint64 offset = 0;
+    qint64 stored_size = 0;
+    qint64 size = 0;
+    bool compressed = false;
+  };
+
+  class Record
+  {
+  public:
+    quint64 delay = 0;
+    bool verbatim = false;
+    bool new_header = false;
+    QByteArray header;
+    QList<QByteArray> fields;
+  };
+
+  QFile m_file;
+  Format m_format = TextFormat;
+  const char *m_data = nullptr;
+  qint64 m_size = 0;
+  QByteArray m_buffer;
+  QVector<Entry> m_entries;
+  QVector<int> m_messages;
+  qint64 m_duration = 0;
+
+  QVector<Block> m_blocks;
+  QVector<QByteArray> m_headers;
+  mutable int m_cached_block = -1;
+  mutable QByteArray m_cached_data;
+
+  void buildIndex();
+  bool buildBinaryIndex();
+  QByteArray blockData(int block) const;
+  bool readRecord(const QByteArray &data, qint64 &position, Record &record) const;
+  bool loadIndex(const QString &indexFile);
+  void saveIndex(const QString &indexFile) const;
+  void indexMessages();
+};
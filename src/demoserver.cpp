@@ -1,6 +1,18 @@
 #include "demoserver.h"
 
 #include "datatypes.h"
+#include "demowriter.h"
+
+#include <QFileInfo>
+#include <QMap>
+
+#include <algorithm>
+
+static QString format_time(qint64 msecs)
+{
+  const qint64 seconds = msecs / 1000;
+  return QString("%1:%2:%3").arg(seconds / 3600).arg(seconds / 60 % 60, 2, 10, QChar('0')).arg(seconds % 60, 2, 10, QChar('0'));
+}
 
 DemoServer::DemoServer(QObject *parent)
     : QObject(parent)
@@ -58,15 +70,16 @@ void DemoServer::accept_connection()
   }
   load_demo(filename);
 
-  if (demo_data.isEmpty())
+  if (demo_reader.size() == 0)
   {
     destroy_connection();
     return;
   }
 
-  if (demo_data.head().startsWith("SC#"))
+  if (demo_reader.kind(0) == DemoReader::CharacterListPacket)
   {
-    sc_packet = demo_data.dequeue();
+    sc_packet = demo_reader.packet(0);
+    demo_position = 1;
     AOPacket sc(sc_packet);
     num_chars = sc.content().length();
   }
@@ -96,32 +109,16 @@ void DemoServer::recv_data(const QString &message)
   const QStringList packet_list = message.split("%", Qt::SkipEmptyParts);
   for (const QString &packet : packet_list)
   {
-    QStringList f_contents;
+    QStringView f_packet_view(packet);
     // Packet should *always* end with #
-    if (packet.endsWith("#"))
-    {
-      f_contents = packet.chopped(1).split("#");
-    }
     // But, if it somehow doesn't, we should still be able to handle it
-    else
-    {
-      f_contents = packet.split("#");
-    }
-    // Empty packets are suspicious!
-    if (f_contents.isEmpty())
-    {
-      qWarning() << "WARNING: Empty packet received from server, skipping...";
-      continue;
-    }
-    // Take the first arg as the command
-    QString command = f_contents.takeFirst();
-    for (QString &data : f_contents)
+    if (f_packet_view.endsWith(u'#'))
     {
-      data = AOPacket::decode(data);
+      f_packet_view.chop(1);
     }
 
-    // The rest is contents of the packet
-    AOPacket f_packet(command, f_contents);
+    // The first field is the command, the rest is contents of the packet
+    AOPacket f_packet = AOPacket::fromString(f_packet_view);
 
     // Ship it to the server!
     handle_packet(f_packet);
@@ -182,7 +179,11 @@ void DemoServer::handle_packet(AOPacket p_packet)
       {
         return;
       }
-      load_demo(path);
+      if (!load_demo(path))
+      {
+        send_ooc(tr("Could not load the demo file."));
+        return;
+      }
       QString packet = "CT#DEMO#" + tr("Demo file loaded. Send /play or > in OOC to begin playback.") + "#1#%";
       client_sock->sendTextMessage(packet.toUtf8());
       reset_state();
@@ -197,13 +198,89 @@ void DemoServer::handle_packet(AOPacket p_packet)
       }
       else
       {
-        if (demo_data.isEmpty() && p_path != "")
+        if (demo_position >= demo_reader.size() && p_path != "")
         {
           load_demo(p_path);
         }
         playback();
       }
     }
+    else if (contents[1].startsWith("/seek_msg"))
+    {
+      QStringList args = contents[1].split(" ", Qt::SkipEmptyParts);
+      bool ok = false;
+      int message = args.size() > 1 ? args.at(1).toInt(&ok) : 0;
+      if (!ok || message < 1 || message > demo_reader.messageCount())
+      {
+        send_ooc(tr("Usage: /seek_msg <number>, where the number is between 1 and %1.").arg(demo_reader.messageCount()));
+        return;
+      }
+      seek(demo_reader.messageIndex(message - 1));
+    }
+    else if (contents[1].startsWith("/seek"))
+    {
+      QStringList args = contents[1].split(" ", Qt::SkipEmptyParts);
+      bool ok = args.size() > 1;
+      qint64 seconds = 0;
+      if (ok)
+      {
+        // Accepts seconds, minutes:seconds or hours:minutes:seconds
+        const QStringList parts = args.at(1).split(":");
+        for (const QString &part : parts)
+        {
+          seconds = seconds * 60 + part.toUInt(&ok);
+          if (!ok || parts.size() > 3)
+          {
+            ok = false;
+            break;
+          }
+        }
+      }
+      if (!ok)
+      {
+        send_ooc(tr("Usage: /seek <time>, where the time is in seconds or formatted as [hh:]mm:ss."));
+        return;
+      }
+      seek(demo_reader.indexAt(seconds * 1000));
+    }
+    else if (contents[1].startsWith("/convert"))
+    {
+      QStringList args = contents[1].split(" ", Qt::SkipEmptyParts);
+      DemoReader::Format f_format = demo_reader.format() == DemoReader::TextFormat ? DemoReader::BinaryFormat : DemoReader::TextFormat;
+      if (args.size() > 1 && (args.at(1) == "text" || args.at(1) == "binary"))
+      {
+        f_format = args.at(1) == "text" ? DemoReader::TextFormat : DemoReader::BinaryFormat;
+      }
+      else if (args.size() > 1)
+      {
+        send_ooc(tr("Usage: /convert [text|binary], which saves a copy of the current demo in the given format."));
+        return;
+      }
+      if (p_path.isEmpty())
+      {
+        send_ooc(tr("No demo file is loaded."));
+        return;
+      }
+
+      QString path = QFileDialog::getSaveFileName(nullptr, tr("Convert Demo"), p_path, tr("Demo Files (*.demo)"));
+      if (path.isEmpty())
+      {
+        return;
+      }
+      if (QFileInfo(path) == QFileInfo(p_path))
+      {
+        send_ooc(tr("The converted demo must be saved to a different file."));
+        return;
+      }
+      if (DemoWriter::convert(p_path, path, f_format))
+      {
+        send_ooc(tr("Saved a %1 copy of the demo to %2.").arg(f_format == DemoReader::TextFormat ? tr("text") : tr("binary"), path));
+      }
+      else
+      {
+        send_ooc(tr("Could not convert the demo."));
+      }
+    }
     else if (contents[1].startsWith("/pause") || contents[1] == "|")
     {
       int timeleft = timer->remainingTime();
@@ -243,7 +320,11 @@ void DemoServer::handle_packet(AOPacket p_packet)
     }
     else if (contents[1].startsWith("/reload"))
     {
-      load_demo(p_path);
+      if (!load_demo(p_path))
+      {
+        send_ooc(tr("Could not reload the demo file."));
+        return;
+      }
       QString packet = "CT#DEMO#" + tr("Current demo file reloaded. Send /play or > in OOC to begin playback.") + "#1#%";
       client_sock->sendTextMessage(packet.toUtf8());
       reset_state();
@@ -287,46 +368,31 @@ void DemoServer::handle_packet(AOPacket p_packet)
     }
     else if (contents[1].startsWith("/help"))
     {
-      QString packet = "CT#DEMO#" + tr("Available commands:\nload, reload, play, pause, max_wait, debug, help") + "#1#%";
+      QString packet = "CT#DEMO#" + tr("Available commands:\nload, reload, convert, play, pause, seek, seek_msg, max_wait, debug, help") + "#1#%";
       client_sock->sendTextMessage(packet.toUtf8());
     }
   }
 }
 
-void DemoServer::load_demo(QString filename)
+bool DemoServer::load_demo(QString filename)
 {
-  QFile demo_file(filename);
-  demo_file.open(QIODevice::ReadOnly);
-  if (!demo_file.isOpen())
-  {
-    return;
-  }
-  // Clear demo data
-  demo_data.clear();
-  // Set the demo filepath
-  p_path = filename;
-  // Process the demo file
-  QTextStream demo_stream(&demo_file);
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-  demo_stream.setCodec("UTF-8");
-#endif
-  QString line = demo_stream.readLine();
-  while (!line.isNull())
+  if (!demo_reader.open(filename))
   {
-    while (!line.endsWith("%"))
+    // Opening closed the demo that was loaded before, so go back to it.
+    if (p_path.isEmpty() || !demo_reader.open(p_path))
     {
-      line += "\n";
-      line += demo_stream.readLine();
+      p_path.clear();
+      demo_position = 0;
     }
-    demo_data.enqueue(line);
-    line = demo_stream.readLine();
+    return false;
   }
-  demo_file.flush();
-  demo_file.close();
+  demo_position = 0;
+  // Set the demo filepath
+  p_path = filename;
 
   // No-shenanigans 2.9.0 demo file with the dreaded demo desync bug detected https://github.com/AttorneyOnline/AO2-Client/pull/496
   // If we don't start with the SC packet this means user-edited weirdo shenanigans. Don't screw around with those.
-  if (demo_data.head().startsWith("SC#") && demo_data.last().startsWith("wait#"))
+  if (demo_reader.size() > 0 && demo_reader.kind(0) == DemoReader::CharacterListPacket && demo_reader.kind(demo_reader.size() - 1) == DemoReader::WaitPacket)
   {
     qInfo() << "Loaded a broken pre-2.9.1 demo file, with the wait desync issue!";
     QMessageBox *msgBox = new QMessageBox;
@@ -343,9 +409,9 @@ void DemoServer::load_demo(QString filename)
     case QMessageBox::Yes:
       qInfo() << "Making a backup of the broken demo...";
       QFile::copy(filename, filename + ".backup");
-      while (!demo_data.isEmpty())
+      for (int i = 0; i < demo_reader.size(); ++i)
       {
-        QString current_packet = demo_data.dequeue();
+        QString current_packet = demo_reader.packet(i);
         // TODO: faster way of doing this, maybe with QtConcurrent's MapReduce methods?
         if (!current_packet.startsWith("SC#") && current_packet.startsWith("wait#"))
         {
@@ -354,22 +420,20 @@ void DemoServer::load_demo(QString filename)
         }
         p_demo_data.enqueue(current_packet);
       }
-      if (demo_file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate))
       {
-        QTextStream out(&demo_file);
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-        out.setCodec("UTF-8");
-#endif
-        out << p_demo_data.dequeue();
-        for (const QString &line : std::as_const(p_demo_data))
+        // The file is still mapped, which would keep it from being rewritten.
+        DemoWriter writer(demo_reader.format());
+        demo_reader.close();
+        if (writer.open(filename))
         {
-          out << "\n" << line;
+          for (const QString &packet : std::as_const(p_demo_data))
+          {
+            writer.write(packet);
+          }
+          writer.commit();
         }
-        demo_file.flush();
-        demo_file.close();
       }
-      load_demo(filename);
-      break;
+      return load_demo(filename);
     case QMessageBox::No:
       // No was clicked
       break;
@@ -378,6 +442,7 @@ void DemoServer::load_demo(QString filename)
       break;
     }
   }
+  return true;
 }
 
 void DemoServer::reset_state()
@@ -406,12 +471,12 @@ void DemoServer::reset_state()
 
 void DemoServer::playback()
 {
-  if (demo_data.isEmpty())
+  if (demo_position >= demo_reader.size())
   {
     return;
   }
 
-  QString current_packet = demo_data.dequeue();
+  QString current_packet = demo_reader.packet(demo_position++);
   // We reset the elapsed time with this packet
   if (current_packet.startsWith("MS#"))
   {
@@ -421,13 +486,13 @@ void DemoServer::playback()
   while (!current_packet.startsWith("wait#"))
   {
     client_sock->sendTextMessage(current_packet.toUtf8());
-    if (demo_data.isEmpty())
+    if (demo_position >= demo_reader.size())
     {
       break;
     }
-    current_packet = demo_data.dequeue();
+    current_packet = demo_reader.packet(demo_position++);
   }
-  if (!demo_data.isEmpty())
+  if (demo_position < demo_reader.size())
   {
     QStringList f_contents;
     // Packet should *always* end with #
@@ -480,6 +545,83 @@ void DemoServer::playback()
   }
 }
 
+void DemoServer::seek(int p_index)
+{
+  reset_state();
+
+  // Rebuild the state the skipped packets would have left behind: the latest
+  // background, position, health bars, evidence and song on every channel.
+  int f_background = -1;
+  int f_position = -1;
+  int f_evidence = -1;
+  QMap<QString, int> f_health;
+  QMap<int, int> f_music;
+  for (int i = p_index - 1; i >= 0; --i)
+  {
+    switch (demo_reader.kind(i))
+    {
+    case DemoReader::BackgroundPacket:
+      f_background = f_background == -1 ? i : f_background;
+      break;
+    case DemoReader::PositionPacket:
+      f_position = f_position == -1 ? i : f_position;
+      break;
+    case DemoReader::EvidencePacket:
+      f_evidence = f_evidence == -1 ? i : f_evidence;
+      break;
+    case DemoReader::HealthPacket:
+    {
+      const QString f_bar = demo_reader.packet(i).section("#", 1, 1);
+      if (!f_health.contains(f_bar))
+      {
+        f_health.insert(f_bar, i);
+      }
+      break;
+    }
+    case DemoReader::MusicPacket:
+    {
+      const int f_channel = demo_reader.packet(i).section("#", 5, 5).toInt();
+      if (!f_music.contains(f_channel))
+      {
+        f_music.insert(f_channel, i);
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  QList<int> f_state = {f_background, f_position, f_evidence};
+  f_state += f_health.values();
+  f_state += f_music.values();
+  // A background can come with its own position, so keep the original order.
+  std::sort(f_state.begin(), f_state.end());
+  for (int i : std::as_const(f_state))
+  {
+    if (i != -1)
+    {
+      client_sock->sendTextMessage(demo_reader.packet(i).toUtf8());
+    }
+  }
+
+  // The character list was already sent when the client connected.
+  const int first_index = demo_reader.size() > 0 && demo_reader.kind(0) == DemoReader::CharacterListPacket ? 1 : 0;
+  demo_position = qBound(first_index, p_index, qMax(first_index, demo_reader.size()));
+  elapsed_time = 0;
+  timer->stop();
+  timer->setInterval(0);
+
+  qint64 f_time = demo_position < demo_reader.size() ? demo_reader.time(demo_position) : demo_reader.duration();
+  send_ooc(tr("Jumped to %1 of %2, before message %3 of %4. Send /play or > in OOC to continue.").arg(format_time(f_time), format_time(demo_reader.duration())).arg(demo_reader.messagesBefore(demo_position) + 1).arg(demo_reader.messageCount()));
+}
+
+void DemoServer::send_ooc(QString p_message)
+{
+  QString packet = "CT#DEMO#" + p_message + "#1#%";
+  client_sock->sendTextMessage(packet.toUtf8());
+}
+
 void DemoServer::client_disconnect()
 {
   client_sock->deleteLater();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "aopacket.h"
+#include "demoreader.h"
 
 #include <QDebug>
 #include <QFileDialog>
@@ -33,7 +34,8 @@ private:
   bool partial_packet = false;
   bool debug_mode = false;
   QString temp_packet;
-  QQueue<QString> demo_data;
+  DemoReader demo_reader;
+  int demo_position = 0;
   QString sc_packet;
   int num_chars = 0;
   QString p_path;
@@ -42,8 +44,10 @@ private:
   QString filename;
 
   void handle_packet(AOPacket packet);
-  void load_demo(QString filename);
+  bool load_demo(QString filename);
   void reset_state();
+  void seek(int p_index);
+  void send_ooc(QString p_message);
 
 private Q_SLOTS:
   void accept_connection();
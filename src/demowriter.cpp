@@ -0,0 +1,195 @@
+#include "demowriter.h"
+
+#include <QDebug>
+
+#include <utility>
+
+DemoWriter::DemoWriter(DemoReader::Format format, bool compressed)
+    : m_format(format)
+    , m_compressed(compressed)
+{}
+
+bool DemoWriter::open(const QString &fileName)
+{
+  m_file.setFileName(fileName);
+  if (!m_file.open(QIODevice::WriteOnly))
+  {
+    qWarning() << "could not write demo file" << fileName << m_file.errorString();
+    return false;
+  }
+
+  m_empty = true;
+  m_block.clear();
+  m_headers.clear();
+  m_pending_delay = 0;
+
+  if (m_format == DemoReader::BinaryFormat)
+  {
+    QByteArray header(DemoReader::BINARY_MAGIC, 4);
+    header.append(char(DemoReader::BINARY_VERSION));
+    header.append('\0');
+    m_file.write(header);
+  }
+  return true;
+}
+
+void DemoWriter::write(const QString &packet)
+{
+  const QByteArray data = packet.toUtf8();
+  if (m_format == DemoReader::TextFormat)
+  {
+    if (!m_empty)
+    {
+      m_file.write("\r\n");
+    }
+    m_file.write(data);
+    m_empty = false;
+    return;
+  }
+
+  if (data.startsWith("wait#") && data.endsWith("#%"))
+  {
+    // Only waits that are written back identically can become a delay.
+    const QByteArray argument = data.mid(5, data.size() - 7);
+    bool ok = false;
+    const quint64 delay = argument.toULongLong(&ok);
+    if (ok && delay > 0 && QByteArray::number(delay) == argument)
+    {
+      if (m_pending_delay > 0)
+      {
+        writeRecord(0, "wait#" + QByteArray::number(std::exchange(m_pending_delay, 0)) + "#%");
+      }
+      m_pending_delay = delay;
+      return;
+    }
+  }
+
+  writeRecord(std::exchange(m_pending_delay, 0), data);
+}
+
+bool DemoWriter::commit()
+{
+  if (m_format == DemoReader::BinaryFormat)
+  {
+    if (m_pending_delay > 0)
+    {
+      writeRecord(0, "wait#" + QByteArray::number(std::exchange(m_pending_delay, 0)) + "#%");
+    }
+    writeBlock();
+  }
+
+  if (!m_file.commit())
+  {
+    qWarning() << "could not write demo file" << m_file.fileName() << m_file.errorString();
+    return false;
+  }
+  return true;
+}
+
+bool DemoWriter::convert(const QString &source, const QString &destination, DemoReader::Format format)
+{
+  DemoReader reader;
+  if (!reader.open(source))
+  {
+    return false;
+  }
+
+  DemoWriter writer(format);
+  if (!writer.open(destination))
+  {
+    return false;
+  }
+  for (int i = 0; i < reader.size(); ++i)
+  {
+    writer.write(reader.packet(i));
+  }
+  return writer.commit();
+}
+
+void DemoWriter::writeRecord(quint64 delay, const QByteArray &packet)
+{
+  writeVarint(m_block, delay);
+
+  const qsizetype separator = packet.indexOf('#');
+  if (separator == -1 || !packet.endsWith("#%"))
+  {
+    writeVarint(m_block, 0);
+    writeString(m_block, packet);
+  }
+  else
+  {
+    const QByteArray header = packet.left(separator);
+    auto it = m_headers.constFind(header);
+    if (it == m_headers.constEnd())
+    {
+      writeVarint(m_block, 1);
+      writeString(m_block, header);
+      m_headers.insert(header, m_headers.size());
+    }
+    else
+    {
+      writeVarint(m_block, it.value() + 2);
+    }
+
+    // The separator found may already be the one before the final %.
+    QList<QByteArray> fields;
+    if (packet.size() > separator + 2)
+    {
+      fields = packet.mid(separator + 1, packet.size() - separator - 3).split('#');
+    }
+    writeVarint(m_block, fields.size());
+    for (const QByteArray &field : std::as_const(fields))
+    {
+      writeString(m_block, field);
+    }
+  }
+
+  if (m_block.size() >= BLOCK_SIZE)
+  {
+    writeBlock();
+  }
+}
+
+void DemoWriter::writeBlock()
+{
+  if (m_block.isEmpty())
+  {
+    return;
+  }
+
+  QByteArray stored = m_block;
+  quint8 compression = 0;
+  if (m_compressed)
+  {
+    QByteArray compressed = qCompress(m_block);
+    if (compressed.size() < m_block.size())
+    {
+      stored = compressed;
+      compression = 1;
+    }
+  }
+
+  QByteArray header;
+  writeVarint(header, m_block.size());
+  writeVarint(header, stored.size());
+  header.append(char(compression));
+  m_file.write(header);
+  m_file.write(stored);
+  m_block.clear();
+}
+
+void DemoWriter::writeVarint(QByteArray &data, quint64 value)
+{
+  while (value >= 0x80)
+  {
+    data.append(char((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  data.append(char(value));
+}
+
+void DemoWriter::writeString(QByteArray &data, const QByteArray &string)
+{
+  writeVarint(data, string.size());
+  data.append(string);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "demoreader.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QSaveFile>
+#include <QString>
+
+/**
+ * @brief Writes a demo file in either format, one packet at a time.
+ *
+ * @details Nothing replaces the destination until commit() succeeds. Wait
+ * packets are folded into the delay of the next record of binary demos; see
+ * DemoReader for a description of the format.
+ */
+class DemoWriter
+{
+public:
+  static constexpr int BLOCK_SIZE = 64 * 1024;
+
+  explicit DemoWriter(DemoReader::Format format, bool compressed = true);
+
+  bool open(const QString &fileName);
+  void write(const QString &packet);
+  bool commit();
+
+  /// Rewrites the demo at source in the given format.
+  static bool convert(const QString &source, const QString &destination, DemoReader::Format format);
+
+private:
+  DemoReader::Format m_format;
+  bool m_compressed;
+  QSaveFile m_file;
+  bool m_empty = true;
+
+  QByteArray m_block;
+  QHash<QByteArray, int> m_headers;
+  quint64 m_pending_delay = 0;
+
+  void writeRecord(quint64 delay, const QByteArray &packet);
+  void writeBlock();
+
+  static void writeVarint(QByteArray &data, quint64 value);
+  static void writeString(QByteArray &data, const QByteArray &string);
+};
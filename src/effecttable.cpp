@@ -0,0 +1,160 @@
+#include "effecttable.h"
+
+#include "aoutils.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSettings>
+
+#include <algorithm>
+
+QString EffectDescriptor::property(const QString &key) const
+{
+  return properties.value(key);
+}
+
+EffectTable::EffectTable(const QStringList &fileNames, const QStringList &listFileNames)
+{
+  QStringList file_names = fileNames;
+  for (const QString &file_name : listFileNames)
+  {
+    if (!file_names.contains(file_name))
+    {
+      file_names.append(file_name);
+    }
+  }
+
+  QHash<QString, QStringList> names_by_file;
+  for (const QString &file_name : std::as_const(file_names))
+  {
+    QSettings settings(file_name, QSettings::IniFormat);
+    const bool listed = listFileNames.contains(file_name);
+
+    // port legacy effects
+    if (listed && (!settings.contains("version/major") || settings.value("version/major").toInt() < 2))
+    {
+      if (QFile::copy(file_name, file_name + ".old"))
+      {
+        AOUtils::migrateEffects(settings);
+      }
+      else
+      {
+        qWarning() << "Unable to copy effects.ini, skipping migration.";
+      }
+    }
+
+    const QStringList groups = settings.childGroups();
+    if (fileNames.contains(file_name))
+    {
+      QHash<QString, QHash<QString, QString>> file_effects;
+      for (const QString &group : groups)
+      {
+        const QString name = settings.value(group + "/name").toString();
+        QHash<QString, QString> &properties = file_effects[name.toCaseFolded()];
+
+        settings.beginGroup(group);
+        const QStringList keys = settings.childKeys();
+        for (const QString &key : keys)
+        {
+          // The first group with a non-empty value wins.
+          if (properties.value(key).isEmpty())
+          {
+            properties.insert(key, settings.value(key).toString());
+          }
+        }
+        settings.endGroup();
+      }
+
+      for (auto it = file_effects.constBegin(); it != file_effects.constEnd(); ++it)
+      {
+        EffectDescriptor descriptor;
+        descriptor.name = it->value("name");
+        descriptor.properties = it.value();
+        m_effects.insert(it.key(), descriptor);
+      }
+    }
+
+    if (listed)
+    {
+      QStringList numbered_groups;
+      for (const QString &group : groups)
+      {
+        bool ok = false;
+        group.toInt(&ok);
+        if (ok)
+        {
+          numbered_groups.append(group);
+        }
+      }
+      std::sort(numbered_groups.begin(), numbered_groups.end(), [](const QString &lhs, const QString &rhs) { return lhs.toInt() < rhs.toInt(); });
+
+      QStringList &names = names_by_file[file_name];
+      for (const QString &group : std::as_const(numbered_groups))
+      {
+        const QString name = settings.value(group + "/name").toString();
+        if (!name.isEmpty())
+        {
+          names.append(name);
+        }
+      }
+    }
+  }
+
+  for (const QString &file_name : listFileNames)
+  {
+    m_names.append(names_by_file.value(file_name));
+  }
+
+  for (EffectDescriptor &descriptor : m_effects)
+  {
+    descriptor.stretch = descriptor.property("stretch").startsWith("true");
+    descriptor.scaling = descriptor.property("scaling");
+    descriptor.respect_flip = descriptor.property("respect_flip").startsWith("true");
+    descriptor.loop = descriptor.property("loop").startsWith("true");
+    descriptor.max_duration = descriptor.property("max_duration").toInt();
+    descriptor.cull = descriptor.property("cull").startsWith("true");
+    descriptor.layer = descriptor.property("layer").toLower();
+    descriptor.respect_offset = descriptor.property("respect_offset") == "true";
+    descriptor.sound = descriptor.property("sound");
+    descriptor.sticky = descriptor.property("sticky").startsWith("true");
+  }
+}
+
+const EffectDescriptor *EffectTable::find(const QString &name) const
+{
+  auto it = m_effects.constFind(name.toCaseFolded());
+  return it == m_effects.constEnd() ? nullptr : &*it;
+}
+
+QStringList EffectTable::names() const
+{
+  return m_names;
+}
+
+EffectTableCache &EffectTableCache::getInstance()
+{
+  static EffectTableCache instance;
+  return instance;
+}
+
+std::shared_ptr<const EffectTable> EffectTableCache::find(const QString &key)
+{
+  QMutexLocker locker(&m_lock);
+  return m_tables.value(key);
+}
+
+std::shared_ptr<const EffectTable> EffectTableCache::insert(const QString &key, const QStringList &fileNames, const QStringList &listFileNames)
+{
+  std::shared_ptr<const EffectTable> table = std::make_shared<const EffectTable>(fileNames, listFileNames);
+
+  QMutexLocker locker(&m_lock);
+  m_tables.insert(key, table);
+  return table;
+}
+
+void EffectTableCache::clear()
+{
+  QMutexLocker locker(&m_lock);
+  m_tables.clear();
+}
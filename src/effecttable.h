@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+
+/**
+ * @brief The properties of one effect, as read from effects.ini.
+ */
+class EffectDescriptor
+{
+public:
+  QString name;
+  bool stretch = false;
+  QString scaling;
+  bool respect_flip = false;
+  bool loop = false;
+  int max_duration = 0;
+  bool cull = false;
+  /// Lowercase; "chat", "character", "behind" or "over".
+  QString layer;
+  bool respect_offset = false;
+  QString sound;
+  bool sticky = false;
+
+  /// Every property, including the ones above, as written in the file.
+  QHash<QString, QString> properties;
+
+  QString property(const QString &key) const;
+};
+
+/**
+ * @brief The effects defined by a set of effects.ini files.
+ *
+ * @details Every file is read once. An effect takes its properties from the
+ * last file that defines it, and within a file from the first group with its
+ * name that has a non-empty value, which matches how effect properties used
+ * to be searched. Names are compared case-insensitively.
+ *
+ * The names offered in the effects dropdown come from a separate, shorter
+ * list of files, in group order.
+ */
+class EffectTable
+{
+public:
+  EffectTable() = default;
+  EffectTable(const QStringList &fileNames, const QStringList &listFileNames);
+
+  /// Returns the effect called name, or nullptr.
+  const EffectDescriptor *find(const QString &name) const;
+
+  QStringList names() const;
+
+private:
+  QHash<QString, EffectDescriptor> m_effects;
+  QStringList m_names;
+};
+
+/**
+ * @brief Process-wide cache of effect tables.
+ *
+ * @details Entries are never reloaded on their own; the cache has to be
+ * cleared whenever the theme is reloaded or the mount paths change.
+ */
+class EffectTableCache
+{
+  Q_DISABLE_COPY_MOVE(EffectTableCache)
+
+public:
+  static EffectTableCache &getInstance();
+
+  std::shared_ptr<const EffectTable> find(const QString &key);
+  std::shared_ptr<const EffectTable> insert(const QString &key, const QStringList &fileNames, const QStringList &listFileNames);
+
+  void clear();
+
+private:
+  EffectTableCache() = default;
+
+  QMutex m_lock;
+  QHash<QString, std::shared_ptr<const EffectTable>> m_tables;
+};
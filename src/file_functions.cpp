@@ -75,7 +75,22 @@ QString get_app_path()
   return path;
 }
 
+static QString &base_path_override()
+{
+  static QString path;
+  return path;
+}
+
 QString get_base_path()
 {
+  if (!base_path_override().isEmpty())
+  {
+    return base_path_override();
+  }
   return QDir(get_app_path()).absoluteFilePath("base") + "/";
 }
+
+void set_base_path(const QString &path)
+{
+  base_path_override() = QDir(path).absolutePath() + "/";
+}
@@ -8,3 +8,7 @@ bool exists(QString p_path);
 
 QString get_app_path();
 QString get_base_path();
+
+// Makes get_base_path return path instead, for tools that must not touch the
+// user's configuration. Must be called before Options is first used.
+void set_base_path(const QString &path);
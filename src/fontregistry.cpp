@@ -0,0 +1,166 @@
+#include "fontregistry.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFontDatabase>
+#include <QSaveFile>
+
+FontRegistry::Result FontRegistry::registerFonts(const QStringList &mounts, const QString &cacheFile)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  const QHash<QString, FontFile> previous = loadCache(cacheFile);
+  QHash<QString, FontFile> current;
+  bool changed = false;
+
+  Result result;
+  // The families of every registered file, by hash
+  QHash<QByteArray, QStringList> registered_hashes;
+  for (const QString &mount : mounts)
+  {
+    QDirIterator it(mount + "fonts", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
+    {
+      const QString path = it.next();
+      const QFileInfo info = it.fileInfo();
+
+      FontFile file;
+      file.size = info.size();
+      file.modified = info.lastModified().toMSecsSinceEpoch();
+
+      auto cached = previous.constFind(path);
+      if (cached != previous.constEnd() && cached->size == file.size && cached->modified == file.modified)
+      {
+        file.hash = cached->hash;
+        file.families = cached->families;
+        if (file.families.isEmpty())
+        {
+          ++result.invalid;
+          current.insert(path, file);
+          continue;
+        }
+      }
+      else
+      {
+        changed = true;
+        file.hash = hashFile(path);
+      }
+
+      // Only identical files are duplicates. Files of the same family can
+      // hold different styles, such as bold or italic.
+      if (!file.hash.isEmpty() && registered_hashes.contains(file.hash))
+      {
+        // Not left empty, which would mark the file as not being a font.
+        file.families = registered_hashes.value(file.hash);
+        ++result.duplicates;
+        current.insert(path, file);
+        continue;
+      }
+
+      const int id = QFontDatabase::addApplicationFont(path);
+      if (id == -1)
+      {
+        file.families.clear();
+        ++result.invalid;
+      }
+      else
+      {
+        file.families = QFontDatabase::applicationFontFamilies(id);
+        ++result.registered;
+        if (!file.hash.isEmpty())
+        {
+          registered_hashes.insert(file.hash, file.families);
+        }
+      }
+      current.insert(path, file);
+    }
+  }
+
+  if (changed || current.size() != previous.size())
+  {
+    saveCache(cacheFile, current);
+  }
+
+  result.elapsed_msecs = timer.elapsed();
+  return result;
+}
+
+QByteArray FontRegistry::hashFile(const QString &path)
+{
+  QFile file(path);
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  if (!file.open(QIODevice::ReadOnly) || !hash.addData(&file))
+  {
+    return QByteArray();
+  }
+  return hash.result();
+}
+
+QHash<QString, FontRegistry::FontFile> FontRegistry::loadCache(const QString &cacheFile)
+{
+  QHash<QString, FontFile> files;
+
+  QFile file(cacheFile);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    return files;
+  }
+
+  QDataStream in(&file);
+  quint32 magic = 0;
+  qint32 version = 0;
+  in >> magic >> version;
+  if (magic != CACHE_MAGIC || version != CACHE_VERSION)
+  {
+    qWarning() << "discarding font manifest" << cacheFile << "(unknown format)";
+    return files;
+  }
+
+  qint32 file_count = 0;
+  in >> file_count;
+  files.reserve(file_count);
+  for (int i = 0; i < file_count && in.status() == QDataStream::Ok; ++i)
+  {
+    QString path;
+    FontFile font_file;
+    in >> path >> font_file.size >> font_file.modified >> font_file.hash >> font_file.families;
+    files.insert(path, font_file);
+  }
+
+  if (in.status() != QDataStream::Ok)
+  {
+    qWarning() << "discarding font manifest" << cacheFile << "(file is corrupted)";
+    files.clear();
+  }
+
+  return files;
+}
+
+void FontRegistry::saveCache(const QString &cacheFile, const QHash<QString, FontFile> &files)
+{
+  QSaveFile file(cacheFile);
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    qWarning() << "could not write font manifest" << cacheFile;
+    return;
+  }
+
+  QDataStream out(&file);
+  out << CACHE_MAGIC << CACHE_VERSION << qint32(files.size());
+  for (auto it = files.constBegin(); it != files.constEnd(); ++it)
+  {
+    out << it.key() << it->size << it->modified << it->hash << it->families;
+  }
+
+  if (!file.commit())
+  {
+    qWarning() << "could not write font manifest" << cacheFile;
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief Registers the fonts found in the fonts directory of every mount
+ * path with QFontDatabase.
+ *
+ * @details Every file that was looked at is recorded in a manifest, along
+ * with a hash of its contents and the font families it provides. Files that
+ * are copies of a font that was already registered are skipped, which is
+ * common when several content packs ship the same fonts. On the next start,
+ * unchanged files that turned out not to be fonts are skipped as well, and
+ * the hashes of unchanged files are not computed again.
+ */
+class FontRegistry
+{
+public:
+  static constexpr quint32 CACHE_MAGIC = 0x414f464d; // AOFM
+  static constexpr qint32 CACHE_VERSION = 2;
+
+  class Result
+  {
+  public:
+    int registered = 0;
+    int duplicates = 0;
+    int invalid = 0;
+    qint64 elapsed_msecs = 0;
+  };
+
+  /**
+   * @brief Registers the fonts of mounts, using and updating the manifest in
+   * cacheFile. Safe to call from any thread.
+   *
+   * @param mounts The mount paths, from lowest to highest priority.
+   */
+  static Result registerFonts(const QStringList &mounts, const QString &cacheFile);
+
+private:
+  class FontFile
+  {
+  public:
+    qint64 size = 0;
+    qint64 modified = 0;
+    QByteArray hash;
+    QStringList families;
+  };
+
+  static QByteArray hashFile(const QString &path);
+
+  static QHash<QString, FontFile> loadCache(const QString &cacheFile);
+  static void saveCache(const QString &cacheFile, const QHash<QString, FontFile> &files);
+};
@@ -0,0 +1,233 @@
+#include "iclogmodel.h"
+
+#include <QTextDocumentFragment>
+
+ICLogModel::ICLogModel(QObject *parent)
+    : QAbstractListModel(parent)
+{}
+
+void ICLogModel::setRenderer(Renderer renderer)
+{
+  m_renderer = renderer;
+  invalidate();
+}
+
+bool ICLogModel::newestFirst() const
+{
+  return m_newest_first;
+}
+
+void ICLogModel::setNewestFirst(bool enabled)
+{
+  if (m_newest_first == enabled)
+  {
+    return;
+  }
+
+  beginResetModel();
+  m_newest_first = enabled;
+  endResetModel();
+}
+
+int ICLogModel::limit() const
+{
+  return m_limit;
+}
+
+void ICLogModel::setLimit(int limit)
+{
+  m_limit = qMax(0, limit);
+  while (m_limit > 0 && m_count > m_limit)
+  {
+    removeOldest();
+  }
+}
+
+int ICLogModel::rowCount(const QModelIndex &parent) const
+{
+  return parent.isValid() ? 0 : m_count + m_ghosts.size();
+}
+
+QVariant ICLogModel::data(const QModelIndex &index, int role) const
+{
+  if (!checkIndex(index, CheckIndexOption::IndexIsValid))
+  {
+    return QVariant();
+  }
+
+  const Entry &i_entry = entry(index.row());
+  switch (role)
+  {
+  case Qt::DisplayRole:
+    return QTextDocumentFragment::fromHtml(data(index, HtmlRole).toString()).toPlainText();
+
+  case HtmlRole:
+    if (i_entry.html.isNull())
+    {
+      i_entry.html = m_renderer ? m_renderer(i_entry.piece, i_entry.ghost) : i_entry.piece.message.toHtmlEscaped();
+    }
+    return i_entry.html;
+
+  case IdRole:
+    return i_entry.id;
+
+  case LengthRole:
+    return i_entry.piece.character_name.size() + i_entry.piece.action.size() + i_entry.piece.message.size() + 2;
+
+  case GhostRole:
+    return i_entry.ghost;
+
+  default:
+    return QVariant();
+  }
+}
+
+const ChatLogPiece &ICLogModel::piece(int row) const
+{
+  return entry(row).piece;
+}
+
+int ICLogModel::entryCount() const
+{
+  return m_count;
+}
+
+const ChatLogPiece &ICLogModel::newestPiece() const
+{
+  return m_ring.at((m_first + m_count - 1) % m_ring.size()).piece;
+}
+
+void ICLogModel::append(const ChatLogPiece &piece)
+{
+  while (m_limit > 0 && m_count >= m_limit)
+  {
+    removeOldest();
+  }
+
+  const int row = m_newest_first ? m_ghosts.size() : m_count;
+  beginInsertRows(QModelIndex(), row, row);
+  pushNewest(makeEntry(piece, false));
+  endInsertRows();
+}
+
+void ICLogModel::appendGhost(const ChatLogPiece &piece)
+{
+  const int row = m_newest_first ? 0 : m_count + m_ghosts.size();
+  beginInsertRows(QModelIndex(), row, row);
+  m_ghosts.append(makeEntry(piece, true));
+  endInsertRows();
+}
+
+void ICLogModel::popGhost()
+{
+  if (m_ghosts.isEmpty())
+  {
+    return;
+  }
+
+  const int row = rowAt(m_count, rowCount());
+  beginRemoveRows(QModelIndex(), row, row);
+  m_ghosts.removeFirst();
+  endRemoveRows();
+}
+
+int ICLogModel::ghostCount() const
+{
+  return m_ghosts.size();
+}
+
+void ICLogModel::reset(const QVector<ChatLogPiece> &pieces)
+{
+  beginResetModel();
+  const int count = m_limit > 0 ? qMin<int>(m_limit, pieces.size()) : pieces.size();
+  m_ring.clear();
+  m_ring.reserve(count);
+  for (int i = pieces.size() - count; i < pieces.size(); ++i)
+  {
+    m_ring.append(makeEntry(pieces.at(i), false));
+  }
+  m_first = 0;
+  m_count = count;
+  m_ghosts.clear();
+  endResetModel();
+}
+
+void ICLogModel::clear()
+{
+  reset(QVector<ChatLogPiece>());
+}
+
+void ICLogModel::invalidate()
+{
+  beginResetModel();
+  for (const Entry &i_entry : std::as_const(m_ring))
+  {
+    i_entry.html.clear();
+  }
+  for (const Entry &i_entry : std::as_const(m_ghosts))
+  {
+    i_entry.html.clear();
+  }
+  endResetModel();
+}
+
+const ICLogModel::Entry &ICLogModel::entry(int row) const
+{
+  const int position = rowAt(row, rowCount());
+  if (position < m_count)
+  {
+    return m_ring.at((m_first + position) % m_ring.size());
+  }
+  return m_ghosts.at(position - m_count);
+}
+
+int ICLogModel::rowAt(int position, int total) const
+{
+  // Rows and positions, counted from the oldest entry, map onto each other the same way.
+  return m_newest_first ? total - 1 - position : position;
+}
+
+ICLogModel::Entry ICLogModel::makeEntry(const ChatLogPiece &piece, bool ghost)
+{
+  Entry i_entry;
+  i_entry.piece = piece;
+  i_entry.ghost = ghost;
+  i_entry.id = m_next_id++;
+  return i_entry;
+}
+
+void ICLogModel::removeOldest()
+{
+  const int row = rowAt(0, rowCount());
+  beginRemoveRows(QModelIndex(), row, row);
+  m_ring[m_first] = Entry();
+  m_first = (m_first + 1) % m_ring.size();
+  --m_count;
+  endRemoveRows();
+}
+
+void ICLogModel::pushNewest(const Entry &entry)
+{
+  if (m_count == m_ring.size())
+  {
+    // Grow the ring, unwrapping it so the oldest entry comes first again.
+    int capacity = qMax(16, m_ring.size() * 2);
+    if (m_limit > 0)
+    {
+      capacity = qMin(capacity, qMax(m_limit, m_count + 1));
+    }
+
+    QVector<Entry> ring;
+    ring.reserve(capacity);
+    for (int i = 0; i < m_count; ++i)
+    {
+      ring.append(m_ring.at((m_first + i) % m_ring.size()));
+    }
+    ring.resize(capacity);
+    m_ring = ring;
+    m_first = 0;
+  }
+
+  m_ring[(m_first + m_count) % m_ring.size()] = entry;
+  ++m_count;
+}
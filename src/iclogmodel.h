@@ -0,0 +1,100 @@
+#pragma once
+
+#include "chatlogpiece.h"
+
+#include <QAbstractListModel>
+#include <QList>
+#include <QVector>
+
+#include <functional>
+
+/**
+ * @brief The entries of the IC chat log, oldest first unless newest first is
+ * set.
+ *
+ * @details Entries are kept in a ring buffer, so dropping the oldest entry
+ * once the log is full doesn't move the others. Ghosts, messages we sent that
+ * weren't displayed yet, always come after the other entries and don't count
+ * towards the limit. The rich text of an entry is only rendered once it is
+ * needed, and rendered again after invalidate().
+ */
+class ICLogModel : public QAbstractListModel
+{
+  Q_OBJECT
+
+public:
+  enum Role
+  {
+    HtmlRole = Qt::UserRole + 1,
+    /// Identifies an entry for as long as it is in the log.
+    IdRole,
+    /// Rough amount of characters in the entry, known without rendering it.
+    LengthRole,
+    GhostRole,
+  };
+
+  using Renderer = std::function<QString(const ChatLogPiece &piece, bool ghost)>;
+
+  explicit ICLogModel(QObject *parent = nullptr);
+
+  void setRenderer(Renderer renderer);
+
+  bool newestFirst() const;
+  void setNewestFirst(bool enabled);
+
+  /// Maximum amount of entries, not counting ghosts, or 0 for no limit.
+  int limit() const;
+  void setLimit(int limit);
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+  /// Returns the entry at row, ghosts included.
+  const ChatLogPiece &piece(int row) const;
+
+  /// Amount of entries, not counting ghosts.
+  int entryCount() const;
+
+  /// Returns the newest entry that is not a ghost. There must be one.
+  const ChatLogPiece &newestPiece() const;
+
+  void append(const ChatLogPiece &piece);
+  void appendGhost(const ChatLogPiece &piece);
+
+  /// Removes the oldest ghost.
+  void popGhost();
+  int ghostCount() const;
+
+  /// Replaces every entry and drops the ghosts.
+  void reset(const QVector<ChatLogPiece> &pieces);
+  void clear();
+
+  /// Renders every entry again, e.g. after the log options changed.
+  void invalidate();
+
+private:
+  class Entry
+  {
+  public:
+    ChatLogPiece piece;
+    bool ghost = false;
+    quint64 id = 0;
+    mutable QString html;
+  };
+
+  Renderer m_renderer;
+  bool m_newest_first = false;
+  int m_limit = 0;
+
+  QVector<Entry> m_ring;
+  int m_first = 0;
+  int m_count = 0;
+  QList<Entry> m_ghosts;
+  quint64 m_next_id = 0;
+
+  const Entry &entry(int row) const;
+  int rowAt(int position, int total) const;
+  Entry makeEntry(const ChatLogPiece &piece, bool ghost);
+  void removeOldest();
+  void pushNewest(const Entry &entry);
+};
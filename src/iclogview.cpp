@@ -0,0 +1,263 @@
+#include "iclogview.h"
+
+#include "iclogmodel.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QClipboard>
+#include <QGuiApplication>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QtMath>
+
+#include <algorithm>
+
+ICLogDelegate::ICLogDelegate(QAbstractItemView *view)
+    : QStyledItemDelegate(view)
+    , m_view(view)
+    , m_documents(DOCUMENT_CACHE_SIZE)
+{}
+
+int ICLogDelegate::margin() const
+{
+  return m_margin;
+}
+
+void ICLogDelegate::setMargin(int margin)
+{
+  m_margin = qMax(0, margin);
+}
+
+void ICLogDelegate::clearCache()
+{
+  m_documents.clear();
+  m_heights.clear();
+}
+
+void ICLogDelegate::forget(quint64 id)
+{
+  m_documents.remove(id);
+  for (QHash<quint64, int> &heights : m_heights)
+  {
+    heights.remove(id);
+  }
+}
+
+void ICLogDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+  checkGeometry(option);
+
+  // Not using initStyleOption, which would fetch the plain text of the entry
+  // only for it to be painted over.
+  m_view->style()->drawPrimitive(QStyle::PE_PanelItemViewItem, &option, painter, m_view);
+
+  QTextDocument *document = this->document(index, option);
+
+  QAbstractTextDocumentLayout::PaintContext context;
+  context.palette = option.palette;
+  if (option.state & QStyle::State_Selected)
+  {
+    const QPalette::ColorGroup group = option.state & QStyle::State_Active ? QPalette::Active : QPalette::Inactive;
+    context.palette.setColor(QPalette::Text, option.palette.color(group, QPalette::HighlightedText));
+  }
+  context.clip = QRectF(0, 0, option.rect.width(), option.rect.height() - m_margin);
+
+  painter->save();
+  painter->translate(option.rect.left(), option.rect.top() + m_margin);
+  painter->setClipRect(context.clip);
+  document->documentLayout()->draw(painter, context);
+  painter->restore();
+
+  const quint64 id = index.data(ICLogModel::IdRole).toULongLong();
+  const int height = qCeil(document->size().height());
+  int &known_height = m_heights[m_width][id];
+  if (known_height != height)
+  {
+    known_height = height;
+    // Laying the view out again for every row would be quadratic, so the rows
+    // painted in this pass are reported together.
+    if (!m_heights_changed)
+    {
+      m_heights_changed = true;
+      QMetaObject::invokeMethod(
+          const_cast<ICLogDelegate *>(this),
+          [this] {
+            m_heights_changed = false;
+            Q_EMIT const_cast<ICLogDelegate *>(this)->heightsChanged();
+          },
+          Qt::QueuedConnection);
+    }
+  }
+}
+
+QSize ICLogDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+  checkGeometry(option);
+
+  int height = m_heights.value(m_width).value(index.data(ICLogModel::IdRole).toULongLong(), 0);
+  if (height == 0)
+  {
+    // Estimated, so that rows that are never shown are never laid out.
+    const int line_length = qMax(1, m_width / m_average_char_width);
+    height = (1 + index.data(ICLogModel::LengthRole).toInt() / line_length) * m_line_spacing;
+  }
+
+  return QSize(m_width, height + m_margin);
+}
+
+void ICLogDelegate::checkGeometry(const QStyleOptionViewItem &option) const
+{
+  const int width = m_view->viewport()->width();
+  if (option.font != m_font)
+  {
+    m_documents.clear();
+    m_heights.clear();
+    m_font = option.font;
+    const QFontMetrics metrics(m_font);
+    m_average_char_width = qMax(1, metrics.averageCharWidth());
+    m_line_spacing = metrics.lineSpacing();
+  }
+  if (width != m_width)
+  {
+    m_documents.clear();
+    m_width = width;
+    if (!m_heights.contains(m_width) && m_heights.size() >= HEIGHT_CACHE_WIDTHS)
+    {
+      m_heights.clear();
+    }
+  }
+}
+
+QTextDocument *ICLogDelegate::document(const QModelIndex &index, const QStyleOptionViewItem &option) const
+{
+  const quint64 id = index.data(ICLogModel::IdRole).toULongLong();
+  QTextDocument *document = m_documents.object(id);
+  if (!document)
+  {
+    document = new QTextDocument;
+    document->setDocumentMargin(0);
+    document->setDefaultFont(option.font);
+    document->setHtml(index.data(ICLogModel::HtmlRole).toString());
+    document->setTextWidth(m_width);
+    m_documents.insert(id, document);
+  }
+  return document;
+}
+
+ICLogView::ICLogView(QWidget *parent)
+    : QListView(parent)
+    , m_delegate(new ICLogDelegate(this))
+{
+  setItemDelegate(m_delegate);
+  connect(m_delegate, &ICLogDelegate::heightsChanged, this, &ICLogView::scheduleDelayedItemsLayout);
+  setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+  setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+  setResizeMode(QListView::Adjust);
+  setSelectionMode(QAbstractItemView::ExtendedSelection);
+  setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+  connect(verticalScrollBar(), &QScrollBar::valueChanged, this, [this](int value) { m_follow = isAtNewest(value); });
+  connect(verticalScrollBar(), &QScrollBar::rangeChanged, this, [this] {
+    if (m_follow)
+    {
+      scrollToNewest();
+    }
+  });
+}
+
+ICLogDelegate *ICLogView::logDelegate() const
+{
+  return m_delegate;
+}
+
+QString ICLogView::placeholderText() const
+{
+  return m_placeholder_text;
+}
+
+void ICLogView::setPlaceholderText(const QString &text)
+{
+  m_placeholder_text = text;
+  viewport()->update();
+}
+
+bool ICLogView::newestFirst() const
+{
+  return m_newest_first;
+}
+
+void ICLogView::setNewestFirst(bool enabled)
+{
+  m_newest_first = enabled;
+  m_follow = true;
+  scrollToNewest();
+}
+
+void ICLogView::reset()
+{
+  m_delegate->clearCache();
+  QListView::reset();
+  m_follow = true;
+  scrollToNewest();
+}
+
+void ICLogView::keyPressEvent(QKeyEvent *event)
+{
+  if (event->matches(QKeySequence::Copy))
+  {
+    copySelection();
+    event->accept();
+    return;
+  }
+  QListView::keyPressEvent(event);
+}
+
+void ICLogView::paintEvent(QPaintEvent *event)
+{
+  QListView::paintEvent(event);
+
+  if (m_placeholder_text.isEmpty() || (model() && model()->rowCount() > 0))
+  {
+    return;
+  }
+
+  QPainter painter(viewport());
+  painter.setPen(palette().color(QPalette::PlaceholderText));
+  painter.drawText(viewport()->rect(), Qt::AlignLeft | Qt::AlignTop | Qt::TextWordWrap, m_placeholder_text);
+}
+
+void ICLogView::rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end)
+{
+  for (int i = start; i <= end; ++i)
+  {
+    m_delegate->forget(model()->index(i, 0, parent).data(ICLogModel::IdRole).toULongLong());
+  }
+  QListView::rowsAboutToBeRemoved(parent, start, end);
+}
+
+bool ICLogView::isAtNewest(int value) const
+{
+  return value == (m_newest_first ? verticalScrollBar()->minimum() : verticalScrollBar()->maximum());
+}
+
+void ICLogView::scrollToNewest()
+{
+  verticalScrollBar()->setValue(m_newest_first ? verticalScrollBar()->minimum() : verticalScrollBar()->maximum());
+}
+
+void ICLogView::copySelection()
+{
+  QModelIndexList indexes = selectionModel() ? selectionModel()->selectedIndexes() : QModelIndexList();
+  if (indexes.isEmpty())
+  {
+    return;
+  }
+
+  std::sort(indexes.begin(), indexes.end(), [](const QModelIndex &a, const QModelIndex &b) { return a.row() < b.row(); });
+  QStringList lines;
+  for (const QModelIndex &index : std::as_const(indexes))
+  {
+    lines.append(index.data(Qt::DisplayRole).toString());
+  }
+  QGuiApplication::clipboard()->setText(lines.join('\n'));
+}
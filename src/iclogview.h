@@ -0,0 +1,101 @@
+#pragma once
+
+#include <QAbstractItemView>
+#include <QCache>
+#include <QFont>
+#include <QHash>
+#include <QListView>
+#include <QStyledItemDelegate>
+#include <QTextDocument>
+
+/**
+ * @brief Paints the rich text of ICLogModel entries.
+ *
+ * @details Rows are only laid out once they are painted; until then their
+ * height is estimated from their length. The layouts of recently painted rows
+ * are kept, and their heights, for the last few widths of the view, for as
+ * long as the entry is in the log. Heights that turn out to differ from the
+ * estimate are reported together by heightsChanged() once painting is done.
+ */
+class ICLogDelegate : public QStyledItemDelegate
+{
+  Q_OBJECT
+
+public:
+  static constexpr int DOCUMENT_CACHE_SIZE = 256;
+  static constexpr int HEIGHT_CACHE_WIDTHS = 4;
+
+  explicit ICLogDelegate(QAbstractItemView *view);
+
+  /// Space above every row, in pixels.
+  int margin() const;
+  void setMargin(int margin);
+
+  void clearCache();
+
+  /// Drops what is known about the entry with this id.
+  void forget(quint64 id);
+
+  void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+  QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+Q_SIGNALS:
+  void heightsChanged();
+
+private:
+  QAbstractItemView *m_view;
+  int m_margin = 0;
+
+  mutable QCache<quint64, QTextDocument> m_documents;
+  /// Heights of the laid out rows by id, for each width they were laid out at.
+  mutable QHash<int, QHash<quint64, int>> m_heights;
+  mutable int m_width = -1;
+  mutable QFont m_font;
+  mutable int m_average_char_width = 1;
+  mutable int m_line_spacing = 0;
+  mutable bool m_heights_changed = false;
+
+  void checkGeometry(const QStyleOptionViewItem &option) const;
+  QTextDocument *document(const QModelIndex &index, const QStyleOptionViewItem &option) const;
+};
+
+/**
+ * @brief Shows the IC chat log.
+ *
+ * @details Stays at the newest entry, the bottom or the top depending on
+ * newestFirst(), unless the user scrolled away from it.
+ */
+class ICLogView : public QListView
+{
+  Q_OBJECT
+
+public:
+  explicit ICLogView(QWidget *parent = nullptr);
+
+  ICLogDelegate *logDelegate() const;
+
+  QString placeholderText() const;
+  void setPlaceholderText(const QString &text);
+
+  bool newestFirst() const;
+  void setNewestFirst(bool enabled);
+
+  void reset() override;
+
+protected:
+  void keyPressEvent(QKeyEvent *event) override;
+  void paintEvent(QPaintEvent *event) override;
+
+protected Q_SLOTS:
+  void rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end) override;
+
+private:
+  ICLogDelegate *m_delegate;
+  QString m_placeholder_text;
+  bool m_newest_first = false;
+  bool m_follow = true;
+
+  bool isAtNewest(int value) const;
+  void scrollToNewest();
+  void copySelection();
+};
@@ -0,0 +1,294 @@
+#include "icmessage.h"
+
+#include <QTextBlock>
+#include <QTextBoundaryFinder>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include <stack>
+
+ICMessage::ICMessage(QString message, int defaultColor, const QStringList &markdownStart, const QStringList &markdownEnd, const QVector<bool> &markdownRemove, const QVector<bool> &markdownTalking)
+{
+  const QString trimmed = message.trimmed();
+  if (trimmed.startsWith("~~"))
+  {
+    message.remove(message.indexOf("~~"), 2);
+    m_alignment = Qt::AlignHCenter;
+  }
+  else if (trimmed.startsWith("~>"))
+  {
+    message.remove(message.indexOf("~>"), 2);
+    m_alignment = Qt::AlignRight;
+  }
+  else if (trimmed.startsWith("<>"))
+  {
+    message.remove(message.indexOf("<>"), 2);
+    m_alignment = Qt::AlignJustify;
+  }
+
+  std::stack<int> color_stack;
+  color_stack.push(defaultColor);
+  bool escape_sequence = false;
+  int speed = DEFAULT_SPEED;
+
+  QTextBoundaryFinder finder(QTextBoundaryFinder::Grapheme, message);
+  int begin = 0;
+  for (int end = finder.toNextBoundary(); end != -1; end = finder.toNextBoundary())
+  {
+    Grapheme grapheme;
+    grapheme.text = message.mid(begin, end - begin);
+    begin = end;
+
+    const QString &character = grapheme.text;
+    const int previous_color = color_stack.empty() ? -1 : color_stack.top();
+    bool color_end = false;
+    bool skip = false;
+
+    if (!escape_sequence)
+    {
+      if (character == "\\")
+      {
+        escape_sequence = true;
+        skip = true;
+      }
+      else if (character == "{")
+      {
+        speed = qMin(speed + 1, MAXIMUM_SPEED);
+        skip = true;
+      }
+      else if (character == "}")
+      {
+        speed = qMax(speed - 1, 0);
+        skip = true;
+      }
+      else
+      {
+        for (int c = 0; c < markdownStart.size(); ++c)
+        {
+          const QString &markdown_start = markdownStart.at(c);
+          const QString &markdown_end = markdownEnd.value(c);
+          if (markdown_start.isEmpty())
+          {
+            continue;
+          }
+
+          if (markdown_end.isEmpty() || markdown_end == markdown_start)
+          {
+            // "toggle switch" type
+            if (character != markdown_start)
+            {
+              continue;
+            }
+
+            if (!color_stack.empty() && color_stack.top() == c && defaultColor != c)
+            {
+              color_stack.pop();
+              color_end = true;
+            }
+            else
+            {
+              color_stack.push(c);
+            }
+          }
+          else if (character == markdown_start)
+          {
+            color_stack.push(c);
+          }
+          else if (character == markdown_end && !color_stack.empty() && color_stack.top() == c)
+          {
+            color_stack.pop();
+            color_end = true;
+          }
+          else
+          {
+            continue;
+          }
+
+          skip = markdownRemove.value(c);
+          break;
+        }
+      }
+    }
+    else
+    {
+      if (character == "n")
+      {
+        grapheme.effect = Newline;
+      }
+      else if (character == "s")
+      {
+        grapheme.effect = Screenshake;
+      }
+      else if (character == "f")
+      {
+        grapheme.effect = Flash;
+      }
+      else if (character == "p")
+      {
+        grapheme.effect = Pause;
+      }
+      skip = grapheme.effect != NoEffect;
+      escape_sequence = false;
+    }
+
+    // A closing markdown character is still shown in the color it closes.
+    grapheme.color = color_end ? previous_color : (color_stack.empty() ? -1 : color_stack.top());
+    grapheme.speed = speed;
+    grapheme.formatting = skip;
+    if (!color_stack.empty() && !color_end)
+    {
+      grapheme.talking_update = true;
+      grapheme.talking = markdownTalking.value(color_stack.top(), true);
+    }
+
+    grapheme.position = m_text.size();
+    if (grapheme.effect == Newline)
+    {
+      m_text.append(QChar::LineSeparator);
+    }
+    else if (!skip)
+    {
+      // Runs of whitespace would otherwise be free to wrap anywhere.
+      if (character.size() == 1 && character.at(0).isSpace() && !m_text.isEmpty() && m_text.back().isSpace() && m_text.back() != QChar::LineSeparator)
+      {
+        m_text.append(QChar::Nbsp);
+      }
+      else
+      {
+        m_text.append(character);
+      }
+    }
+    grapheme.length = m_text.size() - grapheme.position;
+
+    m_graphemes.append(grapheme);
+  }
+}
+
+int ICMessage::size() const
+{
+  return m_graphemes.size();
+}
+
+bool ICMessage::isEmpty() const
+{
+  return m_graphemes.isEmpty();
+}
+
+Qt::Alignment ICMessage::alignment() const
+{
+  return m_alignment;
+}
+
+QString ICMessage::text() const
+{
+  return m_text;
+}
+
+const QVector<ICMessage::Grapheme> &ICMessage::graphemes() const
+{
+  return m_graphemes;
+}
+
+ICMessageRenderer::ICMessageRenderer(QTextEdit *widget)
+    : m_widget(widget)
+{
+  // Every reveal would otherwise be recorded on the undo stack.
+  m_widget->setUndoRedoEnabled(false);
+}
+
+const ICMessage &ICMessageRenderer::message() const
+{
+  return m_message;
+}
+
+void ICMessageRenderer::clear()
+{
+  m_widget->clear();
+  m_message = ICMessage();
+  m_committed = 0;
+  m_start = 0;
+  m_revealed = 0;
+}
+
+void ICMessageRenderer::start(const ICMessage &message, const QVector<QColor> &colors)
+{
+  m_message = message;
+  m_colors = colors;
+  m_revealed = 0;
+
+  QTextCursor cursor(m_widget->document());
+  cursor.setPosition(qMin(m_committed, m_widget->document()->characterCount() - 1));
+  cursor.movePosition(QTextCursor::End, QTextCursor::KeepAnchor);
+  cursor.removeSelectedText();
+
+  // Aligned messages get a paragraph of their own, as does whatever follows them.
+  QTextBlockFormat block_format = cursor.blockFormat();
+  if (m_message.alignment() || block_format.alignment() != Qt::AlignLeft)
+  {
+    if (!cursor.atStart())
+    {
+      cursor.insertBlock();
+    }
+    block_format.setAlignment(m_message.alignment() ? m_message.alignment() : Qt::AlignLeft);
+    cursor.setBlockFormat(block_format);
+  }
+
+  QTextCharFormat hidden_format;
+  hidden_format.setForeground(Qt::transparent);
+  m_start = cursor.position();
+  cursor.insertText(m_message.text(), hidden_format);
+}
+
+void ICMessageRenderer::reveal(int index)
+{
+  const QVector<ICMessage::Grapheme> &graphemes = m_message.graphemes();
+  index = qMin(index, graphemes.size());
+
+  QTextCursor cursor(m_widget->document());
+  while (m_revealed < index)
+  {
+    // Recolor runs of the same color at once.
+    const int color = graphemes.at(m_revealed).color;
+    const int from = m_start + graphemes.at(m_revealed).position;
+    int end = m_revealed + 1;
+    while (end < index && graphemes.at(end).color == color)
+    {
+      ++end;
+    }
+    const ICMessage::Grapheme &last = graphemes.at(end - 1);
+    const int to = m_start + last.position + last.length;
+    m_revealed = end;
+
+    if (to > from)
+    {
+      cursor.setPosition(from);
+      cursor.setPosition(to, QTextCursor::KeepAnchor);
+      cursor.setCharFormat(colorFormat(color));
+    }
+  }
+}
+
+void ICMessageRenderer::finish()
+{
+  reveal(m_message.size());
+  m_committed = m_start + m_message.text().size();
+}
+
+int ICMessageRenderer::revealedPosition() const
+{
+  if (m_revealed < m_message.size())
+  {
+    return m_start + m_message.graphemes().at(m_revealed).position;
+  }
+  return m_start + m_message.text().size();
+}
+
+QTextCharFormat ICMessageRenderer::colorFormat(int color) const
+{
+  QTextCharFormat format;
+  if (color >= 0 && color < m_colors.size())
+  {
+    format.setForeground(m_colors.at(color));
+  }
+  return format;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <QColor>
+#include <QString>
+#include <QStringList>
+#include <QTextCharFormat>
+#include <QTextEdit>
+#include <QVector>
+
+/**
+ * @brief An IC message parsed into graphemes and their display attributes.
+ *
+ * @details Markup (alignment, colors, text speed and escape sequences) is
+ * resolved once when the message is created, so the text crawl only has to
+ * look up the grapheme it is revealing.
+ */
+class ICMessage
+{
+public:
+  enum Effect
+  {
+    NoEffect,
+    Newline,
+    Screenshake,
+    Flash,
+    Pause,
+  };
+
+  class Grapheme
+  {
+  public:
+    /// The grapheme as it was typed.
+    QString text;
+    /// Offset and length of the grapheme in the display text.
+    int position = 0;
+    int length = 0;
+    /// Color index, or -1 to use the widget's own color.
+    int color = -1;
+    /// Text speed once this grapheme has been reached.
+    int speed = 3;
+    Effect effect = NoEffect;
+    /// Markup that is not shown and doesn't blip.
+    bool formatting = false;
+    /// Whether the color of this grapheme decides the talking animation.
+    bool talking_update = false;
+    bool talking = true;
+  };
+
+  static constexpr int DEFAULT_SPEED = 3;
+  static constexpr int MAXIMUM_SPEED = 6;
+
+  ICMessage() = default;
+  ICMessage(QString message, int defaultColor, const QStringList &markdownStart, const QStringList &markdownEnd, const QVector<bool> &markdownRemove, const QVector<bool> &markdownTalking);
+
+  int size() const;
+  bool isEmpty() const;
+
+  /// Alignment requested by the message, or 0 if it didn't request any.
+  Qt::Alignment alignment() const;
+
+  /// The text as it is displayed, with all markup removed.
+  QString text() const;
+
+  const QVector<Grapheme> &graphemes() const;
+
+private:
+  Qt::Alignment m_alignment;
+  QString m_text;
+  QVector<Grapheme> m_graphemes;
+};
+
+/**
+ * @brief Crawls IC messages into a text widget.
+ *
+ * @details A message is inserted with every grapheme hidden, which keeps the
+ * line wrapping stable while the text is revealed. Revealing only recolors the
+ * graphemes that became visible since the last call.
+ */
+class ICMessageRenderer
+{
+public:
+  explicit ICMessageRenderer(QTextEdit *widget);
+
+  const ICMessage &message() const;
+
+  /// Removes every message from the widget.
+  void clear();
+
+  /**
+   * @brief Inserts message after the last finished message, hidden.
+   *
+   * @details Text of a message that did not finish is discarded first, so
+   * additive messages only build on finished ones.
+   */
+  void start(const ICMessage &message, const QVector<QColor> &colors);
+
+  /// Reveals every grapheme before index.
+  void reveal(int index);
+
+  /// Reveals the rest of the message and keeps it for additive messages.
+  void finish();
+
+  /// Document position right after the revealed text.
+  int revealedPosition() const;
+
+private:
+  QTextEdit *m_widget;
+  ICMessage m_message;
+  QVector<QColor> m_colors;
+  int m_committed = 0;
+  int m_start = 0;
+  int m_revealed = 0;
+
+  QTextCharFormat colorFormat(int color) const;
+};
@@ -0,0 +1,220 @@
+#include "logwriter.h"
+
+#include "tracer.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+LogWriter::LogWriter(QObject *parent)
+    : QThread(parent)
+{
+  setObjectName("LogWriter");
+}
+
+LogWriter::~LogWriter()
+{
+  stop();
+}
+
+bool LogWriter::append(const QString &fileName, const QString &text)
+{
+  Request request;
+  request.file_name = fileName;
+  request.text = text;
+  return enqueue(request);
+}
+
+bool LogWriter::write(const QString &fileName, const QString &text)
+{
+  Request request;
+  request.file_name = fileName;
+  request.text = text;
+  request.truncate = true;
+  return enqueue(request);
+}
+
+void LogWriter::stop()
+{
+  {
+    QMutexLocker locker(&m_lock);
+    m_exit = true;
+    m_request_signal.wakeOne();
+  }
+  wait();
+}
+
+int LogWriter::queueCapacity()
+{
+  QMutexLocker locker(&m_lock);
+  return m_queue_capacity;
+}
+
+void LogWriter::setQueueCapacity(int capacity)
+{
+  QMutexLocker locker(&m_lock);
+  m_queue_capacity = capacity;
+}
+
+int LogWriter::queueDepth()
+{
+  QMutexLocker locker(&m_lock);
+  return m_queue.size();
+}
+
+quint64 LogWriter::droppedCount() const
+{
+  return m_dropped_count;
+}
+
+bool LogWriter::enqueue(const Request &request)
+{
+  {
+    QMutexLocker locker(&m_lock);
+    if (m_exit)
+    {
+      return false;
+    }
+
+    if (m_queue.size() < m_queue_capacity)
+    {
+      m_queue.enqueue(request);
+      m_request_signal.wakeOne();
+      if (!isRunning())
+      {
+        start(QThread::LowPriority);
+      }
+      return true;
+    }
+  }
+
+  quint64 dropped_count = ++m_dropped_count;
+  if ((dropped_count & (dropped_count - 1)) == 0)
+  {
+    qWarning() << "log writer queue is full, dropped" << dropped_count << "writes so far";
+  }
+  return false;
+}
+
+void LogWriter::run()
+{
+  m_flush_timer.start();
+
+  QMutexLocker locker(&m_lock);
+  while (true)
+  {
+    if (m_queue.isEmpty() && !m_exit)
+    {
+      m_request_signal.wait(&m_lock, static_cast<unsigned long>(qMax<qint64>(0, FLUSH_INTERVAL - m_flush_timer.elapsed())));
+    }
+
+    QQueue<Request> batch;
+    batch.swap(m_queue);
+    const bool exit_requested = m_exit;
+    locker.unlock();
+
+    for (const Request &request : std::as_const(batch))
+    {
+      process(request);
+    }
+
+    if (exit_requested)
+    {
+      closeFiles();
+      break;
+    }
+
+    if (m_flush_timer.hasExpired(FLUSH_INTERVAL))
+    {
+      flushFiles();
+    }
+    locker.relock();
+  }
+}
+
+void LogWriter::process(const Request &request)
+{
+  AO_TRACE_SCOPE_ARG("LogWriter::process", request.file_name);
+  OpenFile *open_file = openFile(request.file_name, request.truncate);
+  if (!open_file)
+  {
+    return;
+  }
+
+  QFile *file = open_file->file;
+  // Only writes that start a file translate newlines; appends are written
+  // as is, separated by CRLF.
+  file->setTextModeEnabled(request.truncate || open_file->empty);
+  if (!open_file->empty && file->write("\r\n") == -1)
+  {
+    qWarning() << "could not write to" << request.file_name << file->errorString();
+    return;
+  }
+  if (file->write(request.text.toUtf8()) == -1)
+  {
+    qWarning() << "could not write to" << request.file_name << file->errorString();
+    return;
+  }
+  open_file->empty = false;
+}
+
+LogWriter::OpenFile *LogWriter::openFile(const QString &fileName, bool truncate)
+{
+  auto it = m_files.find(fileName);
+  if (it != m_files.end() && !truncate)
+  {
+    return &*it;
+  }
+
+  if (it != m_files.end())
+  {
+    delete it->file;
+    m_files.erase(it);
+  }
+  else if (m_files.size() >= MAXIMUM_OPEN_FILES)
+  {
+    closeFiles();
+  }
+
+  QDir dir(QFileInfo(fileName).path());
+  if (!dir.exists() && !dir.mkpath("."))
+  {
+    qWarning() << "could not create directory for" << fileName;
+    return nullptr;
+  }
+
+  QFile *file = new QFile(fileName);
+  const QIODevice::OpenMode mode = QIODevice::WriteOnly | (truncate ? QIODevice::Truncate : QIODevice::Append);
+  if (!file->open(mode))
+  {
+    qWarning() << "could not open" << fileName << file->errorString();
+    delete file;
+    return nullptr;
+  }
+
+  OpenFile open_file;
+  open_file.file = file;
+  open_file.empty = file->size() == 0;
+  return &*m_files.insert(fileName, open_file);
+}
+
+void LogWriter::flushFiles()
+{
+  for (const OpenFile &open_file : std::as_const(m_files))
+  {
+    open_file.file->flush();
+  }
+  m_flush_timer.restart();
+}
+
+void LogWriter::closeFiles()
+{
+  for (const OpenFile &open_file : std::as_const(m_files))
+  {
+    open_file.file->close();
+    delete open_file.file;
+  }
+  m_files.clear();
+  m_flush_timer.restart();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+
+/**
+ * @brief Writes log and demo files on a dedicated thread.
+ *
+ * @details Requests are queued and written in batches by the writer thread,
+ * which keeps the files open between writes. Written data is flushed to disk
+ * periodically and when the writer is stopped. If the queue is full, new
+ * requests are dropped rather than blocking the caller.
+ */
+class LogWriter : public QThread
+{
+  Q_OBJECT
+
+public:
+  static constexpr int DEFAULT_QUEUE_CAPACITY = 4096;
+  static constexpr int FLUSH_INTERVAL = 1000;
+  static constexpr int MAXIMUM_OPEN_FILES = 8;
+
+  explicit LogWriter(QObject *parent = nullptr);
+  ~LogWriter();
+
+  /**
+   * @brief Appends text to fileName on its own line, creating the file and
+   * its directory if they don't exist.
+   *
+   * @return False if the request was dropped.
+   */
+  bool append(const QString &fileName, const QString &text);
+
+  /**
+   * @brief Replaces the contents of fileName with text, creating the file
+   * and its directory if they don't exist.
+   *
+   * @return False if the request was dropped.
+   */
+  bool write(const QString &fileName, const QString &text);
+
+  /// Writes every queued request, closes all files and ends the thread.
+  void stop();
+
+  int queueCapacity();
+  void setQueueCapacity(int capacity);
+
+  int queueDepth();
+  quint64 droppedCount() const;
+
+protected:
+  void run() override;
+
+private:
+  class Request
+  {
+  public:
+    QString file_name;
+    QString text;
+    bool truncate = false;
+  };
+
+  class OpenFile
+  {
+  public:
+    QFile *file = nullptr;
+    bool empty = true;
+  };
+
+  QMutex m_lock;
+  QWaitCondition m_request_signal;
+  QQueue<Request> m_queue;
+  int m_queue_capacity = DEFAULT_QUEUE_CAPACITY;
+  bool m_exit = false;
+  std::atomic<quint64> m_dropped_count = 0;
+
+  QHash<QString, OpenFile> m_files;
+  QElapsedTimer m_flush_timer;
+
+  bool enqueue(const Request &request);
+  void process(const Request &request);
+  OpenFile *openFile(const QString &fileName, bool truncate);
+  void flushFiles();
+  void closeFiles();
+};
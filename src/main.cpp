@@ -2,11 +2,10 @@
 #include "aoapplication.h"
 
 #include "courtroom.h"
-#include "file_functions.h"
 #include "lobby.h"
 
 #include <QDebug>
-#include <QDirIterator>
+#include <QElapsedTimer>
 #include <QImageReader>
 #include <QLibraryInfo>
 #include <QResource>
@@ -27,11 +26,30 @@ int main(int argc, char *argv[])
   }
 #endif
 
+  // Reports how long each step takes until the lobby shows up
+  QElapsedTimer startup_timer;
+  startup_timer.start();
+  qint64 last_stage = 0;
+  auto finish_stage = [&startup_timer, &last_stage](const char *stage) {
+    const qint64 now = startup_timer.elapsed();
+    qInfo().noquote() << QString("startup: %1 took %2 ms").arg(stage).arg(now - last_stage);
+    last_stage = now;
+  };
+
   AOApplication main_app;
+  // Indexing assets, registering fonts and fetching the server list all
+  // happen in the background while the lobby is being built.
+  main_app.refresh_asset_index();
+  main_app.register_fonts();
+  main_app.net_manager->get_server_list();
+  main_app.net_manager->send_heartbeat();
   QApplication::setApplicationVersion(AOApplication::get_version_string());
   QApplication::setApplicationDisplayName(QObject::tr("Attorney Online %1").arg(QApplication::applicationVersion()));
+  finish_stage("initialization");
 
+  // The lobby is built from the theme, so it has to be registered first.
   QResource::registerResource(main_app.get_asset("themes/" + Options::getInstance().theme() + ".rcc"));
+  finish_stage("theme resources");
 
   QFont main_font = QApplication::font();
   main_app.default_font = main_font;
@@ -41,19 +59,6 @@ int main(int argc, char *argv[])
   new_font.setPointSize(new_font_size);
   QApplication::setFont(new_font);
 
-  QStringList font_paths;
-  font_paths.append(get_base_path());
-  font_paths.append(Options::getInstance().mountPaths());
-
-  for (const QString &path : font_paths)
-  {
-    QDirIterator it(path + "fonts", QDirIterator::Subdirectories);
-    while (it.hasNext())
-    {
-      QFontDatabase::addApplicationFont(it.next());
-    }
-  }
-
   QStringList expected_formats{"webp", "apng", "gif"};
   for (const QByteArray &i_format : QImageReader::supportedImageFormats())
   {
@@ -67,6 +72,7 @@ int main(int argc, char *argv[])
   {
     call_error("Missing image formats: <b>" + expected_formats.join(", ") + "</b>.<br /><br /> Please make sure you have installed the application properly.");
   }
+  finish_stage("image formats");
 
   QString p_language = Options::getInstance().language();
   if (p_language.trimmed().isEmpty())
@@ -94,11 +100,12 @@ int main(int argc, char *argv[])
     QApplication::installTranslator(&appTranslator);
     qDebug() << ":/data/translations/ao_" + p_language;
   }
+  finish_stage("translations");
 
   main_app.construct_lobby();
-  main_app.net_manager->get_server_list();
-  main_app.net_manager->send_heartbeat();
   main_app.w_lobby->show();
+  finish_stage("lobby");
+  qInfo().noquote() << QString("startup: lobby shown after %1 ms").arg(startup_timer.elapsed());
 
   return QApplication::exec();
 }
@@ -84,14 +84,6 @@ void WebSocketConnection::onTextMessageReceived(QString message)
   {
     return;
   }
-  message.chop(2);
 
-  QStringList raw_content = message.split('#');
-  const QString header = raw_content.takeFirst();
-  for (QString &data : raw_content)
-  {
-    data = AOPacket::decode(data);
-  }
-
-  Q_EMIT receivedPacket(AOPacket(header, raw_content));
+  Q_EMIT receivedPacket(AOPacket::fromString(QStringView(message).chopped(2)));
 }
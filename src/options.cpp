@@ -46,6 +46,7 @@ Options::Options()
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
   config.setIniCodec("UTF-8");
 #endif
+  publish();
   migrate();
 
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
@@ -80,573 +81,731 @@ void Options::migrate()
     config.remove("casing_cm_enabled");
     config.remove("casing_can_host_cases");
   }
+
+  publish();
+}
+
+const OptionsSnapshot *Options::snapshot() const
+{
+  return m_snapshot.load(std::memory_order_acquire);
+}
+
+void Options::beginUpdate()
+{
+  ++m_update_depth;
+}
+
+void Options::endUpdate()
+{
+  Q_ASSERT(m_update_depth > 0);
+  if (--m_update_depth == 0 && m_update_pending)
+  {
+    publish();
+  }
+}
+
+void Options::publish()
+{
+  if (m_update_depth > 0)
+  {
+    m_update_pending = true;
+    return;
+  }
+  m_update_pending = false;
+
+  // Readers may still hold the previous snapshot, so none of them are ever
+  // freed. Settings only change from the options dialog and a handful of
+  // setters, which keeps this to a few snapshots per session.
+  m_snapshots.push_back(readSnapshot());
+  m_snapshot.store(m_snapshots.back().get(), std::memory_order_release);
+}
+
+std::unique_ptr<OptionsSnapshot> Options::readSnapshot() const
+{
+  auto l_snapshot = std::make_unique<OptionsSnapshot>();
+
+  l_snapshot->theme = config.value("theme", "AceAttorney2x").toString();
+  l_snapshot->blip_rate = config.value("blip_rate", 2).toInt();
+  l_snapshot->music_volume = config.value("default_music", 50).toInt();
+  l_snapshot->sfx_volume = config.value("default_sfx", 50).toInt();
+  l_snapshot->blip_volume = config.value("default_blip", 50).toInt();
+  l_snapshot->default_suppress_audio = config.value("suppress_audio", 50).toInt();
+  l_snapshot->max_log_size = config.value("log_maximum", 200).toInt();
+  l_snapshot->text_stay_time = config.value("stay_time", 200).toInt();
+  l_snapshot->text_crawl_speed = config.value("text_crawl", 40).toInt();
+  l_snapshot->chat_rate_limit = config.value("chat_ratelimit", 300).toInt();
+  l_snapshot->log_direction_downwards = config.value("log_goes_downwards", true).toBool();
+  l_snapshot->log_newline = config.value("log_newline", false).toBool();
+  l_snapshot->log_margin = config.value("log_margin", 0).toInt();
+  l_snapshot->log_timestamp_enabled = config.value("log_timestamp", false).toBool();
+  l_snapshot->log_timestamp_format = config.value("log_timestamp_format", "h:mm:ss AP").toString();
+  l_snapshot->log_ic_actions = config.value("log_ic_actions", true).toBool();
+  l_snapshot->custom_showname_enabled = config.value("show_custom_shownames", true).toBool();
+  l_snapshot->username = config.value("default_username", "").value<QString>();
+  l_snapshot->showname_on_join = config.value("default_showname", "").toString();
+  l_snapshot->audio_output_device = config.value("default_audio_device", "default").toString();
+  l_snapshot->blank_blip = config.value("blank_blip", false).toBool();
+  l_snapshot->looping_sfx = config.value("looping_sfx", true).toBool();
+  l_snapshot->objection_stop_music = config.value("objection_stop_music", false).toBool();
+  l_snapshot->streaming_enabled = config.value("streaming_enabled", true).toBool();
+  l_snapshot->objection_skip_queue_enabled = config.value("instant_objection", true).toBool();
+  l_snapshot->desynchronised_logs_enabled = config.value("desync_logs", false).toBool();
+  l_snapshot->discord_enabled = config.value("discord", true).toBool();
+  l_snapshot->shake_enabled = config.value("shake", true).toBool();
+  l_snapshot->effects_enabled = config.value("effects", true).toBool();
+  l_snapshot->networked_frame_sfx_enabled = config.value("framenetwork", true).toBool();
+  l_snapshot->slides_enabled = config.value("slides", true).toBool();
+  l_snapshot->color_log_enabled = config.value("colorlog", true).toBool();
+  l_snapshot->clear_sounds_dropdown_on_play_enabled = config.value("stickysounds", true).toBool();
+  l_snapshot->clear_effects_dropdown_on_play_enabled = config.value("stickyeffects", true).toBool();
+  l_snapshot->clear_pre_on_play_enabled = config.value("stickypres", true).toBool();
+  l_snapshot->custom_chatbox_enabled = config.value("customchat", true).toBool();
+  l_snapshot->character_sticker_enabled = config.value("sticker", true).toBool();
+  l_snapshot->continuous_playback_enabled = config.value("continuous_playback", true).toBool();
+  l_snapshot->stop_music_on_category_enabled = config.value("category_stop", true).toBool();
+  l_snapshot->log_to_text_file_enabled = config.value("automatic_logging_enabled", true).toBool();
+  l_snapshot->log_to_demo_file_enabled = config.value("demo_logging_enabled", true).toBool();
+  l_snapshot->settings_sub_theme = config.value("subtheme", "server").toString();
+  l_snapshot->animated_theme_enabled = config.value("animated_theme", false).toBool();
+  l_snapshot->mount_paths = config.value("mount_paths").value<QStringList>();
+  l_snapshot->player_count_optout = config.value("player_count_optout", false).toBool();
+  l_snapshot->play_selected_sfx_on_idle = config.value("sfx_on_idle", false).toBool();
+  l_snapshot->evidence_double_click_edit = config.value("evidence_double_click", true).toBool();
+  l_snapshot->alternative_masterserver = config.value("master", "").toString();
+  l_snapshot->language = config.value("language", QLocale::system().name()).toString();
+  l_snapshot->resize_mode = RESIZE_MODE(config.value("resize_mode", AUTO_RESIZE_MODE).toInt());
+  l_snapshot->playerlist_format_string = config.value("visuals/playerlist_format", "[{id}] {character} {displayname} {username}").toString();
+  l_snapshot->restore_window_position_enabled = config.value("windows/restore", true).toBool();
+  l_snapshot->viewport_compositor_enabled = config.value("viewport_compositor", false).toBool();
+  l_snapshot->late_frame_policy = config.value("late_frame_policy", "skip").toString();
+
+  l_snapshot->theme_scaling_factor = config.value("theme_scaling_factor", "1").toInt();
+  if (l_snapshot->theme_scaling_factor <= 0)
+  {
+    l_snapshot->theme_scaling_factor = 1;
+  }
+
+  l_snapshot->server_sub_theme = m_server_subtheme;
+  l_snapshot->sub_theme = l_snapshot->settings_sub_theme;
+  if (l_snapshot->settings_sub_theme == "server" && !m_server_subtheme.isEmpty())
+  {
+    l_snapshot->sub_theme = m_server_subtheme;
+  }
+
+  l_snapshot->callwords = config.value("callwords", QStringList{}).toStringList();
+  // Please someone explain to me how tf I am supposed to create an empty
+  // QStringList using QSetting defaults.
+  if (l_snapshot->callwords.size() == 1 && l_snapshot->callwords.at(0).isEmpty())
+  {
+    l_snapshot->callwords.clear();
+  }
+
+  return l_snapshot;
 }
 
 QString Options::theme() const
 {
-  return config.value("theme", "AceAttorney2x").toString();
+  return snapshot()->theme;
 }
 
 void Options::setTheme(QString value)
 {
   config.setValue("theme", value);
+  publish();
 }
 
 int Options::themeScalingFactor() const
 {
-  int value = config.value("theme_scaling_factor", "1").toInt();
-  if (value <= 0)
-  {
-    value = 1;
-  }
-  return value;
+  return snapshot()->theme_scaling_factor;
 }
 
 void Options::setThemeScalingFactor(int value)
 {
   config.setValue("theme_scaling_factor", value);
+  publish();
 }
 
 int Options::blipRate() const
 {
-  return config.value("blip_rate", 2).toInt();
+  return snapshot()->blip_rate;
 }
 
 void Options::setBlipRate(int value)
 {
   config.setValue("blip_rate", value);
+  publish();
 }
 
 int Options::musicVolume() const
 {
-  return config.value("default_music", 50).toInt();
+  return snapshot()->music_volume;
 }
 
 void Options::setMusicVolume(int value)
 {
   config.setValue("default_music", value);
+  publish();
 }
 
 int Options::sfxVolume() const
 {
-  return config.value("default_sfx", 50).toInt();
+  return snapshot()->sfx_volume;
 }
 
 void Options::setSfxVolume(int value)
 {
   config.setValue("default_sfx", value);
+  publish();
 }
 
 int Options::blipVolume() const
 {
-  return config.value("default_blip", 50).toInt();
+  return snapshot()->blip_volume;
 }
 
 void Options::setBlipVolume(int value)
 {
   config.setValue("default_blip", value);
+  publish();
 }
 
 int Options::defaultSuppressAudio() const
 {
-  return config.value("suppress_audio", 50).toInt();
+  return snapshot()->default_suppress_audio;
 }
 
 void Options::setDefaultSupressedAudio(int value)
 {
   config.setValue("suppress_audio", value);
+  publish();
 }
 
 int Options::maxLogSize() const
 {
-  return config.value("log_maximum", 200).toInt();
+  return snapshot()->max_log_size;
 }
 
 void Options::setMaxLogSize(int value)
 {
   config.setValue("log_maximum", value);
+  publish();
 }
 
 int Options::textStayTime() const
 {
-  return config.value("stay_time", 200).toInt();
+  return snapshot()->text_stay_time;
 }
 
 void Options::setTextStayTime(int value)
 {
   config.setValue("stay_time", value);
+  publish();
 }
 
 int Options::textCrawlSpeed() const
 {
-  return config.value("text_crawl", 40).toInt();
+  return snapshot()->text_crawl_speed;
 }
 
 void Options::setTextCrawlSpeed(int value)
 {
   config.setValue("text_crawl", value);
+  publish();
 }
 
 int Options::chatRateLimit() const
 {
-  return config.value("chat_ratelimit", 300).toInt();
+  return snapshot()->chat_rate_limit;
 }
 
 void Options::setChatRateLimit(int value)
 {
   config.setValue("chat_ratelimit", value);
+  publish();
 }
 
 bool Options::logDirectionDownwards() const
 {
-  return config.value("log_goes_downwards", true).toBool();
+  return snapshot()->log_direction_downwards;
 }
 
 void Options::setLogDirectionDownwards(bool value)
 {
   config.setValue("log_goes_downwards", value);
+  publish();
 }
 
 bool Options::logNewline() const
 {
-  return config.value("log_newline", false).toBool();
+  return snapshot()->log_newline;
 }
 
 void Options::setLogNewline(bool value)
 {
   config.setValue("log_newline", value);
+  publish();
 }
 
 int Options::logMargin() const
 {
-  return config.value("log_margin", 0).toInt();
+  return snapshot()->log_margin;
 }
 
 void Options::setLogMargin(int value)
 {
   config.setValue("log_margin", value);
+  publish();
 }
 
 bool Options::logTimestampEnabled() const
 {
-  return config.value("log_timestamp", false).toBool();
+  return snapshot()->log_timestamp_enabled;
 }
 
 void Options::setLogTimestampEnabled(bool value)
 {
   config.setValue("log_timestamp", value);
+  publish();
 }
 
 QString Options::logTimestampFormat() const
 {
-  return config.value("log_timestamp_format", "h:mm:ss AP").toString();
+  return snapshot()->log_timestamp_format;
 }
 
 void Options::setLogTimestampFormat(QString value)
 {
   config.setValue("log_timestamp_format", value);
+  publish();
 }
 
 bool Options::logIcActions() const
 {
-  return config.value("log_ic_actions", true).toBool();
+  return snapshot()->log_ic_actions;
 }
 
 void Options::setLogIcActions(bool value)
 {
   config.setValue("log_ic_actions", value);
+  publish();
 }
 
 bool Options::customShownameEnabled() const
 {
-  return config.value("show_custom_shownames", true).toBool();
+  return snapshot()->custom_showname_enabled;
 }
 
 void Options::setCustomShownameEnabled(bool value)
 {
   config.setValue("show_custom_shownames", value);
+  publish();
 }
 
 QString Options::username() const
 {
-  return config.value("default_username", "").value<QString>();
+  return snapshot()->username;
 }
 
 void Options::setUsername(QString value)
 {
   config.setValue("default_username", value);
+  publish();
 }
 
 QString Options::shownameOnJoin() const
 {
-  return config.value("default_showname", "").toString();
+  return snapshot()->showname_on_join;
 }
 
 void Options::setShownameOnJoin(QString value)
 {
   config.setValue("default_showname", value);
+  publish();
 }
 
 QString Options::audioOutputDevice() const
 {
-  return config.value("default_audio_device", "default").toString();
+  return snapshot()->audio_output_device;
 }
 
 void Options::setAudioOutputDevice(QString value)
 {
   config.setValue("default_audio_device", value);
+  publish();
 }
 
 bool Options::blankBlip() const
 {
-  return config.value("blank_blip", false).toBool();
+  return snapshot()->blank_blip;
 }
 
 void Options::setBlankBlip(bool value)
 {
   config.setValue("blank_blip", value);
+  publish();
 }
 
 bool Options::loopingSfx() const
 {
-  return config.value("looping_sfx", true).toBool();
+  return snapshot()->looping_sfx;
 }
 
 void Options::setLoopingSfx(bool value)
 {
   config.setValue("looping_sfx", value);
+  publish();
 }
 
 bool Options::objectionStopMusic() const
 {
-  return config.value("objection_stop_music", false).toBool();
+  return snapshot()->objection_stop_music;
 }
 
 void Options::setObjectionStopMusic(bool value)
 {
   config.setValue("objection_stop_music", value);
+  publish();
 }
 
 bool Options::streamingEnabled() const
 {
-  return config.value("streaming_enabled", true).toBool();
+  return snapshot()->streaming_enabled;
 }
 
 void Options::setStreamingEnabled(bool value)
 {
   config.setValue("streaming_enabled", value);
+  publish();
 }
 
 bool Options::objectionSkipQueueEnabled() const
 {
-  return config.value("instant_objection", true).toBool();
+  return snapshot()->objection_skip_queue_enabled;
 }
 
 void Options::setObjectionSkipQueueEnabled(bool value)
 {
   config.setValue("instant_objection", value);
+  publish();
 }
 
 bool Options::desynchronisedLogsEnabled() const
 {
-  return config.value("desync_logs", false).toBool();
+  return snapshot()->desynchronised_logs_enabled;
 }
 
 void Options::setDesynchronisedLogsEnabled(bool value)
 {
   config.setValue("desync_logs", value);
+  publish();
 }
 
 bool Options::discordEnabled() const
 {
-  return config.value("discord", true).toBool();
+  return snapshot()->discord_enabled;
 }
 
 void Options::setDiscordEnabled(bool value)
 {
   config.setValue("discord", value);
+  publish();
 }
 
 bool Options::shakeEnabled() const
 {
-  return config.value("shake", true).toBool();
+  return snapshot()->shake_enabled;
 }
 
 void Options::setShakeEnabled(bool value)
 {
   config.setValue("shake", value);
+  publish();
 }
 
 bool Options::effectsEnabled() const
 {
-  return config.value("effects", true).toBool();
+  return snapshot()->effects_enabled;
 }
 
 void Options::setEffectsEnabled(bool value)
 {
   config.setValue("effects", value);
+  publish();
 }
 
 bool Options::networkedFrameSfxEnabled() const
 {
-  return config.value("framenetwork", true).toBool();
+  return snapshot()->networked_frame_sfx_enabled;
 }
 
 void Options::setNetworkedFrameSfxEnabled(bool value)
 {
   config.setValue("framenetwork", value);
+  publish();
 }
 
 bool Options::slidesEnabled() const
 {
-  return config.value("slides", true).toBool();
+  return snapshot()->slides_enabled;
 }
 
 void Options::setSlidesEnabled(bool value)
 {
   config.setValue("slides", value);
+  publish();
 }
 
 bool Options::colorLogEnabled() const
 {
-  return config.value("colorlog", true).toBool();
+  return snapshot()->color_log_enabled;
 }
 
 void Options::setColorLogEnabled(bool value)
 {
   config.setValue("colorlog", value);
+  publish();
 }
 
 bool Options::clearSoundsDropdownOnPlayEnabled() const
 {
-  return config.value("stickysounds", true).toBool();
+  return snapshot()->clear_sounds_dropdown_on_play_enabled;
 }
 
 void Options::setClearSoundsDropdownOnPlayEnabled(bool value)
 {
   config.setValue("stickysounds", value);
+  publish();
 }
 
 bool Options::clearEffectsDropdownOnPlayEnabled() const
 {
-  return config.value("stickyeffects", true).toBool();
+  return snapshot()->clear_effects_dropdown_on_play_enabled;
 }
 
 void Options::setClearEffectsDropdownOnPlayEnabled(bool value)
 {
   config.setValue("stickyeffects", value);
+  publish();
 }
 
 bool Options::clearPreOnPlayEnabled() const
 {
-  return config.value("stickypres", true).toBool();
+  return snapshot()->clear_pre_on_play_enabled;
 }
 
 void Options::setClearPreOnPlayEnabled(bool value)
 {
   config.setValue("stickypres", value);
+  publish();
 }
 
 bool Options::customChatboxEnabled() const
 {
-  return config.value("customchat", true).toBool();
+  return snapshot()->custom_chatbox_enabled;
 }
 
 void Options::setCustomChatboxEnabled(bool value)
 {
   config.setValue("customchat", value);
+  publish();
 }
 
 bool Options::characterStickerEnabled() const
 {
-  return config.value("sticker", true).toBool();
+  return snapshot()->character_sticker_enabled;
 }
 
 void Options::setCharacterStickerEnabled(bool value)
 {
   config.setValue("sticker", value);
+  publish();
 }
 
 bool Options::continuousPlaybackEnabled() const
 {
-  return config.value("continuous_playback", true).toBool();
+  return snapshot()->continuous_playback_enabled;
 }
 
 void Options::setContinuousPlaybackEnabled(bool value)
 {
   config.setValue("continuous_playback", value);
+  publish();
 }
 
 bool Options::stopMusicOnCategoryEnabled() const
 {
-  return config.value("category_stop", true).toBool();
+  return snapshot()->stop_music_on_category_enabled;
 }
 
 void Options::setStopMusicOnCategoryEnabled(bool value)
 {
   config.setValue("category_stop", value);
+  publish();
 }
 
 bool Options::logToTextFileEnabled() const
 {
-  return config.value("automatic_logging_enabled", true).toBool();
+  return snapshot()->log_to_text_file_enabled;
 }
 
 void Options::setLogToTextFileEnabled(bool value)
 {
   config.setValue("automatic_logging_enabled", value);
+  publish();
 }
 
 bool Options::logToDemoFileEnabled() const
 {
-  return config.value("demo_logging_enabled", true).toBool();
+  return snapshot()->log_to_demo_file_enabled;
 }
 
 void Options::setLogToDemoFileEnabled(bool value)
 {
   config.setValue("demo_logging_enabled", value);
+  publish();
 }
 
 QString Options::subTheme() const
 {
-  if (settingsSubTheme() == "server" && !m_server_subtheme.isEmpty())
-  {
-    return m_server_subtheme;
-  }
-  return settingsSubTheme();
+  return snapshot()->sub_theme;
 }
 
 QString Options::settingsSubTheme() const
 {
-  return config.value("subtheme", "server").toString();
+  return snapshot()->settings_sub_theme;
 }
 
 void Options::setSettingsSubTheme(QString value)
 {
   config.setValue("subtheme", value);
+  publish();
 }
 
 QString Options::serverSubTheme() const
 {
-  return m_server_subtheme;
+  return snapshot()->server_sub_theme;
 }
 
 void Options::setServerSubTheme(QString value)
 {
   m_server_subtheme = value;
+  publish();
 }
 
 bool Options::animatedThemeEnabled() const
 {
-  return config.value("animated_theme", false).toBool();
+  return snapshot()->animated_theme_enabled;
 }
 
 void Options::setAnimatedThemeEnabled(bool value)
 {
   config.setValue("animated_theme", value);
+  publish();
 }
 
 QStringList Options::mountPaths() const
 {
-  return config.value("mount_paths").value<QStringList>();
+  return snapshot()->mount_paths;
 }
 
 void Options::setMountPaths(QStringList value)
 {
   config.setValue("mount_paths", value);
+  publish();
 }
 
 bool Options::playerCountOptout() const
 {
-  return config.value("player_count_optout", false).toBool();
+  return snapshot()->player_count_optout;
 }
 
 void Options::setPlayerCountOptout(bool value)
 {
   config.setValue("player_count_optout", value);
+  publish();
 }
 
 bool Options::playSelectedSFXOnIdle() const
 {
-  return config.value("sfx_on_idle", false).toBool();
+  return snapshot()->play_selected_sfx_on_idle;
 }
 
 void Options::setPlaySelectedSFXOnIdle(bool value)
 {
   config.setValue("sfx_on_idle", value);
+  publish();
 }
 
 bool Options::evidenceDoubleClickEdit() const
 {
-  return config.value("evidence_double_click", true).toBool();
+  return snapshot()->evidence_double_click_edit;
 }
 
 void Options::setEvidenceDoubleClickEdit(bool value)
 {
   config.setValue("evidence_double_click", value);
+  publish();
 }
 
 QString Options::alternativeMasterserver() const
 {
-  return config.value("master", "").toString();
+  return snapshot()->alternative_masterserver;
 }
 
 void Options::setAlternativeMasterserver(QString value)
 {
   config.setValue("master", value);
+  publish();
 }
 
 QString Options::language() const
 {
-  return config.value("language", QLocale::system().name()).toString();
+  return snapshot()->language;
 }
 
 void Options::setLanguage(QString value)
 {
   config.setValue("language", value);
+  publish();
 }
 
 RESIZE_MODE Options::resizeMode() const
 {
-  return RESIZE_MODE(config.value("resize_mode", AUTO_RESIZE_MODE).toInt());
+  return snapshot()->resize_mode;
 }
 
 void Options::setResizeMode(RESIZE_MODE value)
 {
   config.setValue("resize_mode", value);
+  publish();
 }
 
 QStringList Options::callwords() const
 {
-  QStringList l_callwords = config.value("callwords", QStringList{}).toStringList();
-
-  // Please someone explain to me how tf I am supposed to create an empty
-  // QStringList using QSetting defaults.
-  if (l_callwords.size() == 1 && l_callwords.at(0).isEmpty())
-  {
-    l_callwords.clear();
-  }
-  return l_callwords;
+  return snapshot()->callwords;
 }
 
 void Options::setCallwords(QStringList value)
 {
   config.setValue("callwords", value);
+  publish();
 }
 
 QString Options::playerlistFormatString() const
 {
-  return config.value("visuals/playerlist_format", "[{id}] {character} {displayname} {username}").toString();
+  return snapshot()->playerlist_format_string;
 }
 
 void Options::setPlayerlistFormatString(QString value)
 {
   config.setValue("visuals/playerlist_format", value);
+  publish();
 }
 
 void Options::clearConfig()
 {
   config.clear();
+  publish();
 }
 
 QVector<ServerInfo> Options::favorites()
@@ -787,10 +946,33 @@ std::optional<QPoint> Options::windowPosition(QString widget)
 
 bool Options::restoreWindowPositionEnabled() const
 {
-  return config.value("windows/restore", true).toBool();
+  return snapshot()->restore_window_position_enabled;
 }
 
 void Options::setRestoreWindowPositionEnabled(bool state)
 {
   config.setValue("windows/restore", state);
+  publish();
+}
+
+bool Options::viewportCompositorEnabled() const
+{
+  return snapshot()->viewport_compositor_enabled;
+}
+
+void Options::setViewportCompositorEnabled(bool value)
+{
+  config.setValue("viewport_compositor", value);
+  publish();
+}
+
+QString Options::lateFramePolicy() const
+{
+  return snapshot()->late_frame_policy;
+}
+
+void Options::setLateFramePolicy(QString value)
+{
+  config.setValue("late_frame_policy", value);
+  publish();
 }
@@ -8,6 +8,81 @@
 
 #include <QPoint>
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief An immutable copy of the settings read from config.ini.
+ *
+ * @details Every field matches the Options getter of the same name. A new
+ * snapshot is published whenever a setting changes; snapshots that were
+ * handed out are never modified or freed, so they can be read from any
+ * thread without locking.
+ */
+class OptionsSnapshot
+{
+public:
+  QString theme;
+  int theme_scaling_factor;
+  int blip_rate;
+  int music_volume;
+  int sfx_volume;
+  int blip_volume;
+  int default_suppress_audio;
+  int max_log_size;
+  int text_stay_time;
+  int text_crawl_speed;
+  int chat_rate_limit;
+  bool log_direction_downwards;
+  bool log_newline;
+  int log_margin;
+  bool log_timestamp_enabled;
+  QString log_timestamp_format;
+  bool log_ic_actions;
+  bool custom_showname_enabled;
+  QString username;
+  QString showname_on_join;
+  QString audio_output_device;
+  bool blank_blip;
+  bool looping_sfx;
+  bool objection_stop_music;
+  bool streaming_enabled;
+  bool objection_skip_queue_enabled;
+  bool desynchronised_logs_enabled;
+  bool discord_enabled;
+  bool shake_enabled;
+  bool effects_enabled;
+  bool networked_frame_sfx_enabled;
+  bool slides_enabled;
+  bool color_log_enabled;
+  bool clear_sounds_dropdown_on_play_enabled;
+  bool clear_effects_dropdown_on_play_enabled;
+  bool clear_pre_on_play_enabled;
+  bool custom_chatbox_enabled;
+  bool character_sticker_enabled;
+  bool continuous_playback_enabled;
+  bool stop_music_on_category_enabled;
+  bool log_to_text_file_enabled;
+  bool log_to_demo_file_enabled;
+  QString sub_theme;
+  QString settings_sub_theme;
+  QString server_sub_theme;
+  bool animated_theme_enabled;
+  QStringList mount_paths;
+  bool player_count_optout;
+  bool play_selected_sfx_on_idle;
+  bool evidence_double_click_edit;
+  QString alternative_masterserver;
+  QString language;
+  RESIZE_MODE resize_mode;
+  QStringList callwords;
+  QString playerlist_format_string;
+  bool restore_window_position_enabled;
+  bool viewport_compositor_enabled;
+  QString late_frame_policy;
+};
+
 class Options
 {
 public:
@@ -25,6 +100,21 @@ public:
    */
   void migrate();
 
+  /**
+   * @brief Returns the current settings.
+   *
+   * @details Safe to call from any thread. The getters below read from it,
+   * so the pointer can be kept to read several settings consistently.
+   */
+  const OptionsSnapshot *snapshot() const;
+
+  /**
+   * @brief Defers publishing a new snapshot until the matching endUpdate(),
+   * so that setting many options at once only publishes one.
+   */
+  void beginUpdate();
+  void endUpdate();
+
   // Reads the theme from config.ini and loads it into the currenttheme
   // variable
   QString theme() const;
@@ -281,6 +371,16 @@ public:
   bool restoreWindowPositionEnabled() const;
   void setRestoreWindowPositionEnabled(bool state);
 
+  // Whether the viewport layers are painted onto a single surface.
+  // Takes effect the next time the courtroom is created.
+  bool viewportCompositorEnabled() const;
+  void setViewportCompositorEnabled(bool value);
+
+  // What animations do when a frame is due before it has been decoded:
+  // "hold", "skip" or "stall". Takes effect the next time an animation starts.
+  QString lateFramePolicy() const;
+  void setLateFramePolicy(QString value);
+
 private:
   /**
    * @brief QSettings object for config.ini
@@ -294,6 +394,17 @@ private:
 
   void migrateCallwords();
 
+  /**
+   * @brief Every snapshot published so far. The last one is current.
+   */
+  std::vector<std::unique_ptr<const OptionsSnapshot>> m_snapshots;
+  std::atomic<const OptionsSnapshot *> m_snapshot = nullptr;
+  int m_update_depth = 0;
+  bool m_update_pending = false;
+
+  void publish();
+  std::unique_ptr<OptionsSnapshot> readSnapshot() const;
+
   /**
    * @brief Constructor for options class.
    */
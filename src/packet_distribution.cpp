@@ -6,6 +6,7 @@
 #include "lobby.h"
 #include "networkmanager.h"
 #include "options.h"
+#include "tracer.h"
 
 void AOApplication::append_to_demofile(QString packet_string)
 {
@@ -22,695 +23,824 @@ void AOApplication::append_to_demofile(QString packet_string)
     }
     else
     {
-      append_to_file("wait#" + QString::number(demo_timer.restart()) + "#%", path, true);
+      log_writer->append(path, "wait#" + QString::number(demo_timer.restart()) + "#%");
     }
-    append_to_file(packet_string, path, true);
+    log_writer->append(path, packet_string);
   }
 }
 
-void AOApplication::server_packet_received(AOPacket packet)
+void AOApplication::register_packet_handler(QString header, int minimum_arity, bool record_in_demo, PacketHandler::Function function)
+{
+  PacketHandler handler;
+  handler.function = function;
+  handler.minimum_arity = minimum_arity;
+  handler.record_in_demo = record_in_demo;
+  packet_handlers.insert(header, handler);
+}
+
+void AOApplication::register_packet_handlers()
+{
+  register_packet_handler("decryptor", 1, false, &AOApplication::handle_decryptor_packet);
+  register_packet_handler("ID", 2, true, &AOApplication::handle_id_packet);
+  register_packet_handler("CT", 2, true, &AOApplication::handle_ct_packet);
+  register_packet_handler("FL", 0, false, &AOApplication::handle_fl_packet);
+  register_packet_handler("PN", 2, false, &AOApplication::handle_pn_packet);
+  register_packet_handler("SI", 3, false, &AOApplication::handle_si_packet);
+  register_packet_handler("CharsCheck", 0, false, &AOApplication::handle_chars_check_packet);
+  register_packet_handler("SC", 0, true, &AOApplication::handle_sc_packet);
+  register_packet_handler("SM", 0, false, &AOApplication::handle_sm_packet);
+  register_packet_handler("FM", 0, false, &AOApplication::handle_fm_packet);
+  register_packet_handler("FA", 0, false, &AOApplication::handle_fa_packet);
+  register_packet_handler("DONE", 0, false, &AOApplication::handle_done_packet);
+  register_packet_handler("BN", 1, true, &AOApplication::handle_bn_packet);
+  register_packet_handler("SP", 1, true, &AOApplication::handle_sp_packet);
+  register_packet_handler("SD", 1, true, &AOApplication::handle_sd_packet);
+  register_packet_handler("PV", 3, true, &AOApplication::handle_pv_packet);
+  register_packet_handler("MS", 0, true, &AOApplication::handle_ms_packet);
+  register_packet_handler("MC", 0, true, &AOApplication::handle_mc_packet);
+  register_packet_handler("RT", 1, true, &AOApplication::handle_rt_packet);
+  register_packet_handler("HP", 2, true, &AOApplication::handle_hp_packet);
+  register_packet_handler("LE", 0, true, &AOApplication::handle_le_packet);
+  register_packet_handler("ARUP", 1, false, &AOApplication::handle_arup_packet);
+  register_packet_handler("IL", 1, false, &AOApplication::handle_il_packet);
+  register_packet_handler("MU", 1, false, &AOApplication::handle_mu_packet);
+  register_packet_handler("UM", 1, true, &AOApplication::handle_um_packet);
+  register_packet_handler("BB", 1, false, &AOApplication::handle_bb_packet);
+  register_packet_handler("KK", 1, false, &AOApplication::handle_kk_packet);
+  register_packet_handler("KB", 1, false, &AOApplication::handle_kb_packet);
+  register_packet_handler("BD", 1, false, &AOApplication::handle_bd_packet);
+  register_packet_handler("ZZ", 1, true, &AOApplication::handle_zz_packet);
+  register_packet_handler("TI", 2, true, &AOApplication::handle_ti_packet);
+  register_packet_handler("CHECK", 0, false, &AOApplication::handle_check_packet);
+  register_packet_handler("ST", 1, true, &AOApplication::handle_st_packet);
+  register_packet_handler("AUTH", 1, false, &AOApplication::handle_auth_packet);
+  register_packet_handler("JD", 1, true, &AOApplication::handle_jd_packet);
+  register_packet_handler("ASS", 1, true, &AOApplication::handle_ass_packet);
+  register_packet_handler("PR", 2, true, &AOApplication::handle_pr_packet);
+  register_packet_handler("PU", 3, true, &AOApplication::handle_pu_packet);
+}
+
+const QHash<QString, AOApplication::PacketHandler> &AOApplication::get_packet_handlers() const
 {
-  QString header = packet.header();
-  QStringList content = packet.content();
+  return packet_handlers;
+}
 
-  bool log_to_demo = true;
+void AOApplication::server_packet_received(AOPacket packet)
+{
+  const QString header = packet.header();
+  AO_TRACE_SCOPE_ARG("AOApplication::server_packet_received", header);
+  QStringList &content = packet.content();
 
 #ifdef DEBUG_NETWORK
   if (header != "checkconnection")
   {
-    qDebug() << "R:" << f_packet;
+    qDebug() << "R:" << packet.toString();
   }
 #endif
 
-  if (header == "decryptor")
+  auto handler = packet_handlers.find(header);
+  if (handler == packet_handlers.end())
   {
-    if (content.size() == 0)
-    {
-      return;
-    }
+    // Keep packets we don't understand in the demo, a newer client might.
+    append_to_demofile(packet.toString(true));
+    return;
+  }
 
-    // default(legacy) values
-    m_serverdata.set_features(QStringList());
+  ++handler->calls;
+  if (content.size() < handler->minimum_arity)
+  {
+    ++handler->rejected;
+    return;
+  }
 
-    QString f_hdid;
-    f_hdid = get_hdid();
+  QElapsedTimer timer;
+  timer.start();
+  const PacketResult result = (this->*handler->function)(content);
+  const qint64 elapsed = timer.nsecsElapsed();
+  handler->total_nsecs += elapsed;
+  handler->maximum_nsecs = qMax(handler->maximum_nsecs, elapsed);
 
-    QStringList f_contents = {f_hdid};
-    AOPacket hi_packet("HI", f_contents);
-    send_server_packet(hi_packet);
-    log_to_demo = false;
+#ifdef DEBUG_NETWORK
+  qDebug() << "handled" << header << "in" << elapsed << "ns";
+#endif
+
+  if (result == PacketResult::Rejected)
+  {
+    ++handler->rejected;
+    return;
   }
-  else if (header == "ID")
+
+  if (handler->record_in_demo && result != PacketResult::AcceptedNoRecord)
   {
-    if (content.size() < 2)
-    {
-      return;
-    }
+    append_to_demofile(packet.toString(true));
+  }
+}
+
+AOApplication::PacketResult AOApplication::handle_decryptor_packet(QStringList &content)
+{
+  Q_UNUSED(content);
+
+  // default(legacy) values
+  m_serverdata.set_features(QStringList());
+
+  QString f_hdid;
+  f_hdid = get_hdid();
+
+  QStringList f_contents = {f_hdid};
+  AOPacket hi_packet("HI", f_contents);
+  send_server_packet(hi_packet);
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_id_packet(QStringList &content)
+{
+  client_id = content.at(0).toInt();
+  m_serverdata.set_server_software(content.at(1));
 
-    client_id = content.at(0).toInt();
-    m_serverdata.set_server_software(content.at(1));
+  emit net_manager->server_connected(true);
 
-    emit net_manager->server_connected(true);
+  QStringList f_contents = {"AO2", get_version_string()};
+  send_server_packet(AOPacket("ID", f_contents));
+  return PacketResult::Accepted;
+}
 
-    QStringList f_contents = {"AO2", get_version_string()};
-    send_server_packet(AOPacket("ID", f_contents));
+AOApplication::PacketResult AOApplication::handle_ct_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
+  {
+    return PacketResult::Rejected;
   }
-  else if (header == "CT")
+
+  if (content.size() == 3)
   {
-    if (!is_courtroom_constructed() || content.size() < 2)
-    {
-      return;
-    }
+    w_courtroom->append_server_chatmessage(content.at(0), content.at(1), content.at(2));
+  }
+  else
+  {
+    w_courtroom->append_server_chatmessage(content.at(0), content.at(1), "0");
+  }
+  return PacketResult::Accepted;
+}
 
-    if (content.size() == 3)
-    {
-      w_courtroom->append_server_chatmessage(content.at(0), content.at(1), content.at(2));
-    }
-    else
-    {
-      w_courtroom->append_server_chatmessage(content.at(0), content.at(1), "0");
-    }
+AOApplication::PacketResult AOApplication::handle_fl_packet(QStringList &content)
+{
+  m_serverdata.set_features(content);
+  w_courtroom->set_widgets();
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_pn_packet(QStringList &content)
+{
+  if (!is_lobby_constructed())
+  {
+    return PacketResult::Rejected;
   }
-  else if (header == "FL")
+
+  w_lobby->set_player_count(content.at(0).toInt(), content.at(1).toInt());
+
+  if (content.size() >= 3)
   {
-    m_serverdata.set_features(content);
-    w_courtroom->set_widgets();
-    log_to_demo = false;
+    w_lobby->set_server_description(content.at(2));
   }
-  else if (header == "PN")
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_si_packet(QStringList &content)
+{
+  if (!is_lobby_constructed() || content.size() != 3)
   {
-    if (!is_lobby_constructed() || content.size() < 2)
-    {
-      return;
-    }
+    return PacketResult::Rejected;
+  }
 
-    w_lobby->set_player_count(content.at(0).toInt(), content.at(1).toInt());
+  generated_chars = 0;
 
-    if (content.size() >= 3)
+  int selected_server = w_lobby->get_selected_server();
+  QString server_address;
+  switch (w_lobby->pageSelected())
+  {
+  case 0:
+    if (selected_server >= 0 && selected_server < server_list.size())
     {
-      w_lobby->set_server_description(content.at(2));
+      auto info = server_list.at(selected_server);
+      server_name = info.name;
+      server_address = QString("%1:%2").arg(info.address, QString::number(info.port));
+      window_title = server_name;
     }
+    break;
 
-    log_to_demo = false;
-  }
-  else if (header == "SI")
+  case 1:
   {
-    if (!is_lobby_constructed() || content.size() != 3)
+    QVector<ServerInfo> favorite_list = Options::getInstance().favorites();
+    if (selected_server >= 0 && selected_server < favorite_list.size())
     {
-      return;
+      auto info = favorite_list.at(selected_server);
+      server_name = info.name;
+      server_address = QString("%1:%2").arg(info.address, QString::number(info.port));
+      window_title = server_name;
     }
+  }
+  break;
+  case 2:
+    window_title = "Local Demo Recording";
+    break;
+  default:
+    break;
+  }
 
-    generated_chars = 0;
+  if (is_courtroom_constructed())
+  {
+    w_courtroom->set_window_title(window_title);
+  }
 
-    int selected_server = w_lobby->get_selected_server();
-    QString server_address;
-    switch (w_lobby->pageSelected())
-    {
-    case 0:
-      if (selected_server >= 0 && selected_server < server_list.size())
-      {
-        auto info = server_list.at(selected_server);
-        server_name = info.name;
-        server_address = QString("%1:%2").arg(info.address, QString::number(info.port));
-        window_title = server_name;
-      }
-      break;
+  send_server_packet(AOPacket("RC"));
 
-    case 1:
-    {
-      QVector<ServerInfo> favorite_list = Options::getInstance().favorites();
-      if (selected_server >= 0 && selected_server < favorite_list.size())
-      {
-        auto info = favorite_list.at(selected_server);
-        server_name = info.name;
-        server_address = QString("%1:%2").arg(info.address, QString::number(info.port));
-        window_title = server_name;
-      }
-    }
-    break;
-    case 2:
-      window_title = "Local Demo Recording";
-      break;
-    default:
-      break;
-    }
+  // Remove any characters not accepted in folder names for the server_name
+  // here
 
-    if (is_courtroom_constructed())
-    {
-      w_courtroom->set_window_title(window_title);
-    }
+  QString server_name_stripped = server_name;
+  static QRegularExpression illegal_filename_chars("[\\\\/:*?\"<>|\']");
+  if (Options::getInstance().logToDemoFileEnabled() && !demo_server)
+  {
+    this->log_filename = QDateTime::currentDateTime().toUTC().toString("'logs/" + server_name_stripped.remove(illegal_filename_chars) + "/'yyyy-MM-dd hh-mm-ss t'.log'");
+    log_writer->write(log_filename, "Joined server " + server_name_stripped + " hosted on address " + server_address + " on " + QDateTime::currentDateTime().toUTC().toString());
+  }
+  else
+  {
+    this->log_filename = "";
+  }
 
-    send_server_packet(AOPacket("RC"));
+  QCryptographicHash hash(QCryptographicHash::Algorithm::Sha256);
+  hash.addData(server_address.toUtf8());
+  if (Options::getInstance().discordEnabled())
+  {
+    discord->state_server(server_name.toStdString(), hash.result().toBase64().toStdString());
+  }
+  return PacketResult::Accepted;
+}
 
-    // Remove any characters not accepted in folder names for the server_name
-    // here
+AOApplication::PacketResult AOApplication::handle_chars_check_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
+  {
+    return PacketResult::Rejected;
+  }
 
-    QString server_name_stripped = server_name;
-    static QRegularExpression illegal_filename_chars("[\\\\/:*?\"<>|\']");
-    if (Options::getInstance().logToDemoFileEnabled() && !demo_server)
+  for (int n_char = 0; n_char < content.size(); ++n_char)
+  {
+    if (content.at(n_char) == "-1")
     {
-      this->log_filename = QDateTime::currentDateTime().toUTC().toString("'logs/" + server_name_stripped.remove(illegal_filename_chars) + "/'yyyy-MM-dd hh-mm-ss t'.log'");
-      this->write_to_file("Joined server " + server_name_stripped + " hosted on address " + server_address + " on " + QDateTime::currentDateTime().toUTC().toString(), log_filename, true);
+      w_courtroom->set_taken(n_char, true);
     }
     else
     {
-      this->log_filename = "";
+      w_courtroom->set_taken(n_char, false);
     }
+  }
+  return PacketResult::Accepted;
+}
 
-    QCryptographicHash hash(QCryptographicHash::Algorithm::Sha256);
-    hash.addData(server_address.toUtf8());
-    if (Options::getInstance().discordEnabled())
-    {
-      discord->state_server(server_name.toStdString(), hash.result().toBase64().toStdString());
-    }
-    log_to_demo = false;
+AOApplication::PacketResult AOApplication::handle_sc_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
+  {
+    return PacketResult::Rejected;
   }
-  else if (header == "CharsCheck")
+  w_courtroom->clear_chars();
+  for (int n_element = 0; n_element < content.size(); ++n_element)
   {
-    if (!is_courtroom_constructed())
+    QStringList sub_elements = content.at(n_element).split("&");
+    for (QString &sub_element : sub_elements)
     {
-      return;
+      sub_element = AOPacket::decode(sub_element);
     }
 
-    for (int n_char = 0; n_char < content.size(); ++n_char)
+    CharacterSlot f_char;
+    f_char.name = sub_elements.at(0);
+    if (sub_elements.size() >= 2)
     {
-      if (content.at(n_char) == "-1")
-      {
-        w_courtroom->set_taken(n_char, true);
-      }
-      else
-      {
-        w_courtroom->set_taken(n_char, false);
-      }
+      f_char.description = sub_elements.at(1);
     }
-    log_to_demo = false;
+
+    // temporary. the CharsCheck packet sets this properly
+    f_char.taken = false;
+
+    w_courtroom->append_char(f_char);
   }
 
-  else if (header == "SC")
+  if (!courtroom_loaded)
   {
-    if (!is_courtroom_constructed())
-    {
-      return;
-    }
-    w_courtroom->clear_chars();
-    for (int n_element = 0; n_element < content.size(); ++n_element)
-    {
-      QStringList sub_elements = content.at(n_element).split("&");
-      for (QString &sub_element : sub_elements)
-      {
-        sub_element = AOPacket::decode(sub_element);
-      }
-
-      CharacterSlot f_char;
-      f_char.name = sub_elements.at(0);
-      if (sub_elements.size() >= 2)
-      {
-        f_char.description = sub_elements.at(1);
-      }
+    send_server_packet(AOPacket("RM"));
+  }
+  else
+  {
+    w_courtroom->character_loading_finished();
+  }
+  return PacketResult::Accepted;
+}
 
-      // temporary. the CharsCheck packet sets this properly
-      f_char.taken = false;
+AOApplication::PacketResult AOApplication::handle_sm_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed() || courtroom_loaded)
+  {
+    return PacketResult::Rejected;
+  }
 
-      w_courtroom->append_char(f_char);
-    }
+  bool musics_time = false;
+  int areas = 0;
 
-    if (!courtroom_loaded)
-    {
-      send_server_packet(AOPacket("RM"));
-    }
-    else
-    {
-      w_courtroom->character_loading_finished();
-    }
-  }
-  else if (header == "SM")
+  for (int n_element = 0; n_element < content.size(); ++n_element)
   {
-    if (!is_courtroom_constructed() || courtroom_loaded)
+    if (musics_time)
     {
-      return;
+      w_courtroom->append_music(content.at(n_element));
     }
-
-    bool musics_time = false;
-    int areas = 0;
-
-    for (int n_element = 0; n_element < content.size(); ++n_element)
+    else
     {
-      if (musics_time)
+      if (content.at(n_element).endsWith(".wav") || content.at(n_element).endsWith(".mp3") || content.at(n_element).endsWith(".mp4") || content.at(n_element).endsWith(".ogg") || content.at(n_element).endsWith(".opus"))
       {
+        musics_time = true;
+        w_courtroom->fix_last_area();
         w_courtroom->append_music(content.at(n_element));
+        areas--;
       }
       else
       {
-        if (content.at(n_element).endsWith(".wav") || content.at(n_element).endsWith(".mp3") || content.at(n_element).endsWith(".mp4") || content.at(n_element).endsWith(".ogg") || content.at(n_element).endsWith(".opus"))
-        {
-          musics_time = true;
-          w_courtroom->fix_last_area();
-          w_courtroom->append_music(content.at(n_element));
-          areas--;
-        }
-        else
-        {
-          w_courtroom->append_area(content.at(n_element));
-          areas++;
-        }
+        w_courtroom->append_area(content.at(n_element));
+        areas++;
       }
     }
+  }
 
-    for (int area_n = 0; area_n < areas; area_n++)
-    {
-      w_courtroom->arup_append(0, "Unknown", "Unknown", "Unknown");
-    }
+  for (int area_n = 0; area_n < areas; area_n++)
+  {
+    w_courtroom->arup_append(0, "Unknown", "Unknown", "Unknown");
+  }
 
-    send_server_packet(AOPacket("RD"));
+  send_server_packet(AOPacket("RD"));
 
-    // TODO : Implement username messaging and requirement server-side properly.
-    send_server_packet(AOPacket("CT", {Options::getInstance().username(), ""}));
-    log_to_demo = false;
-  }
-  else if (header == "FM") // Fetch music ONLY
+  // TODO : Implement username messaging and requirement server-side properly.
+  send_server_packet(AOPacket("CT", {Options::getInstance().username(), ""}));
+  return PacketResult::Accepted;
+}
+
+// Fetch music ONLY
+AOApplication::PacketResult AOApplication::handle_fm_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
   {
-    if (!is_courtroom_constructed())
-    {
-      return;
-    }
+    return PacketResult::Rejected;
+  }
 
-    w_courtroom->clear_music();
+  w_courtroom->clear_music();
 
-    for (int n_element = 0; n_element < content.size(); ++n_element)
-    {
-      w_courtroom->append_music(content.at(n_element));
-    }
+  for (int n_element = 0; n_element < content.size(); ++n_element)
+  {
+    w_courtroom->append_music(content.at(n_element));
+  }
+
+  w_courtroom->list_music();
+  return PacketResult::Accepted;
+}
 
-    w_courtroom->list_music();
-    log_to_demo = false;
+// Fetch areas ONLY
+AOApplication::PacketResult AOApplication::handle_fa_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
+  {
+    return PacketResult::Rejected;
   }
-  else if (header == "FA") // Fetch areas ONLY
+
+  w_courtroom->clear_areas();
+  w_courtroom->arup_clear();
+
+  for (int n_element = 0; n_element < content.size(); ++n_element)
   {
-    if (!is_courtroom_constructed())
-    {
-      return;
-    }
+    w_courtroom->append_area(content.at(n_element));
+    w_courtroom->arup_append(0, "Unknown", "Unknown", "Unknown");
+  }
 
-    w_courtroom->clear_areas();
-    w_courtroom->arup_clear();
+  w_courtroom->list_areas();
+  return PacketResult::Accepted;
+}
 
-    for (int n_element = 0; n_element < content.size(); ++n_element)
-    {
-      w_courtroom->append_area(content.at(n_element));
-      w_courtroom->arup_append(0, "Unknown", "Unknown", "Unknown");
-    }
+AOApplication::PacketResult AOApplication::handle_done_packet(QStringList &content)
+{
+  Q_UNUSED(content);
 
-    w_courtroom->list_areas();
-    log_to_demo = false;
-  }
-  else if (header == "DONE")
+  if (!is_courtroom_constructed())
   {
-    if (!is_courtroom_constructed())
-    {
-      return;
-    }
+    return PacketResult::Rejected;
+  }
 
-    w_courtroom->character_loading_finished();
-    w_courtroom->done_received();
+  w_courtroom->character_loading_finished();
+  w_courtroom->done_received();
 
-    courtroom_loaded = true;
+  courtroom_loaded = true;
 
-    destruct_lobby();
-    log_to_demo = false;
-  }
-  else if (header == "BN")
-  {
-    if (!is_courtroom_constructed() || content.isEmpty())
-    {
-      return;
-    }
+  destruct_lobby();
+  return PacketResult::Accepted;
+}
 
-    if (content.size() >= 2)
-    {
-      // We have a pos included in the background packet!
-      if (!content.at(1).isEmpty())
-      {
-        // Not touching it when its empty.
-        w_courtroom->set_side(content.at(1));
-      }
-    }
-    w_courtroom->set_background(content.at(0), content.size() >= 2);
+AOApplication::PacketResult AOApplication::handle_bn_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
+  {
+    return PacketResult::Rejected;
   }
-  else if (header == "SP")
+
+  if (content.size() >= 2)
   {
-    if (!is_courtroom_constructed() || content.isEmpty())
+    // We have a pos included in the background packet!
+    if (!content.at(1).isEmpty())
     {
-      return;
+      // Not touching it when its empty.
+      w_courtroom->set_side(content.at(1));
     }
-
-    // We were sent a "set position" packet
-    w_courtroom->set_side(content.at(0));
   }
-  else if (header == "SD") // Send pos dropdown
+  w_courtroom->set_background(content.at(0), content.size() >= 2);
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_sp_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
   {
-    if (!is_courtroom_constructed() || content.isEmpty())
-    {
-      return;
-    }
+    return PacketResult::Rejected;
+  }
 
-    w_courtroom->set_pos_dropdown(content.at(0).split("*"));
+  // We were sent a "set position" packet
+  w_courtroom->set_side(content.at(0));
+  return PacketResult::Accepted;
+}
+
+// Send pos dropdown
+AOApplication::PacketResult AOApplication::handle_sd_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
+  {
+    return PacketResult::Rejected;
   }
-  // server accepting char request(CC) packet
-  else if (header == "PV")
+
+  w_courtroom->set_pos_dropdown(content.at(0).split("*"));
+  return PacketResult::Accepted;
+}
+
+// server accepting char request(CC) packet
+AOApplication::PacketResult AOApplication::handle_pv_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
   {
-    if (!is_courtroom_constructed() || content.size() < 3)
-    {
-      return;
-    }
-    // For some reason, args 0 and 1 are not used (from tsu3 they're client ID and a string "CID")
-    w_courtroom->enter_courtroom();
-    w_courtroom->set_courtroom_size();
-    w_courtroom->update_character(content.at(2).toInt());
+    return PacketResult::Rejected;
   }
-  else if (header == "MS")
+  // For some reason, args 0 and 1 are not used (from tsu3 they're client ID and a string "CID")
+  w_courtroom->enter_courtroom();
+  w_courtroom->set_courtroom_size();
+  w_courtroom->update_character(content.at(2).toInt());
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_ms_packet(QStringList &content)
+{
+  if (is_courtroom_constructed() && courtroom_loaded)
   {
-    if (is_courtroom_constructed() && courtroom_loaded)
-    {
-      w_courtroom->chatmessage_enqueue(packet.content());
-    }
+    w_courtroom->chatmessage_enqueue(content);
   }
-  else if (header == "MC")
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_mc_packet(QStringList &content)
+{
+  if (is_courtroom_constructed() && courtroom_loaded)
   {
-    if (is_courtroom_constructed() && courtroom_loaded)
-    {
-      w_courtroom->handle_song(&packet.content());
-    }
+    w_courtroom->handle_song(&content);
   }
-  else if (header == "RT")
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_rt_packet(QStringList &content)
+{
+  if (is_courtroom_constructed())
   {
-    if (content.isEmpty())
+    if (content.size() == 1)
     {
-      return;
+      w_courtroom->handle_wtce(content.at(0), 0);
     }
-    if (is_courtroom_constructed())
+    else if (content.size() >= 2)
     {
-      if (content.size() == 1)
-      {
-        w_courtroom->handle_wtce(content.at(0), 0);
-      }
-      else if (content.size() >= 2)
-      {
-        w_courtroom->handle_wtce(content.at(0), content.at(1).toInt());
-      }
+      w_courtroom->handle_wtce(content.at(0), content.at(1).toInt());
     }
   }
-  else if (header == "HP")
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_hp_packet(QStringList &content)
+{
+  if (is_courtroom_constructed())
   {
-    if (is_courtroom_constructed() && content.size() >= 2)
-    {
-      w_courtroom->set_hp_bar(content.at(0).toInt(), content.at(1).toInt());
-    }
+    w_courtroom->set_hp_bar(content.at(0).toInt(), content.at(1).toInt());
   }
-  else if (header == "LE")
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_le_packet(QStringList &content)
+{
+  if (is_courtroom_constructed())
   {
-    if (is_courtroom_constructed())
-    {
-      QVector<EvidenceItem> f_evi_list;
+    QVector<EvidenceItem> f_evi_list;
 
-      for (const QString &f_string : packet.content())
+    for (const QString &f_string : content)
+    {
+      QStringList sub_contents = f_string.split("&");
+      if (sub_contents.size() < 3)
       {
-        QStringList sub_contents = f_string.split("&");
-        if (sub_contents.size() < 3)
-        {
-          continue;
-        }
-
-        // decoding has to be done here instead of on reception
-        // because this packet uses & as a delimiter for some reason
-        for (QString &data : sub_contents)
-        {
-          data = AOPacket::decode(data);
-        }
-
-        EvidenceItem f_evi;
-        f_evi.name = sub_contents.at(0);
-        f_evi.description = sub_contents.at(1);
-        f_evi.image = sub_contents.at(2);
-
-        f_evi_list.append(f_evi);
+        continue;
       }
 
-      w_courtroom->set_evidence_list(f_evi_list);
-    }
-  }
-  else if (header == "ARUP")
-  {
-    if (is_courtroom_constructed() && !content.isEmpty())
-    {
-      int arup_type = content.at(0).toInt();
-      for (int n_element = 1; n_element < content.size(); n_element++)
+      // decoding has to be done here instead of on reception
+      // because this packet uses & as a delimiter for some reason
+      for (QString &data : sub_contents)
       {
-        w_courtroom->arup_modify(arup_type, n_element - 1, content.at(n_element));
+        data = AOPacket::decode(data);
       }
-      w_courtroom->list_areas();
+
+      EvidenceItem f_evi;
+      f_evi.name = sub_contents.at(0);
+      f_evi.description = sub_contents.at(1);
+      f_evi.image = sub_contents.at(2);
+
+      f_evi_list.append(f_evi);
     }
-    log_to_demo = false;
+
+    w_courtroom->set_evidence_list(f_evi_list);
   }
-  else if (header == "IL")
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_arup_packet(QStringList &content)
+{
+  if (is_courtroom_constructed())
   {
-    if (is_courtroom_constructed() && !content.isEmpty())
+    int arup_type = content.at(0).toInt();
+    for (int n_element = 1; n_element < content.size(); n_element++)
     {
-      w_courtroom->set_ip_list(content.at(0));
+      w_courtroom->arup_modify(arup_type, n_element - 1, content.at(n_element));
     }
-    log_to_demo = false;
+    w_courtroom->list_areas();
   }
-  else if (header == "MU")
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_il_packet(QStringList &content)
+{
+  if (is_courtroom_constructed())
   {
-    if (is_courtroom_constructed() && !content.isEmpty())
-    {
-      w_courtroom->set_mute(true, content.at(0).toInt());
-    }
-    log_to_demo = false;
+    w_courtroom->set_ip_list(content.at(0));
   }
-  else if (header == "UM")
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_mu_packet(QStringList &content)
+{
+  if (is_courtroom_constructed())
   {
-    if (is_courtroom_constructed() && !content.isEmpty())
-    {
-      w_courtroom->set_mute(false, content.at(0).toInt());
-      log_to_demo = false;
-    }
+    w_courtroom->set_mute(true, content.at(0).toInt());
   }
-  else if (header == "BB")
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_um_packet(QStringList &content)
+{
+  // Only kept out of the demo once it unmuted someone, like it always was.
+  if (is_courtroom_constructed())
   {
-    if (is_courtroom_constructed() && !content.isEmpty())
-    {
-      call_notice(content.at(0));
-    }
-    log_to_demo = false;
+    w_courtroom->set_mute(false, content.at(0).toInt());
+    return PacketResult::AcceptedNoRecord;
   }
-  else if (header == "KK")
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_bb_packet(QStringList &content)
+{
+  if (is_courtroom_constructed())
   {
-    if (is_courtroom_constructed() && !content.isEmpty())
-    {
-      call_notice(tr("You have been kicked from the server.\nReason: %1").arg(content.at(0)));
-      construct_lobby();
-      destruct_courtroom();
-    }
-    log_to_demo = false;
+    call_notice(content.at(0));
   }
-  else if (header == "KB")
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_kk_packet(QStringList &content)
+{
+  if (is_courtroom_constructed())
   {
-    if (is_courtroom_constructed() && !content.isEmpty())
-    {
-      call_notice(tr("You have been banned from the server.\nReason: %1").arg(content.at(0)));
-      construct_lobby();
-      destruct_courtroom();
-    }
-    log_to_demo = false;
+    call_notice(tr("You have been kicked from the server.\nReason: %1").arg(content.at(0)));
+    construct_lobby();
+    destruct_courtroom();
   }
-  else if (header == "BD")
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_kb_packet(QStringList &content)
+{
+  if (is_courtroom_constructed())
   {
-    if (content.isEmpty())
-    {
-      return;
-    }
-    call_notice(tr("You are banned on this server.\nReason: %1").arg(content.at(0)));
-    log_to_demo = false;
+    call_notice(tr("You have been banned from the server.\nReason: %1").arg(content.at(0)));
+    construct_lobby();
+    destruct_courtroom();
   }
-  else if (header == "ZZ")
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_bd_packet(QStringList &content)
+{
+  call_notice(tr("You are banned on this server.\nReason: %1").arg(content.at(0)));
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_zz_packet(QStringList &content)
+{
+  if (is_courtroom_constructed())
   {
-    if (content.size() < 1)
-    {
-      return;
-    }
+    w_courtroom->mod_called(content.at(0));
+  }
+  return PacketResult::Accepted;
+}
 
-    if (is_courtroom_constructed() && !content.isEmpty())
-    {
-      w_courtroom->mod_called(content.at(0));
-    }
+// Timer packet
+AOApplication::PacketResult AOApplication::handle_ti_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
+  {
+    return PacketResult::Rejected;
   }
-  else if (header == "TI")
-  { // Timer packet
-    if (!is_courtroom_constructed() || content.size() < 2)
-    {
-      return;
-    }
 
-    // Timer ID is reserved as argument 0
-    int id = content.at(0).toInt();
+  // Timer ID is reserved as argument 0
+  int id = content.at(0).toInt();
 
-    // Type 0 = start/resume/sync timer at time
-    // Type 1 = pause timer at time
-    // Type 2 = show timer
-    // Type 3 = hide timer
-    int type = content.at(1).toInt();
+  // Type 0 = start/resume/sync timer at time
+  // Type 1 = pause timer at time
+  // Type 2 = show timer
+  // Type 3 = hide timer
+  int type = content.at(1).toInt();
 
-    if (type == 0 || type == 1)
+  if (type == 0 || type == 1)
+  {
+    if (content.size() < 3)
     {
-      if (content.size() < 3)
-      {
-        return;
-      }
+      return PacketResult::Rejected;
+    }
 
-      // The time as displayed on the clock, in milliseconds.
-      // If the number received is negative, stop the timer.
-      qint64 timer_value = content.at(2).toLongLong();
-      if (timer_value > 0)
+    // The time as displayed on the clock, in milliseconds.
+    // If the number received is negative, stop the timer.
+    qint64 timer_value = content.at(2).toLongLong();
+    if (timer_value > 0)
+    {
+      if (type == 0)
       {
-        if (type == 0)
-        {
-          timer_value -= latency / 2;
-          w_courtroom->start_clock(id, timer_value);
-        }
-        else
-        {
-          w_courtroom->pause_clock(id);
-          w_courtroom->set_clock(id, timer_value);
-        }
+        timer_value -= latency / 2;
+        w_courtroom->start_clock(id, timer_value);
       }
       else
       {
-        w_courtroom->stop_clock(id);
+        w_courtroom->pause_clock(id);
+        w_courtroom->set_clock(id, timer_value);
       }
     }
-    else if (type == 2)
-    {
-      w_courtroom->set_clock_visibility(id, true);
-    }
-    else if (type == 3)
+    else
     {
-      w_courtroom->set_clock_visibility(id, false);
+      w_courtroom->stop_clock(id);
     }
   }
-  else if (header == "CHECK")
+  else if (type == 2)
   {
-    if (!is_courtroom_constructed())
-    {
-      return;
-    }
-
-    qint64 ping_time = w_courtroom->pong();
-    qDebug() << "ping:" << ping_time;
-    if (ping_time != -1)
-    {
-      latency = ping_time;
-    }
-    log_to_demo = false;
+    w_courtroom->set_clock_visibility(id, true);
   }
-  // Subtheme packet
-  else if (header == "ST")
+  else if (type == 3)
   {
-    if (!is_courtroom_constructed() || content.isEmpty())
-    {
-      return;
-    }
-    // Subtheme reserved as argument 0
-    subtheme = content.at(0);
+    w_courtroom->set_clock_visibility(id, false);
+  }
+  return PacketResult::Accepted;
+}
 
-    // Check if we have subthemes set to "server"
-    if (Options::getInstance().settingsSubTheme().toLower() != "server")
-    {
-      // We don't. Simply acknowledge the subtheme sent by the server, but don't do anything else.
-      return;
-    }
+AOApplication::PacketResult AOApplication::handle_check_packet(QStringList &content)
+{
+  Q_UNUSED(content);
 
-    // Reload theme request
-    if (content.size() > 1 && content.at(1) == "1")
-    {
-      Options::getInstance().setServerSubTheme(subtheme);
-      w_courtroom->on_reload_theme_clicked();
-    }
+  if (!is_courtroom_constructed())
+  {
+    return PacketResult::Rejected;
   }
-  // Auth packet
-  else if (header == "AUTH")
+
+  qint64 ping_time = w_courtroom->pong();
+  qDebug() << "ping:" << ping_time;
+  if (ping_time != -1)
   {
-    if (!is_courtroom_constructed() || !m_serverdata.get_feature(server::BASE_FEATURE_SET::AUTH_PACKET) || content.isEmpty())
-    {
-      return;
-    }
-    bool ok;
-    int authenticated = content.at(0).toInt(&ok);
-    if (!ok)
-    {
-      qWarning() << "Malformed AUTH packet! Contents:" << content.at(0);
-    }
+    latency = ping_time;
+  }
+  return PacketResult::Accepted;
+}
 
-    w_courtroom->on_authentication_state_received(authenticated);
-    log_to_demo = false;
+// Subtheme packet
+AOApplication::PacketResult AOApplication::handle_st_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
+  {
+    return PacketResult::Rejected;
   }
-  else if (header == "JD")
+  // Subtheme reserved as argument 0
+  subtheme = content.at(0);
+
+  // Check if we have subthemes set to "server"
+  if (Options::getInstance().settingsSubTheme().toLower() != "server")
   {
-    if (!is_courtroom_constructed() || content.isEmpty())
-    {
-      return;
-    }
-    bool ok;
-    Courtroom::JudgeState state = static_cast<Courtroom::JudgeState>(content.at(0).toInt(&ok));
-    if (!ok)
-    {
-      return; // ignore malformed packet
-    }
-    w_courtroom->set_judge_state(state);
-    if (w_courtroom->get_judge_state() != Courtroom::POS_DEPENDENT)
-    { // If we receive JD -1, it means the server asks us to fall back to client-side judge buttons behavior
-      w_courtroom->show_judge_controls(w_courtroom->get_judge_state() == Courtroom::SHOW_CONTROLS);
-    }
-    else
-    {
-      w_courtroom->set_judge_buttons(); // client-side judge behavior
-    }
+    // We don't. Simply acknowledge the subtheme sent by the server, but don't do anything else.
+    return PacketResult::AcceptedNoRecord;
   }
 
-  // AssetURL Packet
-  else if (header == "ASS")
+  // Reload theme request
+  if (content.size() > 1 && content.at(1) == "1")
   {
-    if (content.size() > 1 || content.isEmpty())
-    { // This can never be more than one link.
-      return;
-    }
+    Options::getInstance().setServerSubTheme(subtheme);
+    w_courtroom->on_reload_theme_clicked();
+  }
+  return PacketResult::Accepted;
+}
 
-    m_serverdata.set_asset_url(content.at(0));
+// Auth packet
+AOApplication::PacketResult AOApplication::handle_auth_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed() || !m_serverdata.get_feature(server::BASE_FEATURE_SET::AUTH_PACKET))
+  {
+    return PacketResult::Rejected;
   }
-  else if (header == "PR")
+  bool ok;
+  int authenticated = content.at(0).toInt(&ok);
+  if (!ok)
   {
-    if (content.size() < 2 || !is_courtroom_constructed())
-    {
-      return;
-    }
+    qWarning() << "Malformed AUTH packet! Contents:" << content.at(0);
+  }
+
+  w_courtroom->on_authentication_state_received(authenticated);
+  return PacketResult::Accepted;
+}
 
-    PlayerRegister update{content.at(0).toInt(), PlayerRegister::REGISTER_TYPE(content.at(1).toInt())};
-    w_courtroom->playerList()->registerPlayer(update);
+AOApplication::PacketResult AOApplication::handle_jd_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
+  {
+    return PacketResult::Rejected;
   }
-  else if (header == "PU")
+  bool ok;
+  Courtroom::JudgeState state = static_cast<Courtroom::JudgeState>(content.at(0).toInt(&ok));
+  if (!ok)
   {
-    if (content.size() < 3 || !is_courtroom_constructed())
-    {
-      return;
-    }
+    return PacketResult::Rejected; // ignore malformed packet
+  }
+  w_courtroom->set_judge_state(state);
+  if (w_courtroom->get_judge_state() != Courtroom::POS_DEPENDENT)
+  { // If we receive JD -1, it means the server asks us to fall back to client-side judge buttons behavior
+    w_courtroom->show_judge_controls(w_courtroom->get_judge_state() == Courtroom::SHOW_CONTROLS);
+  }
+  else
+  {
+    w_courtroom->set_judge_buttons(); // client-side judge behavior
+  }
+  return PacketResult::Accepted;
+}
+
+// AssetURL Packet
+AOApplication::PacketResult AOApplication::handle_ass_packet(QStringList &content)
+{
+  if (content.size() > 1)
+  { // This can never be more than one link.
+    return PacketResult::Rejected;
+  }
+
+  m_serverdata.set_asset_url(content.at(0));
+  return PacketResult::Accepted;
+}
 
-    PlayerUpdate update{content.at(0).toInt(), PlayerUpdate::DATA_TYPE(content.at(1).toInt()), content.at(2)};
-    w_courtroom->playerList()->updatePlayer(update);
+AOApplication::PacketResult AOApplication::handle_pr_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
+  {
+    return PacketResult::Rejected;
   }
 
-  if (log_to_demo)
+  PlayerRegister update{content.at(0).toInt(), PlayerRegister::REGISTER_TYPE(content.at(1).toInt())};
+  w_courtroom->playerList()->registerPlayer(update);
+  return PacketResult::Accepted;
+}
+
+AOApplication::PacketResult AOApplication::handle_pu_packet(QStringList &content)
+{
+  if (!is_courtroom_constructed())
   {
-    append_to_demofile(packet.toString(true));
+    return PacketResult::Rejected;
   }
+
+  PlayerUpdate update{content.at(0).toInt(), PlayerUpdate::DATA_TYPE(content.at(1).toInt()), content.at(2)};
+  w_courtroom->playerList()->updatePlayer(update);
+  return PacketResult::Accepted;
 }
 
 void AOApplication::send_server_packet(AOPacket p_packet)
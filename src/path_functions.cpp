@@ -2,11 +2,14 @@
 #include "courtroom.h"
 #include "file_functions.h"
 #include "options.h"
+#include "samplecache.h"
+#include "tracer.h"
 
 #include <QDir>
 #include <QRegularExpression>
 #include <QStandardPaths>
 #include <QStringBuilder>
+#include <QtConcurrent/QtConcurrent>
 
 #ifdef BASE_OVERRIDE
 #include "base_override.h"
@@ -264,27 +267,29 @@ QString AOApplication::get_sfx_path(QVector<VPath> pathlist)
 
 QString AOApplication::get_config_value(QString p_identifier, QString p_config, QString p_theme, QString p_subtheme, QString p_default_theme, QString p_misc)
 {
-  QString path;
-  //    qDebug() << "got request for" << p_identifier << "in" << p_config;
+  return get_theme_config(p_config, p_theme, p_subtheme, p_default_theme, p_misc)->value(p_identifier);
+}
+
+std::shared_ptr<const ThemeConfig> AOApplication::get_theme_config(QString p_config, QString p_theme, QString p_subtheme, QString p_default_theme, QString p_misc)
+{
+  const QString key = p_config % QChar('|') % p_theme % QChar('|') % p_subtheme % QChar('|') % p_default_theme % QChar('|') % p_misc;
+  std::shared_ptr<const ThemeConfig> config = ThemeConfigCache::getInstance().find(key);
+  if (config)
+  {
+    return config;
+  }
+
+  QStringList files;
   const auto paths = get_asset_paths(p_config, p_theme, p_subtheme, p_default_theme, p_misc);
   for (const VPath &p : paths)
   {
-    path = get_real_path(p);
+    QString path = get_real_path(p);
     if (!path.isEmpty())
     {
-      QSettings settings(path, QSettings::IniFormat);
-      QVariant value = settings.value(p_identifier);
-      if (value.typeId() == QMetaType::QStringList)
-      {
-        return value.toStringList().join(",");
-      }
-      else if (!value.isNull())
-      {
-        return value.toString();
-      }
+      files.append(path);
     }
   }
-  return "";
+  return ThemeConfigCache::getInstance().insert(key, files);
 }
 
 QString AOApplication::get_asset(QString p_element, QString p_theme, QString p_subtheme, QString p_default_theme, QString p_misc, QString p_character, QString p_placeholder)
@@ -368,8 +373,114 @@ QString AOApplication::get_case_sensitive_path(QString p_file)
   return file_parent_dir + "/" + file_basename;
 }
 
+void AOApplication::refresh_asset_index()
+{
+  // The old index does not reflect the new mount paths, so stop using it
+  // right away and probe the mount paths until the new one is ready.
+  asset_index.reset();
+  asset_lookup_cache.clear();
+  asset_miss_cache.clear();
+  dir_listing_cache.clear();
+  dir_listing_exist_cache.clear();
+  ThemeConfigCache::getInstance().clear();
+  EffectTableCache::getInstance().clear();
+  SampleCache::getInstance().clear();
+
+  // Only one build may write the index cache at a time. A build that is
+  // still running is left to finish and the new one starts after it.
+  if (asset_index_watcher->isRunning())
+  {
+    asset_index_refresh_pending = true;
+    return;
+  }
+  start_asset_index_build();
+}
+
+void AOApplication::start_asset_index_build()
+{
+  QStringList mounts = Options::getInstance().mountPaths();
+  mounts.prepend(get_base_path());
+
+  asset_index_refresh_pending = false;
+  asset_index_watcher->setFuture(QtConcurrent::run(&AssetIndex::build, mounts, get_base_path() + "asset_index.cache"));
+}
+
+void AOApplication::asset_index_finished()
+{
+  if (asset_index_refresh_pending)
+  {
+    start_asset_index_build();
+    return;
+  }
+  asset_index = asset_index_watcher->result();
+  asset_miss_cache.clear();
+}
+
+void AOApplication::wait_for_asset_index()
+{
+  asset_index_watcher->waitForFinished();
+  if (asset_index_refresh_pending)
+  {
+    start_asset_index_build();
+    asset_index_watcher->waitForFinished();
+  }
+  asset_index = asset_index_watcher->result();
+  asset_miss_cache.clear();
+}
+
+std::shared_ptr<const AssetIndex> AOApplication::get_asset_index() const
+{
+  return asset_index;
+}
+
+QString AOApplication::find_real_path(const AssetIndex *index, const QStringList &mounts, const QString &vpath, const QStringList &suffixes)
+{
+  if (index)
+  {
+    return index->find(vpath, suffixes);
+  }
+
+  for (auto it = mounts.crbegin(); it != mounts.crend(); ++it)
+  {
+    QDir baseDir(*it);
+    for (const QString &suffix : suffixes)
+    {
+      QString path = baseDir.absoluteFilePath(vpath + suffix);
+      if (!path.startsWith(baseDir.absolutePath()))
+      {
+        break;
+      }
+      if (exists(path))
+      {
+        return path;
+      }
+    }
+  }
+  return QString();
+}
+
 QString AOApplication::get_real_path(const VPath &vpath, const QStringList &suffixes)
 {
+  AO_TRACE_SCOPE_ARG("AOApplication::get_real_path", vpath.toQString());
+  ++asset_lookups;
+  if (asset_index)
+  {
+    QString path = asset_index->find(vpath.toQString(), suffixes);
+    if (!path.isEmpty())
+    {
+      return path;
+    }
+    // Files added after the index was built are not in it, so a miss still
+    // probes the mount paths below, but only once until the next refresh.
+  }
+
+  const size_t miss_key = qHashMulti(0, vpath.toQString(), suffixes);
+  if (asset_miss_cache.contains(miss_key))
+  {
+    ++asset_lookup_misses;
+    return QString();
+  }
+
   // Try cache first
   QString phys_path = asset_lookup_cache.value(qHash(vpath));
   if (!phys_path.isEmpty() && exists(phys_path))
@@ -429,5 +540,7 @@ QString AOApplication::get_real_path(const VPath &vpath, const QStringList &suff
   }
 
   // File or directory not found
+  asset_miss_cache.insert(miss_key);
+  ++asset_lookup_misses;
   return QString();
 }
@@ -0,0 +1,177 @@
+#include "samplecache.h"
+
+#include "tracer.h"
+
+#include <bassopus.h>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+SampleCache &SampleCache::getInstance()
+{
+  static SampleCache instance;
+  return instance;
+}
+
+SampleCache::SampleCache()
+    : m_thread_pool(new QThreadPool(QCoreApplication::instance()))
+    , m_samples(DEFAULT_BUDGET)
+{
+  m_thread_pool->setMaxThreadCount(PRELOAD_THREADS);
+}
+
+HSTREAM SampleCache::createStream(const QString &fileName, DWORD flags)
+{
+  AO_TRACE_SCOPE_ARG("SampleCache::createStream", fileName);
+  std::shared_ptr<const QByteArray> data = sample(fileName);
+  if (!data)
+  {
+    return createFileStream(fileName, flags);
+  }
+
+  const DWORD memory_flags = flags & ~(BASS_UNICODE | BASS_ASYNCFILE);
+  HSTREAM stream;
+  if (fileName.endsWith(".opus"))
+  {
+    stream = BASS_OPUS_StreamCreateFile(TRUE, data->constData(), 0, data->size(), memory_flags);
+  }
+  else
+  {
+    stream = BASS_StreamCreateFile(TRUE, data->constData(), 0, data->size(), memory_flags);
+  }
+
+  if (!stream)
+  {
+    return createFileStream(fileName, flags);
+  }
+
+  // The stream reads straight from the cached data, so it must stay alive
+  // until the stream is freed, even if the cache evicts it in the meantime.
+  auto *reference = new std::shared_ptr<const QByteArray>(data);
+  if (!BASS_ChannelSetSync(stream, BASS_SYNC_FREE | BASS_SYNC_MIXTIME, 0, releaseSample, reference))
+  {
+    BASS_StreamFree(stream);
+    delete reference;
+    return createFileStream(fileName, flags);
+  }
+
+  return stream;
+}
+
+void SampleCache::preload(const QStringList &fileNames)
+{
+  for (const QString &file_name : fileNames)
+  {
+    if (file_name.isEmpty())
+    {
+      continue;
+    }
+
+    {
+      QMutexLocker locker(&m_lock);
+      if (m_samples.contains(file_name) || m_pending.contains(file_name))
+      {
+        continue;
+      }
+      m_pending.insert(file_name);
+    }
+
+    m_thread_pool->start([this, file_name] { load(file_name); });
+  }
+}
+
+void SampleCache::clear()
+{
+  QMutexLocker locker(&m_lock);
+  m_samples.clear();
+}
+
+qsizetype SampleCache::budget()
+{
+  QMutexLocker locker(&m_lock);
+  return m_samples.maxCost();
+}
+
+void SampleCache::setBudget(qsizetype bytes)
+{
+  QMutexLocker locker(&m_lock);
+  m_samples.setMaxCost(bytes);
+}
+
+std::shared_ptr<const QByteArray> SampleCache::sample(const QString &fileName)
+{
+  const QFileInfo info(fileName);
+  if (info.size() <= 0 || info.size() > MAXIMUM_SAMPLE_SIZE)
+  {
+    return nullptr;
+  }
+  const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+
+  {
+    QMutexLocker locker(&m_lock);
+    // A file that is still loading is streamed from disk this time.
+    if (m_pending.contains(fileName))
+    {
+      return nullptr;
+    }
+
+    if (Sample *sample = m_samples.object(fileName); sample && sample->modified == modified)
+    {
+      return sample->data;
+    }
+    m_pending.insert(fileName);
+  }
+
+  m_thread_pool->start([this, fileName] { load(fileName); });
+  return nullptr;
+}
+
+void SampleCache::load(const QString &fileName)
+{
+  // The caller marked fileName as pending.
+  std::shared_ptr<const QByteArray> data;
+  qint64 modified = 0;
+
+  QFile file(fileName);
+  if (file.size() <= MAXIMUM_SAMPLE_SIZE && file.open(QIODevice::ReadOnly))
+  {
+    modified = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+    data = std::make_shared<const QByteArray>(file.readAll());
+    if (data->isEmpty())
+    {
+      data.reset();
+    }
+  }
+
+  QMutexLocker locker(&m_lock);
+  if (data)
+  {
+    m_samples.insert(fileName, new Sample{data, modified}, data->size());
+  }
+  else
+  {
+    m_samples.remove(fileName);
+  }
+  m_pending.remove(fileName);
+}
+
+HSTREAM SampleCache::createFileStream(const QString &fileName, DWORD flags)
+{
+  if (fileName.endsWith(".opus"))
+  {
+    return BASS_OPUS_StreamCreateFile(FALSE, fileName.utf16(), 0, 0, flags);
+  }
+  return BASS_StreamCreateFile(FALSE, fileName.utf16(), 0, 0, flags);
+}
+
+void CALLBACK SampleCache::releaseSample(HSYNC handle, DWORD channel, DWORD data, void *user)
+{
+  Q_UNUSED(handle);
+  Q_UNUSED(channel);
+  Q_UNUSED(data);
+
+  delete static_cast<std::shared_ptr<const QByteArray> *>(user);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <bass.h>
+
+#include <QByteArray>
+#include <QCache>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <memory>
+
+/**
+ * @brief Keeps short sound files in memory so they can be played without
+ * touching the disk.
+ *
+ * @details Streams are created from the cached file data. Files that are not
+ * cached yet are streamed from disk while they load in the background, so
+ * creating a stream never waits for a load. Files are evicted
+ * least recently used first once the cache exceeds its byte budget; streams
+ * that are still playing keep their data alive until they are freed. Files
+ * larger than MAXIMUM_SAMPLE_SIZE are always streamed from disk, and files
+ * modified since they were cached are loaded again.
+ */
+class SampleCache
+{
+public:
+  static constexpr qsizetype DEFAULT_BUDGET = 32 * 1024 * 1024;
+  static constexpr qint64 MAXIMUM_SAMPLE_SIZE = 1024 * 1024;
+  static constexpr int PRELOAD_THREADS = 2;
+
+  static SampleCache &getInstance();
+
+  /**
+   * @brief Creates a stream playing fileName.
+   *
+   * @details If the file is not cached, the stream reads it from disk and
+   * the file is loaded into the cache in the background if it is small
+   * enough.
+   *
+   * @param flags BASS stream flags, as passed to BASS_StreamCreateFile.
+   */
+  HSTREAM createStream(const QString &fileName, DWORD flags);
+
+  /// Loads fileNames into the cache in the background.
+  void preload(const QStringList &fileNames);
+
+  void clear();
+
+  qsizetype budget();
+  void setBudget(qsizetype bytes);
+
+private:
+  class Sample
+  {
+  public:
+    std::shared_ptr<const QByteArray> data;
+    qint64 modified = 0;
+  };
+
+  QThreadPool *m_thread_pool;
+
+  QMutex m_lock;
+  QCache<QString, Sample> m_samples;
+  QSet<QString> m_pending;
+
+  SampleCache();
+
+  std::shared_ptr<const QByteArray> sample(const QString &fileName);
+  void load(const QString &fileName);
+
+  static HSTREAM createFileStream(const QString &fileName, DWORD flags);
+  static void CALLBACK releaseSample(HSYNC handle, DWORD channel, DWORD data, void *user);
+};
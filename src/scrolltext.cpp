@@ -3,6 +3,7 @@
 ScrollText::ScrollText(QWidget *parent)
     : QWidget(parent)
     , scrollPos(0)
+    , scrollTime(0)
 {
   staticText.setTextFormat(Qt::PlainText);
 
@@ -10,9 +11,11 @@ ScrollText::ScrollText(QWidget *parent)
   leftMargin = height() / 3;
 
   setSeparator("   ---   ");
+}
 
-  connect(&timer, &QTimer::timeout, this, &ScrollText::timer_timeout);
-  timer.setInterval(50);
+ScrollText::~ScrollText()
+{
+  kal::AnimationClock::getInstance().stop(this);
 }
 
 QString ScrollText::text() const
@@ -41,7 +44,7 @@ void ScrollText::setSeparator(QString separator)
 
 void ScrollText::updateText()
 {
-  timer.stop();
+  kal::AnimationClock::getInstance().stop(this);
 
   singleTextWidth = fontMetrics().horizontalAdvance(m_text);
   scrollEnabled = (singleTextWidth > width() - leftMargin * 2);
@@ -50,7 +53,8 @@ void ScrollText::updateText()
   {
     scrollPos = -64;
     staticText.setText(m_text + _separator);
-    timer.start();
+    scrollTime = kal::AnimationClock::getInstance().time();
+    kal::AnimationClock::getInstance().start(this, SCROLL_INTERVAL);
   }
   else
   {
@@ -140,8 +144,22 @@ void ScrollText::resizeEvent(QResizeEvent *)
   }
 }
 
-void ScrollText::timer_timeout()
+void ScrollText::clockTick(qint64 time)
 {
-  scrollPos = (scrollPos + 2) % wholeTextSize.width();
+  // Scrolls by 2 pixels every SCROLL_INTERVAL milliseconds. The clock may tick
+  // slightly early, so a step that is due within half an interval is taken.
+  qint64 steps = (time - scrollTime + SCROLL_INTERVAL / 2) / SCROLL_INTERVAL;
+  if (steps < 1)
+  {
+    return;
+  }
+  scrollTime += steps * SCROLL_INTERVAL;
+  if (steps > kal::AnimationClock::MAXIMUM_CATCH_UP_STEPS)
+  {
+    steps = kal::AnimationClock::MAXIMUM_CATCH_UP_STEPS;
+    scrollTime = time;
+  }
+
+  scrollPos = (scrollPos + 2 * int(steps)) % wholeTextSize.width();
   update();
 }
@@ -1,12 +1,14 @@
 #pragma once
 
+#include "animationclock.h"
+
 #include <QDebug>
 #include <QPainter>
 #include <QStaticText>
-#include <QTimer>
 #include <QWidget>
 
 class ScrollText : public QWidget
+    , public kal::AnimationClock::Client
 {
   Q_OBJECT
 
@@ -15,6 +17,7 @@ class ScrollText : public QWidget
 
 public:
   explicit ScrollText(QWidget *parent = nullptr);
+  ~ScrollText();
 
   QString text() const;
   QString separator() const;
@@ -29,10 +32,14 @@ public Q_SLOTS:
   void setSeparator(QString separator);
 
 protected:
+  void clockTick(qint64 time) override;
   virtual void paintEvent(QPaintEvent *);
   virtual void resizeEvent(QResizeEvent *);
 
 private:
+  // Milliseconds between two scroll steps.
+  static constexpr int SCROLL_INTERVAL = 50;
+
   QString m_text;
   QString _separator;
   QStaticText staticText;
@@ -43,10 +50,7 @@ private:
   int scrollPos;
   QImage alphaChannel;
   QImage buffer;
-  QTimer timer;
+  qint64 scrollTime;
 
   void updateText();
-
-private Q_SLOTS:
-  virtual void timer_timeout();
 };
@@ -1,23 +1,69 @@
 #include <serverdata.h>
 
+#include <QHash>
+#include <QMetaEnum>
 #include <QUrl>
-#include <QVariant>
 
 namespace server
 {
+namespace
+{
+/// Maps the lowercase name of every standard feature to its index.
+const QHash<QString, int> &base_feature_names()
+{
+  static const QHash<QString, int> names = [] {
+    QHash<QString, int> result;
+    const QMetaEnum meta_enum = QMetaEnum::fromType<BASE_FEATURE_SET>();
+    for (int i = 0; i < meta_enum.keyCount(); ++i)
+    {
+      if (meta_enum.value(i) >= BASE_FEATURE_COUNT)
+      {
+        continue;
+      }
+      result.insert(QString::fromLatin1(meta_enum.key(i)).toLower(), meta_enum.value(i));
+    }
+    return result;
+  }();
+  return names;
+}
+} // namespace
+
 bool ServerData::get_feature(const BASE_FEATURE_SET &f_feature) const
 {
-  return get_feature(QVariant::fromValue(f_feature).toString());
+  return m_features.test(static_cast<std::size_t>(f_feature));
 }
 
 bool ServerData::get_feature(const QString &f_feature) const
 {
-  return m_features.contains(f_feature, Qt::CaseInsensitive);
+  const QString l_feature = f_feature.toLower();
+  auto it = base_feature_names().constFind(l_feature);
+  if (it != base_feature_names().constEnd())
+  {
+    return m_features.test(it.value());
+  }
+  return m_extra_features.contains(l_feature);
 }
 
 void ServerData::set_features(const QStringList &f_feature_list)
 {
-  m_features = f_feature_list;
+  std::bitset<BASE_FEATURE_COUNT> l_features;
+  QSet<QString> l_extra_features;
+  for (const QString &i_feature : f_feature_list)
+  {
+    const QString l_feature = i_feature.toLower();
+    auto it = base_feature_names().constFind(l_feature);
+    if (it != base_feature_names().constEnd())
+    {
+      l_features.set(it.value());
+    }
+    else
+    {
+      l_extra_features.insert(l_feature);
+    }
+  }
+
+  m_features = l_features;
+  m_extra_features = l_extra_features;
 }
 
 void ServerData::set_server_software(const QString &newServer_software)
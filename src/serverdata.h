@@ -2,9 +2,12 @@
 #define SERVERDATA_H
 
 #include <QObject>
+#include <QSet>
 #include <QString>
 #include <QStringList>
 
+#include <bitset>
+
 namespace server
 {
 Q_NAMESPACE
@@ -61,11 +64,17 @@ enum class BASE_FEATURE_SET
   AUTH_PACKET,        ///< Enables the use of the AUTH packet.
                       ///< @since 2.9.1
   PREZOOM,            ///< Preanim zoom.
-  CUSTOM_BLIPS        ///< Allows the in-character messages to contain data about
+  CUSTOM_BLIPS,       ///< Allows the in-character messages to contain data about
                       ///< what blips to use for the character's current message.
+  COUNT               ///< Not a feature; the number of features. New features go
+                      ///< before it.
 };
 Q_ENUM_NS(BASE_FEATURE_SET)
 
+/// The number of features in BASE_FEATURE_SET.
+constexpr int BASE_FEATURE_COUNT = static_cast<int>(BASE_FEATURE_SET::COUNT);
+static_assert(BASE_FEATURE_COUNT > static_cast<int>(BASE_FEATURE_SET::CUSTOM_BLIPS), "COUNT must be the last enumerator of BASE_FEATURE_SET");
+
 /**
  * @brief Arranges data about the server the client is connected to.
  */
@@ -75,8 +84,8 @@ public:
   /**
    * @brief Returns true if one of the standard features exists on the server.
    *
-   * @details Internally, this calls get_feature(const QString &f_feature)
-   * with the enum's value converted to string.
+   * @details This is a single bit lookup, so it is cheap enough to call on
+   * every message.
    *
    * @param f_feature The feature to check for.
    *
@@ -135,8 +144,11 @@ public:
   void set_asset_url(const QString &f_asset_url);
 
 private:
-  /// The features available on the server. Determines what
-  QStringList m_features;
+  /// The standard features available on the server.
+  std::bitset<BASE_FEATURE_COUNT> m_features;
+
+  /// Lowercase names of the features this client doesn't know about.
+  QSet<QString> m_extra_features;
 
   /// The software the server is running.
   QString m_server_software;
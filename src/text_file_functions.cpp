@@ -1,12 +1,13 @@
 #include "aoapplication.h"
 
-#include "aoutils.h"
 #include "file_functions.h"
 #include "options.h"
+#include "tracer.h"
 
 #include <QColor>
 #include <QDebug>
 #include <QSettings>
+#include <QStringBuilder>
 #include <QStringList>
 #include <QTextStream>
 #include <QVector>
@@ -94,43 +95,6 @@ bool AOApplication::write_to_file(QString p_text, QString p_file, bool make_dir)
   return false;
 }
 
-bool AOApplication::append_to_file(QString p_text, QString p_file, bool make_dir)
-{
-  if (!file_exists(p_file)) // Don't create a newline if file didn't exist before now
-  {
-    return write_to_file(p_text, p_file, make_dir);
-  }
-  QString path = QFileInfo(p_file).path();
-  // Create the dir if it doesn't exist yet
-  if (make_dir)
-  {
-    QDir dir(path);
-    if (!dir.exists())
-    {
-      if (!dir.mkpath("."))
-      {
-        return false;
-      }
-    }
-  }
-
-  QFile f_log(p_file);
-  if (f_log.open(QIODevice::WriteOnly | QIODevice::Append))
-  {
-    QTextStream out(&f_log);
-
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    out.setCodec("UTF-8");
-#endif
-    out << "\r\n" << p_text;
-
-    f_log.flush();
-    f_log.close();
-    return true;
-  }
-  return false;
-}
-
 QMultiMap<QString, QString> AOApplication::load_demo_logs_list() const
 {
   QString l_log_path = get_app_path() + "/logs/";
@@ -159,17 +123,17 @@ QString AOApplication::read_design_ini(QString p_identifier, VPath p_design_path
 
 QString AOApplication::read_design_ini(QString p_identifier, QString p_design_path)
 {
-  QSettings settings(p_design_path, QSettings::IniFormat);
-  QVariant value = settings.value(p_identifier);
-  if (value.typeId() == QMetaType::QStringList)
+  if (p_design_path.isEmpty())
   {
-    return value.toStringList().join(",");
+    return "";
   }
-  else if (!value.isNull())
+
+  std::shared_ptr<const ThemeConfig> config = ThemeConfigCache::getInstance().find(p_design_path);
+  if (!config)
   {
-    return value.toString();
+    config = ThemeConfigCache::getInstance().insert(p_design_path, {p_design_path});
   }
-  return "";
+  return config->value(p_identifier);
 }
 
 RESIZE_MODE AOApplication::get_scaling(QString p_scaling)
@@ -192,53 +156,12 @@ RESIZE_MODE AOApplication::get_scaling(QString p_scaling)
 
 QPoint AOApplication::get_button_spacing(QString p_identifier, QString p_file)
 {
-  QString value = get_config_value(p_identifier, p_file, Options::getInstance().theme(), Options::getInstance().subTheme(), default_theme);
-  QPoint return_value;
-
-  return_value.setX(0);
-  return_value.setY(0);
-
-  if (value == "")
-  {
-    return return_value;
-  }
-
-  QStringList sub_line_elements = value.split(",");
-
-  if (sub_line_elements.size() < 2)
-  {
-    return return_value;
-  }
-  return_value.setX(sub_line_elements.at(0).toInt() * Options::getInstance().themeScalingFactor());
-  return_value.setY(sub_line_elements.at(1).toInt() * Options::getInstance().themeScalingFactor());
-
-  return return_value;
+  return get_theme_config(p_file, Options::getInstance().theme(), Options::getInstance().subTheme(), default_theme)->point(p_identifier, Options::getInstance().themeScalingFactor());
 }
 
 pos_size_type AOApplication::get_element_dimensions(QString p_identifier, QString p_file, QString p_misc)
 {
-  pos_size_type return_value;
-  return_value.x = 0;
-  return_value.y = 0;
-  return_value.width = -1;
-  return_value.height = -1;
-  QString f_result = get_design_element(p_identifier, p_file, p_misc);
-
-  QStringList sub_line_elements = f_result.split(",");
-
-  if (sub_line_elements.size() < 4)
-  {
-    return return_value;
-  }
-
-  int scale = Options::getInstance().themeScalingFactor();
-
-  return_value.x = sub_line_elements.at(0).toInt() * scale;
-  return_value.y = sub_line_elements.at(1).toInt() * scale;
-  return_value.width = sub_line_elements.at(2).toInt() * scale;
-  return_value.height = sub_line_elements.at(3).toInt() * scale;
-
-  return return_value;
+  return get_theme_config(p_file, Options::getInstance().theme(), Options::getInstance().subTheme(), default_theme, p_misc)->dimensions(p_identifier, Options::getInstance().themeScalingFactor());
 }
 QString AOApplication::get_design_element(QString p_identifier, QString p_file, QString p_misc)
 {
@@ -252,26 +175,7 @@ QString AOApplication::get_design_element(QString p_identifier, QString p_file,
 
 QColor AOApplication::get_color(QString p_identifier, QString p_file)
 {
-  QString value = get_config_value(p_identifier, p_file, Options::getInstance().theme(), Options::getInstance().subTheme(), default_theme);
-  QColor return_color(0, 0, 0);
-
-  if (value.isEmpty())
-  {
-    return return_color;
-  }
-
-  QStringList color_list = value.split(",");
-
-  if (color_list.size() < 3)
-  {
-    return return_color;
-  }
-
-  return_color.setRed(color_list.at(0).toInt());
-  return_color.setGreen(color_list.at(1).toInt());
-  return_color.setBlue(color_list.at(2).toInt());
-
-  return return_color;
+  return get_theme_config(p_file, Options::getInstance().theme(), Options::getInstance().subTheme(), default_theme)->color(p_identifier);
 }
 
 QString AOApplication::get_stylesheet(QString p_file)
@@ -408,14 +312,13 @@ QString AOApplication::get_image_suffix(VPath path_to_check, bool static_image)
 // be found
 QString AOApplication::read_char_ini(QString p_char, QString p_search_line, QString target_tag)
 {
-  QSettings settings(get_real_path(get_character_path(p_char, "char.ini")), QSettings::IniFormat);
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-  settings.setIniCodec("UTF-8");
-#endif
-  settings.beginGroup(target_tag);
-  QString value = settings.value(p_search_line).value<QString>();
-  settings.endGroup();
-  return value;
+  AO_TRACE_SCOPE_ARG("AOApplication::read_char_ini", p_char + "/[" + target_tag + "]/" + p_search_line);
+  return get_char_ini(p_char)->value(target_tag, p_search_line);
+}
+
+std::shared_ptr<const CharacterIni> AOApplication::get_char_ini(QString p_char)
+{
+  return CharacterIniCache::getInstance().get(get_real_path(get_character_path(p_char, "char.ini")));
 }
 
 // returns all the values of target_tag
@@ -445,16 +348,17 @@ QStringList AOApplication::read_ini_tags(VPath p_path, QString target_tag)
 
 QString AOApplication::get_showname(QString p_char, int p_emote)
 {
-  QString f_result = read_char_ini(p_char, "showname", "Options");
-  QString f_needed = read_char_ini(p_char, "needs_showname", "Options");
+  std::shared_ptr<const CharacterIni> char_ini = get_char_ini(p_char);
+  QString f_result = char_ini->option("showname");
+  QString f_needed = char_ini->option("needs_showname");
 
   if (p_emote != -1)
   {
-    int override_idx = read_char_ini(p_char, QString::number(p_emote + 1), "OptionsN").toInt();
+    int override_idx = char_ini->value("OptionsN", QString::number(p_emote + 1)).toInt();
     if (override_idx > 0)
     {
       QString override_key = "Options" + QString::number(override_idx);
-      QString temp_f_result = read_char_ini(p_char, "showname", override_key);
+      QString temp_f_result = char_ini->value(override_key, "showname");
       if (!temp_f_result.isEmpty())
       {
         f_result = temp_f_result;
@@ -475,7 +379,7 @@ QString AOApplication::get_showname(QString p_char, int p_emote)
 
 QString AOApplication::get_char_side(QString p_char)
 {
-  QString f_result = read_char_ini(p_char, "side", "Options");
+  QString f_result = get_char_ini(p_char)->option("side");
 
   if (f_result == "")
   {
@@ -486,15 +390,16 @@ QString AOApplication::get_char_side(QString p_char)
 
 QString AOApplication::get_blipname(QString p_char, int p_emote)
 {
-  QString f_result = read_char_ini(p_char, "blips", "Options");
+  std::shared_ptr<const CharacterIni> char_ini = get_char_ini(p_char);
+  QString f_result = char_ini->option("blips");
 
   if (p_emote != -1)
   {
-    int override_idx = read_char_ini(p_char, QString::number(p_emote + 1), "OptionsN").toInt();
+    int override_idx = char_ini->value("OptionsN", QString::number(p_emote + 1)).toInt();
     if (override_idx > 0)
     {
       QString override_key = "Options" + QString::number(override_idx);
-      QString temp_f_result = read_char_ini(p_char, "blips", override_key);
+      QString temp_f_result = char_ini->value(override_key, "blips");
       if (!temp_f_result.isEmpty())
       {
         f_result = temp_f_result;
@@ -504,7 +409,7 @@ QString AOApplication::get_blipname(QString p_char, int p_emote)
 
   if (f_result == "")
   {
-    f_result = read_char_ini(p_char, "gender", "Options"); // not very PC, FanatSors
+    f_result = char_ini->option("gender"); // not very PC, FanatSors
     if (f_result == "")
     {
       f_result = "male";
@@ -528,11 +433,11 @@ QString AOApplication::get_blips(QString p_blipname)
 
 QString AOApplication::get_emote_property(QString p_char, QString p_emote, QString p_property)
 {
-  QString f_result = read_char_ini(p_char, p_emote, p_property); // per-emote override
+  std::shared_ptr<const CharacterIni> char_ini = get_char_ini(p_char);
+  QString f_result = char_ini->value(p_property, p_emote); // per-emote override
   if (f_result == "")
   {
-    f_result = read_char_ini(p_char, p_property,
-                             "Options"); // global for this character
+    f_result = char_ini->option(p_property); // global for this character
   }
   return f_result;
 }
@@ -555,7 +460,7 @@ RESIZE_MODE AOApplication::get_misc_scaling(QString p_miscname)
 
 QString AOApplication::get_category(QString p_char)
 {
-  QString f_result = read_char_ini(p_char, "category", "Options");
+  QString f_result = get_char_ini(p_char)->option("category");
   return f_result;
 }
 
@@ -565,20 +470,20 @@ QString AOApplication::get_chat(QString p_char)
   {
     return "default";
   }
-  QString f_result = read_char_ini(p_char, "chat", "Options");
+  QString f_result = get_char_ini(p_char)->option("chat");
   return f_result;
 }
 
 QString AOApplication::get_chat_font(QString p_char)
 {
-  QString f_result = read_char_ini(p_char, "chat_font", "Options");
+  QString f_result = get_char_ini(p_char)->option("chat_font");
 
   return f_result;
 }
 
 int AOApplication::get_chat_size(QString p_char)
 {
-  QString f_result = read_char_ini(p_char, "chat_size", "Options");
+  QString f_result = get_char_ini(p_char)->option("chat_size");
 
   if (f_result == "")
   {
@@ -589,7 +494,7 @@ int AOApplication::get_chat_size(QString p_char)
 
 int AOApplication::get_preanim_duration(QString p_char, QString p_emote)
 {
-  QString f_result = read_char_ini(p_char, p_emote, "Time");
+  QString f_result = get_char_ini(p_char)->value("Time", p_emote);
 
   if (f_result == "")
   {
@@ -600,94 +505,65 @@ int AOApplication::get_preanim_duration(QString p_char, QString p_emote)
 
 int AOApplication::get_emote_number(QString p_char)
 {
-  QString f_result = read_char_ini(p_char, "number", "Emotions");
-
-  if (f_result == "")
-  {
-    return 0;
-  }
-  return f_result.toInt();
+  return get_char_ini(p_char)->emoteCount();
 }
 
 QString AOApplication::get_emote_comment(QString p_char, int p_emote)
 {
-  QString f_result = read_char_ini(p_char, QString::number(p_emote + 1), "Emotions");
-
-  QStringList result_contents = f_result.split("#");
+  const CharacterIni::Emote &emote = get_char_ini(p_char)->emote(p_emote);
 
-  if (result_contents.size() < 4)
+  if (!emote.valid)
   {
     qWarning() << "misformatted char.ini: " << p_char << ", " << p_emote;
     return "normal";
   }
-  return result_contents.at(0);
+  return emote.comment;
 }
 
 QString AOApplication::get_pre_emote(QString p_char, int p_emote)
 {
-  QString f_result = read_char_ini(p_char, QString::number(p_emote + 1), "Emotions");
+  const CharacterIni::Emote &emote = get_char_ini(p_char)->emote(p_emote);
 
-  QStringList result_contents = f_result.split("#");
-
-  if (result_contents.size() < 4)
+  if (!emote.valid)
   {
     qWarning() << "misformatted char.ini: " << p_char << ", " << p_emote;
     return "";
   }
-  return result_contents.at(1);
+  return emote.pre_emote;
 }
 
 QString AOApplication::get_emote(QString p_char, int p_emote)
 {
-  QString f_result = read_char_ini(p_char, QString::number(p_emote + 1), "Emotions");
-
-  QStringList result_contents = f_result.split("#");
+  const CharacterIni::Emote &emote = get_char_ini(p_char)->emote(p_emote);
 
-  if (result_contents.size() < 4)
+  if (!emote.valid)
   {
     qWarning() << "misformatted char.ini: " << p_char << ", " << p_emote;
     return "normal";
   }
-  return result_contents.at(2);
+  return emote.animation;
 }
 
 int AOApplication::get_emote_mod(QString p_char, int p_emote)
 {
-  QString f_result = read_char_ini(p_char, QString::number(p_emote + 1), "Emotions");
+  const CharacterIni::Emote &emote = get_char_ini(p_char)->emote(p_emote);
 
-  QStringList result_contents = f_result.split("#");
-
-  if (result_contents.size() < 4)
+  if (!emote.valid)
   {
     qWarning() << "misformatted char.ini: " << p_char << ", " << QString::number(p_emote);
     return 0;
   }
-  return result_contents.at(3).toInt();
+  return emote.modifier;
 }
 
 int AOApplication::get_desk_mod(QString p_char, int p_emote)
 {
-  QString f_result = read_char_ini(p_char, QString::number(p_emote + 1), "Emotions");
-
-  QStringList result_contents = f_result.split("#");
-
-  if (result_contents.size() < 5)
-  {
-    return -1;
-  }
-
-  QString string_result = result_contents.at(4);
-  if (string_result == "")
-  {
-    return -1;
-  }
-
-  return string_result.toInt();
+  return get_char_ini(p_char)->emote(p_emote).desk_modifier;
 }
 
 QString AOApplication::get_sfx_name(QString p_char, int p_emote)
 {
-  QString f_result = read_char_ini(p_char, QString::number(p_emote + 1), "SoundN");
+  QString f_result = get_char_ini(p_char)->soundName(p_emote);
 
   if (f_result == "")
   {
@@ -698,7 +574,7 @@ QString AOApplication::get_sfx_name(QString p_char, int p_emote)
 
 int AOApplication::get_sfx_delay(QString p_char, int p_emote)
 {
-  QString f_result = read_char_ini(p_char, QString::number(p_emote + 1), "SoundT");
+  QString f_result = get_char_ini(p_char)->soundDelay(p_emote);
 
   if (f_result == "")
   {
@@ -709,7 +585,7 @@ int AOApplication::get_sfx_delay(QString p_char, int p_emote)
 
 QString AOApplication::get_sfx_looping(QString p_char, int p_emote)
 {
-  QString f_result = read_char_ini(p_char, QString::number(p_emote + 1), "SoundL");
+  QString f_result = get_char_ini(p_char)->soundLooping(p_emote);
 
   if (f_result == "")
   {
@@ -723,7 +599,7 @@ QString AOApplication::get_sfx_looping(QString p_char, int p_emote)
 
 QString AOApplication::get_sfx_frame(QString p_char, QString p_emote, int n_frame)
 {
-  QString f_result = read_char_ini(p_char, QString::number(n_frame), p_emote.append("_FrameSFX"));
+  QString f_result = get_char_ini(p_char)->frameEffect(p_emote, "_FrameSFX", n_frame);
 
   if (f_result == "")
   {
@@ -734,7 +610,7 @@ QString AOApplication::get_sfx_frame(QString p_char, QString p_emote, int n_fram
 
 QString AOApplication::get_screenshake_frame(QString p_char, QString p_emote, int n_frame)
 {
-  QString f_result = read_char_ini(p_char, QString::number(n_frame), p_emote.append("_FrameScreenshake"));
+  QString f_result = get_char_ini(p_char)->frameEffect(p_emote, "_FrameScreenshake", n_frame);
 
   if (f_result == "")
   {
@@ -745,7 +621,7 @@ QString AOApplication::get_screenshake_frame(QString p_char, QString p_emote, in
 
 QString AOApplication::get_flash_frame(QString p_char, QString p_emote, int n_frame)
 {
-  QString f_result = read_char_ini(p_char, QString::number(n_frame), p_emote.append("_FrameRealization"));
+  QString f_result = get_char_ini(p_char)->frameEffect(p_emote, "_FrameRealization", n_frame);
 
   if (f_result == "")
   {
@@ -756,7 +632,7 @@ QString AOApplication::get_flash_frame(QString p_char, QString p_emote, int n_fr
 
 int AOApplication::get_text_delay(QString p_char, QString p_emote)
 {
-  QString f_result = read_char_ini(p_char, p_emote, "stay_time");
+  QString f_result = get_char_ini(p_char)->value("stay_time", p_emote);
 
   if (f_result == "")
   {
@@ -767,75 +643,14 @@ int AOApplication::get_text_delay(QString p_char, QString p_emote)
 
 QStringList AOApplication::get_effects(QString p_char)
 {
-  const QStringList l_filepath_list{
-      get_asset("effects/effects.ini", Options::getInstance().theme(), Options::getInstance().subTheme(), default_theme, ""),
-      get_asset("effects.ini", Options::getInstance().theme(), Options::getInstance().subTheme(), default_theme, read_char_ini(p_char, "effects", "Options")),
-  };
-
-  QStringList l_effect_name_list;
-  for (const QString &i_filepath : l_filepath_list)
-  {
-    if (!QFile::exists(i_filepath))
-    {
-      continue;
-    }
-
-    QSettings l_effects_ini(i_filepath, QSettings::IniFormat);
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    l_effects_ini.setIniCodec("UTF-8");
-#endif
-    // port legacy effects
-    if (!l_effects_ini.contains("version/major") || l_effects_ini.value("version/major").toInt() < 2)
-    {
-      QFile effects_old(i_filepath);
-      if (QFile::copy(i_filepath, i_filepath + ".old"))
-      {
-        AOUtils::migrateEffects(l_effects_ini);
-      }
-      else
-      {
-        qWarning() << "Unable to copy effects.ini, skipping migration.";
-      }
-    }
-
-    QStringList l_group_list;
-    for (const QString &i_group : l_effects_ini.childGroups())
-    {
-      bool l_result;
-      i_group.toInt(&l_result);
-      if (l_result)
-      {
-        l_group_list.append(i_group);
-      }
-    }
-
-    std::sort(l_group_list.begin(), l_group_list.end(), [](const QString &lhs, const QString &rhs) { return lhs.toInt() < rhs.toInt(); });
-
-    for (const QString &i_group : std::as_const(l_group_list))
-    {
-      const QString l_key = i_group + "/name";
-      if (!l_effects_ini.contains(l_key))
-      {
-        continue;
-      }
-
-      const QString l_effect_name = l_effects_ini.value(l_key).toString();
-      if (l_effect_name.isEmpty())
-      {
-        continue;
-      }
-
-      l_effect_name_list.append(l_effect_name);
-    }
-  }
-  return l_effect_name_list;
+  return get_effect_table(get_char_ini(p_char)->option("effects"))->names();
 }
 
 QString AOApplication::get_effect(QString effect, QString p_char, QString p_folder)
 {
   if (p_folder == "")
   {
-    p_folder = read_char_ini(p_char, "effects", "Options");
+    p_folder = get_char_ini(p_char)->option("effects");
   }
 
   QStringList paths{get_image("effects/" + effect, Options::getInstance().theme(), Options::getInstance().subTheme(), default_theme, ""), get_image(effect, Options::getInstance().theme(), Options::getInstance().subTheme(), default_theme, p_folder)};
@@ -851,51 +666,72 @@ QString AOApplication::get_effect(QString effect, QString p_char, QString p_fold
 }
 
 QString AOApplication::get_effect_property(QString fx_name, QString p_char, QString p_folder, QString p_property)
+{
+  if (fx_name == "realization" && p_property == "sound")
+  {
+    return get_custom_realization(p_char);
+  }
+  return get_effect_descriptor(fx_name, p_char, p_folder).property(p_property);
+}
+
+EffectDescriptor AOApplication::get_effect_descriptor(QString fx_name, QString p_char, QString p_folder)
 {
   if (p_folder == "")
   {
-    p_folder = read_char_ini(p_char, "effects", "Options");
+    p_folder = get_char_ini(p_char)->option("effects");
+  }
+
+  EffectDescriptor descriptor;
+  if (const EffectDescriptor *found = get_effect_table(p_folder)->find(fx_name))
+  {
+    descriptor = *found;
+  }
+  if (fx_name == "realization")
+  {
+    descriptor.sound = get_custom_realization(p_char);
+    descriptor.properties.insert("sound", descriptor.sound);
+  }
+  return descriptor;
+}
+
+std::shared_ptr<const EffectTable> AOApplication::get_effect_table(QString p_folder)
+{
+  const QString theme = Options::getInstance().theme();
+  const QString subtheme = Options::getInstance().subTheme();
+  const QString key = theme % QChar('|') % subtheme % QChar('|') % p_folder;
+  std::shared_ptr<const EffectTable> table = EffectTableCache::getInstance().find(key);
+  if (table)
+  {
+    return table;
   }
 
-  const auto paths = get_asset_paths("effects/effects.ini", Options::getInstance().theme(), Options::getInstance().subTheme(), default_theme, "");
-  const auto misc_paths = get_asset_paths("effects.ini", Options::getInstance().theme(), Options::getInstance().subTheme(), default_theme, p_folder);
-  QString path;
-  QString f_result;
-  for (const VPath &p : paths + misc_paths)
+  // Properties are looked up in every effects.ini there is, the dropdown only
+  // lists the effects of the first one found in each place.
+  QStringList files;
+  for (const VPath &p : get_asset_paths("effects/effects.ini", theme, subtheme, default_theme, "") + get_asset_paths("effects.ini", theme, subtheme, default_theme, p_folder))
   {
-    path = get_real_path(p);
+    QString path = get_real_path(p);
     if (!path.isEmpty())
     {
-      QSettings settings(path, QSettings::IniFormat);
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-      settings.setIniCodec("UTF-8");
-#endif
-      QStringList char_effects = settings.childGroups();
-      for (int i = 0; i < char_effects.size(); ++i)
-      {
-        QString effect = settings.value(char_effects[i] + "/name").toString();
-        if (effect.toLower() == fx_name.toLower())
-        {
-          f_result = settings.value(char_effects[i] + "/" + p_property).toString();
-          if (!f_result.isEmpty())
-          {
-            // Only break the loop if we get a non-empty result, continue the search otherwise
-            break;
-          }
-        }
-      }
+      files.append(path);
     }
   }
-  if (fx_name == "realization" && p_property == "sound")
+
+  QStringList list_files;
+  for (const QString &path : {get_asset("effects/effects.ini", theme, subtheme, default_theme, ""), get_asset("effects.ini", theme, subtheme, default_theme, p_folder)})
   {
-    f_result = get_custom_realization(p_char);
+    if (QFile::exists(path))
+    {
+      list_files.append(path);
+    }
   }
-  return f_result;
+
+  return EffectTableCache::getInstance().insert(key, files, list_files);
 }
 
 QString AOApplication::get_custom_realization(QString p_char)
 {
-  QString f_result = read_char_ini(p_char, "realization", "Options");
+  QString f_result = get_char_ini(p_char)->option("realization");
   if (f_result == "")
   {
     return get_court_sfx("realization");
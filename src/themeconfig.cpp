@@ -0,0 +1,106 @@
+#include "themeconfig.h"
+
+#include <QMutexLocker>
+#include <QSettings>
+
+ThemeConfig::ThemeConfig(const QStringList &fileNames)
+{
+  for (const QString &file_name : fileNames)
+  {
+    QSettings settings(file_name, QSettings::IniFormat);
+    const QStringList keys = settings.allKeys();
+    for (const QString &key : keys)
+    {
+      if (m_values.contains(key))
+      {
+        continue;
+      }
+
+      QVariant value = settings.value(key);
+      if (value.typeId() == QMetaType::QStringList)
+      {
+        m_values.insert(key, value.toStringList().join(","));
+      }
+      else if (!value.isNull())
+      {
+        m_values.insert(key, value.toString());
+      }
+    }
+  }
+}
+
+bool ThemeConfig::contains(const QString &key) const
+{
+  return m_values.contains(key);
+}
+
+QString ThemeConfig::value(const QString &key) const
+{
+  return m_values.value(key);
+}
+
+QColor ThemeConfig::color(const QString &key, const QColor &fallback) const
+{
+  const QStringList color_list = value(key).split(",");
+  if (color_list.size() < 3)
+  {
+    return fallback;
+  }
+  return QColor(color_list.at(0).toInt(), color_list.at(1).toInt(), color_list.at(2).toInt());
+}
+
+QPoint ThemeConfig::point(const QString &key, int scale) const
+{
+  const QStringList sub_line_elements = value(key).split(",");
+  if (sub_line_elements.size() < 2)
+  {
+    return QPoint(0, 0);
+  }
+  return QPoint(sub_line_elements.at(0).toInt() * scale, sub_line_elements.at(1).toInt() * scale);
+}
+
+pos_size_type ThemeConfig::dimensions(const QString &key, int scale) const
+{
+  pos_size_type return_value;
+  return_value.width = -1;
+  return_value.height = -1;
+
+  const QStringList sub_line_elements = value(key).split(",");
+  if (sub_line_elements.size() < 4)
+  {
+    return return_value;
+  }
+
+  return_value.x = sub_line_elements.at(0).toInt() * scale;
+  return_value.y = sub_line_elements.at(1).toInt() * scale;
+  return_value.width = sub_line_elements.at(2).toInt() * scale;
+  return_value.height = sub_line_elements.at(3).toInt() * scale;
+  return return_value;
+}
+
+ThemeConfigCache &ThemeConfigCache::getInstance()
+{
+  static ThemeConfigCache instance;
+  return instance;
+}
+
+std::shared_ptr<const ThemeConfig> ThemeConfigCache::find(const QString &key)
+{
+  QMutexLocker locker(&m_lock);
+  return m_configs.value(key);
+}
+
+std::shared_ptr<const ThemeConfig> ThemeConfigCache::insert(const QString &key, const QStringList &fileNames)
+{
+  std::shared_ptr<const ThemeConfig> config = std::make_shared<const ThemeConfig>(fileNames);
+
+  QMutexLocker locker(&m_lock);
+  m_configs.insert(key, config);
+  return config;
+}
+
+void ThemeConfigCache::clear()
+{
+  QMutexLocker locker(&m_lock);
+  m_configs.clear();
+}
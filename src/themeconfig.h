@@ -0,0 +1,67 @@
+#pragma once
+
+#include "datatypes.h"
+
+#include <QColor>
+#include <QHash>
+#include <QMutex>
+#include <QPoint>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+
+/**
+ * @brief The merged contents of one or more theme configuration files.
+ *
+ * @details Files are given from highest to lowest priority; a key takes the
+ * value of the first file that defines it, which matches how the asset path
+ * list of get_config_value is searched. List values are joined with commas.
+ */
+class ThemeConfig
+{
+public:
+  ThemeConfig() = default;
+  explicit ThemeConfig(const QStringList &fileNames);
+
+  bool contains(const QString &key) const;
+  QString value(const QString &key) const;
+
+  /// Returns the "r, g, b" value of key, or fallback if it is missing or incomplete.
+  QColor color(const QString &key, const QColor &fallback = QColor(0, 0, 0)) const;
+
+  /// Returns the "x, y" value of key multiplied by scale, or (0, 0).
+  QPoint point(const QString &key, int scale = 1) const;
+
+  /// Returns the "x, y, width, height" value of key multiplied by scale, or
+  /// a zero position with a size of -1 by -1.
+  pos_size_type dimensions(const QString &key, int scale = 1) const;
+
+private:
+  QHash<QString, QString> m_values;
+};
+
+/**
+ * @brief Process-wide cache of theme configurations.
+ *
+ * @details Entries are never reloaded on their own; the cache has to be
+ * cleared whenever the theme is reloaded or the mount paths change.
+ */
+class ThemeConfigCache
+{
+  Q_DISABLE_COPY_MOVE(ThemeConfigCache)
+
+public:
+  static ThemeConfigCache &getInstance();
+
+  std::shared_ptr<const ThemeConfig> find(const QString &key);
+  std::shared_ptr<const ThemeConfig> insert(const QString &key, const QStringList &fileNames);
+
+  void clear();
+
+private:
+  ThemeConfigCache() = default;
+
+  QMutex m_lock;
+  QHash<QString, std::shared_ptr<const ThemeConfig>> m_configs;
+};
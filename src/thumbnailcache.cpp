@@ -0,0 +1,66 @@
+#include "thumbnailcache.h"
+
+#include <QCoreApplication>
+#include <QImageReader>
+
+ThumbnailCache &ThumbnailCache::getInstance()
+{
+  static ThumbnailCache instance;
+  return instance;
+}
+
+ThumbnailCache::ThumbnailCache()
+    : m_thread_pool(new QThreadPool(QCoreApplication::instance()))
+    , m_cache(DEFAULT_MAXIMUM_COST)
+{
+  m_thread_pool->setMaxThreadCount(4);
+}
+
+QPixmap ThumbnailCache::thumbnail(const QString &fileName, const QSize &size)
+{
+  const QString key = cacheKey(fileName, size);
+  if (QPixmap *pixmap = m_cache.object(key))
+  {
+    return *pixmap;
+  }
+
+  if (!m_pending.contains(key))
+  {
+    m_pending.insert(key);
+    m_thread_pool->start([this, fileName, size] {
+      QImageReader reader(fileName);
+      reader.setScaledSize(size);
+      const QImage image = reader.read();
+      QMetaObject::invokeMethod(this, [this, fileName, size, image] { finish(fileName, size, image); }, Qt::QueuedConnection);
+    });
+  }
+
+  return QPixmap();
+}
+
+bool ThumbnailCache::isLoading(const QString &fileName, const QSize &size) const
+{
+  return m_pending.contains(cacheKey(fileName, size));
+}
+
+void ThumbnailCache::clear()
+{
+  m_cache.clear();
+}
+
+QString ThumbnailCache::cacheKey(const QString &fileName, const QSize &size)
+{
+  return fileName + QLatin1Char('|') + QString::number(size.width()) + QLatin1Char('x') + QString::number(size.height());
+}
+
+void ThumbnailCache::finish(const QString &fileName, const QSize &size, const QImage &image)
+{
+  const QString key = cacheKey(fileName, size);
+  m_pending.remove(key);
+
+  // Failed loads are cached as well, so that they are not retried on every request.
+  QPixmap *pixmap = new QPixmap(QPixmap::fromImage(image));
+  m_cache.insert(key, pixmap, qMax<qint64>(1, qint64(pixmap->width()) * pixmap->height() * pixmap->depth() / 8));
+
+  Q_EMIT thumbnailReady(fileName, size);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QCache>
+#include <QObject>
+#include <QPixmap>
+#include <QSet>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+
+/**
+ * @brief Process-wide cache of small, pre-scaled images such as character icons.
+ *
+ * @details Images are decoded and scaled on a thread pool. Requesting a
+ * thumbnail that is not cached yet returns a null pixmap and schedules the
+ * load; thumbnailReady() is emitted once it is available.
+ */
+class ThumbnailCache : public QObject
+{
+  Q_OBJECT
+
+public:
+  static constexpr qint64 DEFAULT_MAXIMUM_COST = 64 * 1024 * 1024;
+
+  static ThumbnailCache &getInstance();
+
+  /**
+   * @brief Returns fileName scaled to size, or a null pixmap if it is still
+   * being loaded or could not be read.
+   */
+  QPixmap thumbnail(const QString &fileName, const QSize &size);
+
+  /// Returns true if fileName at size is still being loaded.
+  bool isLoading(const QString &fileName, const QSize &size) const;
+
+  void clear();
+
+Q_SIGNALS:
+  void thumbnailReady(const QString &fileName, const QSize &size);
+
+private:
+  ThumbnailCache();
+
+  QThreadPool *m_thread_pool;
+  QCache<QString, QPixmap> m_cache;
+  QSet<QString> m_pending;
+
+  static QString cacheKey(const QString &fileName, const QSize &size);
+
+  void finish(const QString &fileName, const QSize &size, const QImage &image);
+};
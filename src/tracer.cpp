@@ -0,0 +1,197 @@
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QThread>
+
+Tracer::Tracer()
+{
+  m_clock.start();
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+  m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+qint64 Tracer::now() const
+{
+  return m_clock.nsecsElapsed();
+}
+
+void Tracer::record(const char *name, qint64 start, QString argument)
+{
+  const qint64 end = now();
+  ThreadBuffer *buffer = threadBuffer();
+
+  QMutexLocker locker(&buffer->lock);
+  if (buffer->events.isEmpty())
+  {
+    buffer->events.resize(BUFFER_SIZE);
+  }
+  Event &event = buffer->events[buffer->next];
+  event.name = name;
+  event.argument = std::move(argument);
+  event.thread = buffer->thread;
+  event.start = start;
+  event.duration = end - start;
+  buffer->next = (buffer->next + 1) % BUFFER_SIZE;
+  buffer->count = qMin(buffer->count + 1, BUFFER_SIZE);
+}
+
+int Tracer::eventCount() const
+{
+  QMutexLocker locker(&m_buffers_lock);
+  int count = 0;
+  for (const std::unique_ptr<ThreadBuffer> &buffer : m_buffers)
+  {
+    QMutexLocker buffer_locker(&buffer->lock);
+    count += buffer->count;
+  }
+  return count;
+}
+
+void Tracer::clear()
+{
+  QMutexLocker locker(&m_buffers_lock);
+  for (const std::unique_ptr<ThreadBuffer> &buffer : m_buffers)
+  {
+    QMutexLocker buffer_locker(&buffer->lock);
+    buffer->events.clear();
+    buffer->next = 0;
+    buffer->count = 0;
+  }
+}
+
+bool Tracer::exportChromeTrace(const QString &fileName) const
+{
+  const qint64 pid = QCoreApplication::applicationPid();
+
+  QJsonArray trace_events;
+  trace_events.append(QJsonObject{{"name", "process_name"}, {"ph", "M"}, {"pid", pid}, {"args", QJsonObject{{"name", QCoreApplication::applicationName()}}}});
+
+  QVector<Event> events;
+  {
+    QMutexLocker locker(&m_buffers_lock);
+    for (auto it = m_thread_names.cbegin(); it != m_thread_names.cend(); ++it)
+    {
+      trace_events.append(QJsonObject{{"name", "thread_name"}, {"ph", "M"}, {"pid", pid}, {"tid", qint64(it.key())}, {"args", QJsonObject{{"name", it.value()}}}});
+    }
+
+    for (const std::unique_ptr<ThreadBuffer> &buffer : m_buffers)
+    {
+      QMutexLocker buffer_locker(&buffer->lock);
+      const int first = (buffer->next - buffer->count + BUFFER_SIZE) % BUFFER_SIZE;
+      for (int i = 0; i < buffer->count; ++i)
+      {
+        events.append(buffer->events.at((first + i) % BUFFER_SIZE));
+      }
+    }
+  }
+
+  for (const Event &event : std::as_const(events))
+  {
+    // Chrome expects microseconds.
+    QJsonObject trace_event{
+        {"name", QString::fromUtf8(event.name)},
+        {"ph", "X"},
+        {"pid", pid},
+        {"tid", qint64(event.thread)},
+        {"ts", event.start / 1000.0},
+        {"dur", event.duration / 1000.0},
+    };
+    if (!event.argument.isEmpty())
+    {
+      trace_event.insert("args", QJsonObject{{"argument", event.argument}});
+    }
+    trace_events.append(trace_event);
+  }
+
+  QSaveFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    qWarning() << "Failed to export trace to" << fileName << ":" << file.errorString();
+    return false;
+  }
+  file.write(QJsonDocument(QJsonObject{{"traceEvents", trace_events}, {"displayTimeUnit", "ms"}}).toJson(QJsonDocument::Compact));
+  if (!file.commit())
+  {
+    qWarning() << "Failed to export trace to" << fileName << ":" << file.errorString();
+    return false;
+  }
+
+  qInfo() << "Exported" << events.size() << "trace events to" << fileName;
+  return true;
+}
+
+Tracer::ThreadBuffer *Tracer::threadBuffer()
+{
+  // Hands the buffer back when the thread exits, so that pooled threads coming
+  // and going reuse buffers instead of adding new ones.
+  class Holder
+  {
+  public:
+    ThreadBuffer *buffer = nullptr;
+
+    ~Holder()
+    {
+      if (buffer)
+      {
+        Tracer::getInstance().releaseThreadBuffer(buffer);
+      }
+    }
+  };
+  static thread_local Holder holder;
+
+  if (!holder.buffer)
+  {
+    holder.buffer = acquireThreadBuffer();
+  }
+  return holder.buffer;
+}
+
+Tracer::ThreadBuffer *Tracer::acquireThreadBuffer()
+{
+  QMutexLocker locker(&m_buffers_lock);
+  ThreadBuffer *buffer = nullptr;
+  for (const std::unique_ptr<ThreadBuffer> &unused : m_buffers)
+  {
+    if (!unused->in_use)
+    {
+      buffer = unused.get();
+      break;
+    }
+  }
+  if (!buffer)
+  {
+    m_buffers.push_back(std::make_unique<ThreadBuffer>());
+    buffer = m_buffers.back().get();
+  }
+
+  const quint32 thread = m_next_thread++;
+  QString name = QThread::currentThread()->objectName();
+  if (QCoreApplication::instance() && QThread::currentThread() == QCoreApplication::instance()->thread())
+  {
+    name = "Main thread";
+  }
+  else if (name.isEmpty())
+  {
+    name = QString("Thread %1").arg(thread);
+  }
+  m_thread_names.insert(thread, name);
+
+  QMutexLocker buffer_locker(&buffer->lock);
+  buffer->thread = thread;
+  buffer->in_use = true;
+  return buffer;
+}
+
+void Tracer::releaseThreadBuffer(ThreadBuffer *buffer)
+{
+  QMutexLocker locker(&m_buffers_lock);
+  buffer->in_use = false;
+}
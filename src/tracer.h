@@ -0,0 +1,145 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Records how long the scopes marked with AO_TRACE_SCOPE take.
+ *
+ * @details Nothing is recorded until the tracer is enabled. Every thread writes
+ * into its own ring buffer of BUFFER_SIZE events, so only the most recent
+ * events of each thread are kept. The trace can be exported as Chrome trace
+ * event JSON, which chrome://tracing and Perfetto open.
+ *
+ * Builds without AO_ENABLE_TRACING compile every AO_TRACE_SCOPE away.
+ */
+class Tracer
+{
+public:
+  static constexpr int BUFFER_SIZE = 32768;
+
+  class Event
+  {
+  public:
+    const char *name = nullptr;
+    QString argument;
+    quint32 thread = 0;
+    qint64 start = 0;
+    qint64 duration = 0;
+  };
+
+  Tracer(const Tracer &) = delete;
+  void operator=(const Tracer &) = delete;
+
+  static Tracer &getInstance()
+  {
+    static Tracer instance;
+    return instance;
+  }
+
+  bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+  void setEnabled(bool enabled);
+
+  /// Nanoseconds since the tracer was created.
+  qint64 now() const;
+
+  /// Records a scope that started at start and ends now.
+  void record(const char *name, qint64 start, QString argument = QString());
+
+  int eventCount() const;
+  void clear();
+
+  bool exportChromeTrace(const QString &fileName) const;
+
+private:
+  class ThreadBuffer
+  {
+  public:
+    QMutex lock;
+    quint32 thread = 0;
+    bool in_use = true;
+    QVector<Event> events;
+    int next = 0;
+    int count = 0;
+  };
+
+  std::atomic_bool m_enabled = false;
+  QElapsedTimer m_clock;
+
+  mutable QMutex m_buffers_lock;
+  std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+  QHash<quint32, QString> m_thread_names;
+  quint32 m_next_thread = 1;
+
+  Tracer();
+
+  ThreadBuffer *threadBuffer();
+  ThreadBuffer *acquireThreadBuffer();
+  void releaseThreadBuffer(ThreadBuffer *buffer);
+};
+
+/**
+ * @brief Records the time between its construction and destruction, if the
+ * tracer was enabled when it was constructed.
+ */
+class TraceScope
+{
+public:
+  explicit TraceScope(const char *name)
+      : m_name(name)
+      , m_start(Tracer::getInstance().isEnabled() ? Tracer::getInstance().now() : -1)
+  {}
+
+  /// Also records the argument returned by argumentFunction, which is only
+  /// called while tracing.
+  template <typename ArgumentFunction>
+  TraceScope(const char *name, ArgumentFunction &&argumentFunction)
+      : TraceScope(name)
+  {
+    if (isActive())
+    {
+      m_argument = argumentFunction();
+    }
+  }
+
+  ~TraceScope()
+  {
+    if (m_start != -1)
+    {
+      Tracer::getInstance().record(m_name, m_start, std::move(m_argument));
+    }
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  void operator=(const TraceScope &) = delete;
+
+  bool isActive() const { return m_start != -1; }
+
+private:
+  const char *m_name;
+  qint64 m_start;
+  QString m_argument;
+};
+
+#ifdef AO_ENABLE_TRACING
+#define AO_TRACE_CONCAT_(a, b) a##b
+#define AO_TRACE_CONCAT(a, b) AO_TRACE_CONCAT_(a, b)
+#define AO_TRACE_SCOPE_NAME AO_TRACE_CONCAT(l_trace_scope_, __LINE__)
+
+/// Traces the rest of the enclosing scope. name must be a string literal.
+#define AO_TRACE_SCOPE(name) TraceScope AO_TRACE_SCOPE_NAME(name)
+
+/// Like AO_TRACE_SCOPE, also recording argument. argument is only evaluated
+/// while tracing.
+#define AO_TRACE_SCOPE_ARG(name, argument) TraceScope AO_TRACE_SCOPE_NAME(name, [&]() -> QString { return argument; })
+#else
+#define AO_TRACE_SCOPE(name) static_cast<void>(0)
+#define AO_TRACE_SCOPE_ARG(name, argument) static_cast<void>(0)
+#endif
@@ -0,0 +1,268 @@
+#include "viewportcompositor.h"
+
+#include "animationlayer.h"
+
+#include <QEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QStyle>
+
+namespace kal
+{
+ViewportCompositor::ViewportCompositor(QWidget *parent)
+    : QWidget(parent)
+{}
+
+ViewportCompositor::~ViewportCompositor()
+{
+  // The layers are children of the compositor and outlive this destructor.
+  for (auto it = m_layers.keyBegin(); it != m_layers.keyEnd(); ++it)
+  {
+    (*it)->m_compositor = nullptr;
+  }
+}
+
+ViewportCompositor *ViewportCompositor::compositorFor(AnimationLayer *layer)
+{
+  QWidget *parent = layer->parentWidget();
+  if (AnimationLayer *parent_layer = qobject_cast<AnimationLayer *>(parent))
+  {
+    return parent_layer->m_compositor;
+  }
+
+  ViewportCompositor *compositor = qobject_cast<ViewportCompositor *>(parent);
+  if (!compositor)
+  {
+    return nullptr;
+  }
+
+  // Other children are painted over the composed layers.
+  const QObjectList &children = compositor->children();
+  for (QObject *child : children)
+  {
+    if (child == layer)
+    {
+      break;
+    }
+    if (child->isWidgetType() && !qobject_cast<AnimationLayer *>(child))
+    {
+      return nullptr;
+    }
+  }
+  return compositor;
+}
+
+void ViewportCompositor::addLayer(AnimationLayer *layer)
+{
+  m_layers.insert(layer, Layer());
+  layer->installEventFilter(this);
+  updateLayerGeometry(layer);
+}
+
+void ViewportCompositor::removeLayer(AnimationLayer *layer)
+{
+  auto it = m_layers.find(layer);
+  if (it == m_layers.end())
+  {
+    return;
+  }
+
+  if (it->visible)
+  {
+    markDirty(it->area);
+  }
+  m_layers.erase(it);
+  layer->removeEventFilter(this);
+}
+
+void ViewportCompositor::setLayerFrame(AnimationLayer *layer, const QPixmap &frame)
+{
+  auto it = m_layers.find(layer);
+  if (it == m_layers.end() || it->frame.cacheKey() == frame.cacheKey())
+  {
+    return;
+  }
+
+  it->frame = frame;
+  if (it->visible)
+  {
+    markDirty(it->area);
+  }
+  updateLayerGeometry(layer);
+  if (it->visible)
+  {
+    markDirty(it->area);
+  }
+}
+
+bool ViewportCompositor::eventFilter(QObject *watched, QEvent *event)
+{
+  AnimationLayer *layer = qobject_cast<AnimationLayer *>(watched);
+  if (layer)
+  {
+    switch (event->type())
+    {
+    case QEvent::Move:
+    case QEvent::Resize:
+    case QEvent::ShowToParent:
+    case QEvent::HideToParent:
+    case QEvent::ParentChange:
+      // Layers placed in this one move along with it.
+      for (auto it = m_layers.keyBegin(); it != m_layers.keyEnd(); ++it)
+      {
+        if (*it == layer || layer->isAncestorOf(*it))
+        {
+          updateLayerGeometry(*it);
+        }
+      }
+      break;
+
+    case QEvent::ZOrderChange:
+      if (const Layer &data = m_layers.value(layer); data.visible)
+      {
+        markDirty(data.area);
+      }
+      break;
+
+    default:
+      break;
+    }
+  }
+  return QWidget::eventFilter(watched, event);
+}
+
+void ViewportCompositor::paintEvent(QPaintEvent *event)
+{
+  const qreal ratio = devicePixelRatioF();
+  const QSize backing_size = (QSizeF(size()) * ratio).toSize();
+  if (m_backing.size() != backing_size || m_backing.devicePixelRatio() != ratio)
+  {
+    m_backing = QImage(backing_size, QImage::Format_ARGB32_Premultiplied);
+    m_backing.setDevicePixelRatio(ratio);
+    m_dirty = rect();
+  }
+  compose();
+
+  QPainter painter(this);
+  for (const QRect &area : event->region())
+  {
+    painter.drawImage(area, m_backing, QRectF(QPointF(area.topLeft()) * ratio, QSizeF(area.size()) * ratio));
+  }
+}
+
+void ViewportCompositor::resizeEvent(QResizeEvent *event)
+{
+  QWidget::resizeEvent(event);
+  m_backing = QImage();
+}
+
+void ViewportCompositor::updateLayerGeometry(AnimationLayer *layer)
+{
+  auto it = m_layers.find(layer);
+  if (it == m_layers.end())
+  {
+    return;
+  }
+
+  // Placed the way QLabel would place the pixmap. The layer may be about to
+  // leave the compositor, after having been moved out of it.
+  QRect rect;
+  QRect area;
+  const bool placed = isAncestorOf(layer);
+  if (placed && !it->frame.isNull())
+  {
+    const QSize frame_size = (QSizeF(it->frame.size()) / it->frame.devicePixelRatio()).toSize();
+    rect = QStyle::alignedRect(layer->layoutDirection(), layer->alignment(), frame_size, QRect(layer->mapTo(this, QPoint(0, 0)), layer->size()));
+
+    // Clipped to the layer and the layers it is placed in, as painting would.
+    area = rect;
+    for (QWidget *widget = layer; widget != this; widget = widget->parentWidget())
+    {
+      area &= QRect(widget->mapTo(this, QPoint(0, 0)), widget->size());
+    }
+  }
+  const bool visible = placed && layer->isVisibleTo(this) && !area.isEmpty();
+  if (rect == it->rect && area == it->area && visible == it->visible)
+  {
+    return;
+  }
+
+  if (it->visible)
+  {
+    markDirty(it->area);
+  }
+  it->rect = rect;
+  it->area = area;
+  it->visible = visible;
+  if (it->visible)
+  {
+    markDirty(it->area);
+  }
+}
+
+void ViewportCompositor::markDirty(const QRect &rect)
+{
+  m_dirty += rect;
+  update(rect);
+}
+
+void ViewportCompositor::compose()
+{
+  m_dirty &= rect();
+  if (m_dirty.isEmpty())
+  {
+    return;
+  }
+
+  QList<const Layer *> stack;
+  collectLayers(this, stack);
+
+  const QRect bounds = m_dirty.boundingRect();
+  qsizetype first = 0;
+  for (qsizetype i = stack.size() - 1; i > 0; --i)
+  {
+    if (!stack.at(i)->frame.hasAlphaChannel() && stack.at(i)->area.contains(bounds))
+    {
+      first = i;
+      break;
+    }
+  }
+
+  QPainter painter(&m_backing);
+  painter.setClipRegion(m_dirty);
+  if (first == 0)
+  {
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(bounds, Qt::transparent);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+  }
+  for (qsizetype i = first; i < stack.size(); ++i)
+  {
+    painter.save();
+    painter.setClipRect(stack.at(i)->area, Qt::IntersectClip);
+    painter.drawPixmap(stack.at(i)->rect.topLeft(), stack.at(i)->frame);
+    painter.restore();
+  }
+
+  m_dirty = QRegion();
+}
+
+void ViewportCompositor::collectLayers(const QObject *parent, QList<const Layer *> &stack) const
+{
+  // Children are listed in stacking order, bottom first, and are painted over
+  // their parent.
+  for (QObject *child : parent->children())
+  {
+    auto it = m_layers.constFind(qobject_cast<AnimationLayer *>(child));
+    if (it == m_layers.constEnd())
+    {
+      continue;
+    }
+    if (it->visible && m_dirty.intersects(it->area))
+    {
+      stack.append(&it.value());
+    }
+    collectLayers(child, stack);
+  }
+}
+} // namespace kal
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QHash>
+#include <QImage>
+#include <QPixmap>
+#include <QRect>
+#include <QRegion>
+#include <QWidget>
+
+namespace kal
+{
+class AnimationLayer;
+
+/**
+ * @brief Paints the animation layers placed in it onto a single surface.
+ *
+ * @details Layers placed in a compositor hand their frames to it instead of
+ * painting themselves, and so do layers placed in such a layer. The compositor
+ * keeps the frame and position of every layer and composes them, in the
+ * stacking order of the layer widgets, into a backing image. Only the regions
+ * touched by a layer that changed are composed again, layers outside of them
+ * are skipped, and so is everything beneath an opaque layer covering the
+ * whole region.
+ *
+ * The composed layers are painted beneath every other child of the
+ * compositor, so a layer stacked above such a child paints itself instead.
+ */
+class ViewportCompositor : public QWidget
+{
+  Q_OBJECT
+
+public:
+  explicit ViewportCompositor(QWidget *parent = nullptr);
+  ~ViewportCompositor();
+
+  /// Returns the compositor that should paint layer, if any.
+  static ViewportCompositor *compositorFor(AnimationLayer *layer);
+
+  void addLayer(AnimationLayer *layer);
+  void removeLayer(AnimationLayer *layer);
+
+  /// Replaces the frame shown by the layer.
+  void setLayerFrame(AnimationLayer *layer, const QPixmap &frame);
+
+protected:
+  bool eventFilter(QObject *watched, QEvent *event) override;
+  void paintEvent(QPaintEvent *event) override;
+  void resizeEvent(QResizeEvent *event) override;
+
+private:
+  class Layer
+  {
+  public:
+    QPixmap frame;
+    QRect rect;
+    /// The part of rect that is shown.
+    QRect area;
+    bool visible = false;
+  };
+
+  QHash<AnimationLayer *, Layer> m_layers;
+  QImage m_backing;
+  QRegion m_dirty;
+
+  void updateLayerGeometry(AnimationLayer *layer);
+  void markDirty(const QRect &rect);
+  void compose();
+  void collectLayers(const QObject *parent, QList<const Layer *> &stack) const;
+};
+} // namespace kal
@@ -230,10 +230,18 @@ void AOOptionsDialog::updateValues()
 void AOOptionsDialog::savePressed()
 {
   bool l_reload_theme_required = (ui_theme_combobox->currentText() != Options::getInstance().theme()) || (ui_theme_scaling_factor_sb->value() != Options::getInstance().themeScalingFactor());
+  Options::getInstance().beginUpdate();
   for (const OptionEntry &entry : std::as_const(optionEntries))
   {
     entry.save();
   }
+  Options::getInstance().endUpdate();
+
+  if (asset_cache_dirty)
+  {
+    ao_app->refresh_asset_index();
+    asset_cache_dirty = false;
+  }
 
   if (l_reload_theme_required)
   {
@@ -262,9 +270,11 @@ void AOOptionsDialog::buttonClicked(QAbstractButton *button)
 
 void AOOptionsDialog::onReloadThemeClicked()
 {
+  Options::getInstance().beginUpdate();
   Options::getInstance().setTheme(ui_theme_combobox->currentText());
   Options::getInstance().setSettingsSubTheme(ui_subtheme_combobox->currentText());
   Options::getInstance().setAnimatedThemeEnabled(ui_animated_theme_cb->isChecked());
+  Options::getInstance().endUpdate();
   Q_EMIT reloadThemeRequest();
   delete layout();
   delete ui_settings_widget;
@@ -373,6 +383,8 @@ void AOOptionsDialog::setupUI()
   FROM_UI(QCheckBox, slides_cb);
   FROM_UI(QCheckBox, restoreposition_cb);
   FROM_UI(QLineEdit, playerlist_format_edit);
+  FROM_UI(QCheckBox, viewport_compositor_cb);
+  FROM_UI(QComboBox, late_frame_policy_combobox);
 
   registerOption<QSpinBox, int>("theme_scaling_factor_sb", &Options::themeScalingFactor, &Options::setThemeScalingFactor);
   registerOption<QCheckBox, bool>("animated_theme_cb", &Options::animatedThemeEnabled, &Options::setAnimatedThemeEnabled);
@@ -412,6 +424,12 @@ void AOOptionsDialog::setupUI()
   registerOption<QCheckBox, bool>("slides_cb", &Options::slidesEnabled, &Options::setSlidesEnabled);
   registerOption<QCheckBox, bool>("restoreposition_cb", &Options::restoreWindowPositionEnabled, &Options::setRestoreWindowPositionEnabled);
   registerOption<QLineEdit, QString>("playerlist_format_edit", &Options::playerlistFormatString, &Options::setPlayerlistFormatString);
+  registerOption<QCheckBox, bool>("viewport_compositor_cb", &Options::viewportCompositorEnabled, &Options::setViewportCompositorEnabled);
+  registerOption<QComboBox, QString>("late_frame_policy_combobox", &Options::lateFramePolicy, &Options::setLateFramePolicy);
+
+  ui_late_frame_policy_combobox->addItem(tr("Skip late frames"), "skip");
+  ui_late_frame_policy_combobox->addItem(tr("Hold the previous frame"), "hold");
+  ui_late_frame_policy_combobox->addItem(tr("Wait for the frame"), "stall");
 
   // Callwords tab. This could just be a QLineEdit, but no, we decided to allow
   // people to put a billion entries in.
@@ -460,6 +478,7 @@ void AOOptionsDialog::setupUI()
     QListWidgetItem *dir_item = new QListWidgetItem(path);
     ui_mount_list->addItem(dir_item);
     ui_mount_list->setCurrentItem(dir_item);
+    asset_cache_dirty = true;
 
     // quick hack to update buttons
     Q_EMIT ui_mount_list->itemSelectionChanged();
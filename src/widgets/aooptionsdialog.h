@@ -77,6 +77,8 @@ private:
   QCheckBox *ui_sfx_on_idle_cb;
   QCheckBox *ui_restoreposition_cb;
   QLineEdit *ui_playerlist_format_edit;
+  QCheckBox *ui_viewport_compositor_cb;
+  QComboBox *ui_late_frame_policy_combobox;
 
   // The callwords tab
   QPlainTextEdit *ui_callwords_textbox;
@@ -0,0 +1,127 @@
+#include "chat_history_dialog.h"
+
+#include "aoapplication.h"
+#include "gui_utils.h"
+#include "options.h"
+
+#include <QFile>
+#include <QHeaderView>
+#include <QUiLoader>
+#include <QVBoxLayout>
+
+const QString ChatHistoryDialog::UI_FILE_PATH = "chat_history_dialog.ui";
+
+ChatHistoryDialog::ChatHistoryDialog(AOApplication *ao_app, QWidget *parent)
+    : QWidget{parent}
+    , ao_app(ao_app)
+{
+  QFile file(Options::getInstance().getUIAsset(UI_FILE_PATH));
+  if (!file.open(QFile::ReadOnly))
+  {
+    qFatal("Unable to open file %s", qPrintable(file.fileName()));
+    return;
+  }
+
+  setWindowIcon(QIcon(":/data/logo-client.png"));
+  setWindowTitle(tr("Chat History"));
+  setAttribute(Qt::WA_DeleteOnClose);
+  QUiLoader loader;
+  ui_widget = loader.load(&file, this);
+  auto layout = new QVBoxLayout(this);
+  layout->addWidget(ui_widget);
+
+  FROM_UI(QLineEdit, text);
+  FROM_UI(QLineEdit, character);
+  FROM_UI(QLineEdit, showname);
+  FROM_UI(QLineEdit, server);
+  FROM_UI(QCheckBox, from_enabled);
+  FROM_UI(QDateTimeEdit, from);
+  FROM_UI(QCheckBox, to_enabled);
+  FROM_UI(QDateTimeEdit, to);
+  FROM_UI(QCheckBox, in_character);
+  FROM_UI(QCheckBox, out_of_character);
+  FROM_UI(QPushButton, search_button);
+  FROM_UI(QTreeWidget, results);
+  FROM_UI(QLabel, status);
+
+  const QDateTime now = QDateTime::currentDateTime();
+  ui_from->setDateTime(now.addSecs(-60 * 60));
+  ui_to->setDateTime(now);
+  ui_server->setText(ao_app->server_name);
+  ui_results->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+  ui_results->header()->setStretchLastSection(true);
+
+  connect(&m_search_watcher, &QFutureWatcherBase::finished, this, &ChatHistoryDialog::onSearchFinished);
+  connect(ui_search_button, &QPushButton::clicked, this, &ChatHistoryDialog::onSearchClicked);
+  for (QLineEdit *field : {ui_text, ui_character, ui_showname, ui_server})
+  {
+    connect(field, &QLineEdit::returnPressed, this, &ChatHistoryDialog::onSearchClicked);
+  }
+}
+
+ChatHistoryDialog::~ChatHistoryDialog()
+{}
+
+void ChatHistoryDialog::search(const QString &text)
+{
+  ui_text->setText(text);
+  onSearchClicked();
+}
+
+void ChatHistoryDialog::onSearchClicked()
+{
+  ChatHistory::Query query;
+  query.text = ui_text->text();
+  query.character = ui_character->text();
+  query.showname = ui_showname->text();
+  query.server = ui_server->text();
+  if (ui_from_enabled->isChecked())
+  {
+    query.from = ui_from->dateTime();
+  }
+  if (ui_to_enabled->isChecked())
+  {
+    query.to = ui_to->dateTime();
+  }
+  query.in_character = ui_in_character->isChecked();
+  query.out_of_character = ui_out_of_character->isChecked();
+
+  // A search that is still running is superseded.
+  m_search_limit = query.limit;
+  m_search_timer.start();
+  m_search_watcher.setFuture(ao_app->chat_history->search(query));
+  ui_status->setText(tr("Searching..."));
+}
+
+void ChatHistoryDialog::onSearchFinished()
+{
+  const QVector<ChatHistory::Entry> entries = m_search_watcher.result();
+  const qint64 elapsed = m_search_timer.elapsed();
+
+  ui_results->clear();
+  QList<QTreeWidgetItem *> items;
+  items.reserve(entries.size());
+  for (const ChatHistory::Entry &entry : entries)
+  {
+    QString name = entry.showname;
+    if (!entry.character.isEmpty() && entry.character != entry.showname)
+    {
+      name += " (" + entry.character + ")";
+    }
+    const QString message = entry.action.isEmpty() ? entry.message : entry.action + ": " + entry.message;
+
+    QTreeWidgetItem *item = new QTreeWidgetItem({entry.timestamp.toLocalTime().toString("yyyy-MM-dd hh:mm:ss"), entry.server, entry.kind == ChatHistory::InCharacter ? tr("IC") : tr("OOC"), name, message});
+    item->setToolTip(4, message);
+    items.append(item);
+  }
+  ui_results->addTopLevelItems(items);
+
+  if (entries.size() >= m_search_limit)
+  {
+    ui_status->setText(tr("Showing the newest %1 lines (%2 ms). Narrow the search to see older ones.").arg(entries.size()).arg(elapsed));
+  }
+  else
+  {
+    ui_status->setText(tr("Found %1 lines (%2 ms).").arg(entries.size()).arg(elapsed));
+  }
+}
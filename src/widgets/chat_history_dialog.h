@@ -0,0 +1,55 @@
+#pragma once
+
+#include "chathistory.h"
+
+#include <QCheckBox>
+#include <QDateTimeEdit>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QWidget>
+
+class AOApplication;
+
+class ChatHistoryDialog : public QWidget
+{
+  Q_OBJECT
+
+public:
+  static const QString UI_FILE_PATH;
+
+  explicit ChatHistoryDialog(AOApplication *ao_app, QWidget *parent = nullptr);
+  virtual ~ChatHistoryDialog();
+
+  /// Searches for lines containing every word of text.
+  void search(const QString &text);
+
+private:
+  AOApplication *ao_app;
+
+  QWidget *ui_widget;
+  QLineEdit *ui_text;
+  QLineEdit *ui_character;
+  QLineEdit *ui_showname;
+  QLineEdit *ui_server;
+  QCheckBox *ui_from_enabled;
+  QDateTimeEdit *ui_from;
+  QCheckBox *ui_to_enabled;
+  QDateTimeEdit *ui_to;
+  QCheckBox *ui_in_character;
+  QCheckBox *ui_out_of_character;
+  QPushButton *ui_search_button;
+  QTreeWidget *ui_results;
+  QLabel *ui_status;
+
+  QFutureWatcher<QVector<ChatHistory::Entry>> m_search_watcher;
+  QElapsedTimer m_search_timer;
+  int m_search_limit = 0;
+
+private Q_SLOTS:
+  void onSearchClicked();
+  void onSearchFinished();
+};